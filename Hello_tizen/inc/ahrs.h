@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _AHRS_H_
+#define _AHRS_H_
+
+#include <stdbool.h>
+#include "mpu9250.h"
+
+#define AHRS_BETA_DEFAULT				(0.1f)	/* gradient step, rad/s */
+
+typedef struct _ahrs_s *ahrs_h;
+
+/*
+ * Madgwick orientation filter : gyro, accel & optional magnetometer
+ * fused into a quaternion (w, x, y, z), sensor frame to earth frame,
+ * earth z up. Single precision throughout.
+ */
+bool ahrs_create(float beta, ahrs_h *ahrs);
+void ahrs_destroy(ahrs_h ahrs);
+void ahrs_reset(ahrs_h ahrs);
+
+/* gyro rad/s, accel & mag any unit, dt sec */
+void ahrs_update_imu(ahrs_h ahrs, const float gyro[3], const float accel[3], float dt);
+void ahrs_update_marg(ahrs_h ahrs, const float gyro[3], const float accel[3], const float mag[3], float dt);
+
+/* driver samples, dt from their timestamps; mag in AK8963 axes or NULL */
+void ahrs_update_samples(ahrs_h ahrs, const MPU9250_sample *samples, int num, const MPU9250_magnetometer_val *mag);
+
+void ahrs_get_quaternion(ahrs_h ahrs, float q[4]);
+void ahrs_get_euler(ahrs_h ahrs, float *roll, float *pitch, float *yaw);	/* rad */
+void ahrs_get_matrix(ahrs_h ahrs, float m[3][3]);						/* sensor to earth */
+
+#endif /* _AHRS_H_ */
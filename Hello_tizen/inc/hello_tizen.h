@@ -2,6 +2,7 @@
 #define __hello_tizen_H__
 
 #include <dlog.h>
+#include "uart.h"
 
 #ifdef  LOG_TAG
 #undef  LOG_TAG
@@ -10,8 +11,32 @@
 
 void pwm_motor_test_main(void);
 int  spi_gyro_test_main(void);
-
+int  spi_burst_test_main(void);
+int  spi_fifo_test_main(void);
+int  spi_drdy_test_main(void);
+int  spi_wom_test_main(void);
+int  spi_acq_test_main(void);
+int  spi_calib_test_main(void);
+int  ahrs_test_main(void);
+int  imu_convert_test_main(void);
+int  imu_filter_test_main(void);
+int  imu_fixed_test_main(void);
+int  uart_latency_test_main(void);
+int  vr_send_test_main(void);
+int  vr_parser_test_main(void);
+int  vr_event_test_main(void);
+int  mtime_test_main(void);
+int  vr_cache_test_main(void);
+int  vr_slot_test_main(void);
+int  vr_baud_test_main(void);
+int  vr_emu_test_main(void);
+int  vr_batch_test_main(void);
+
+void mdm_attach(uart_port_h port);
+void mdm_fini(void);
 int mdm_init(void);
+int mdm_setBaudRate(void);
+int mdm_setFlowControl(uart_flow_control_e flow);
 int mdm_IsRegistred(void);
 int mdm_getIMEI(char *imei, int length);
 int mdm_pdpAct(bool _enable);
@@ -24,5 +49,10 @@ int mdm_socketRecv(char *recvMsg, int length);
 int mdm_powerON(void);
 int mdm_powerOFF(void);
 
+/* non-blocking AT commands from the Ecore main loop */
+typedef void (*mdm_response_cb)(int result, const char *response, void *user_data);
+bool mdm_command_async(const char *cmd, const char *filter, double timeout, mdm_response_cb cb, void *user_data);
+void mdm_async_stop(void);
+
 
 #endif /* __hello_tizen_H__ */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _IMU_CONVERT_H_
+#define _IMU_CONVERT_H_
+
+#include <stdint.h>
+#include "mpu9250.h"
+
+#define IMU_BLOCK_MAX					(256)	/* samples per block */
+
+/** raw samples of one 3 axis sensor, structure of arrays */
+typedef struct{
+	int16_t x[IMU_BLOCK_MAX] __attribute__((aligned(16)));
+	int16_t y[IMU_BLOCK_MAX] __attribute__((aligned(16)));
+	int16_t z[IMU_BLOCK_MAX] __attribute__((aligned(16)));
+	int num;
+}imu_raw_block_s;
+
+typedef struct{
+	float x[IMU_BLOCK_MAX] __attribute__((aligned(16)));
+	float y[IMU_BLOCK_MAX] __attribute__((aligned(16)));
+	float z[IMU_BLOCK_MAX] __attribute__((aligned(16)));
+	int num;
+}imu_block_s;
+
+/*
+ * raw to physical conversion kernels, out = raw * scale
+ * NEON when built with it (__ARM_NEON), portable C otherwise
+ */
+void imu_convert_axis(const int16_t *raw, float *out, float scale, int num);
+void imu_convert_block(const imu_raw_block_s *raw, const float scale[3], imu_block_s *out);
+
+/* per axis scales from the driver's configuration */
+void imu_scale_accel(const MPU9250_scale *scale, float out[3]);
+void imu_scale_gyro(const MPU9250_scale *scale, float out[3]);
+void imu_scale_mag(const MPU9250_scale *scale, float out[3]);
+
+/* big endian axes at offset in each frame (FIFO layout) into a raw block */
+void imu_block_from_frames(const uint8_t *frames, int frame_len, int offset, int num, imu_raw_block_s *raw);
+
+#endif /* _IMU_CONVERT_H_ */
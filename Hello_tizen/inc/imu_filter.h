@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _IMU_FILTER_H_
+#define _IMU_FILTER_H_
+
+#include <stdbool.h>
+#include "imu_convert.h"
+
+#define IMU_FILTER_STAGES				(8)		/* per chain */
+#define IMU_FILTER_TAPS_MAX				(1024)	/* FIR taps, factor x taps per phase */
+#define IMU_FILTER_Q_BUTTERWORTH		(0.7071f)
+
+typedef struct _imu_filter_s *imu_filter_h;
+
+/*
+ * filter chain of one stream (accel, gyro, ...) at rate_hz, stages run
+ * in the order they are added, on the 3 axes of a block, in place
+ */
+bool imu_filter_create(float rate_hz, imu_filter_h *filter);
+void imu_filter_destroy(imu_filter_h filter);
+
+/* biquad IIR, RBJ cookbook low/high pass or a0 normalized coefficients */
+bool imu_filter_add_lowpass(imu_filter_h filter, float cutoff_hz, float q);
+bool imu_filter_add_highpass(imu_filter_h filter, float cutoff_hz, float q);
+bool imu_filter_add_biquad(imu_filter_h filter, const float b[3], const float a[2]);
+
+/*
+ * polyphase FIR decimator, keeps one sample of factor; Blackman windowed
+ * sinc of factor x taps_per_phase taps, cutoff_hz 0 : 0.4 x output rate
+ */
+bool imu_filter_add_decimator(imu_filter_h filter, int factor, int taps_per_phase, float cutoff_hz);
+
+float imu_filter_get_rate(imu_filter_h filter);		/* output rate */
+void imu_filter_reset(imu_filter_h filter);
+
+/* block->num shrinks by the decimation, may be 0; returns it */
+int imu_filter_process(imu_filter_h filter, imu_block_s *block);
+
+#endif /* _IMU_FILTER_H_ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _IMU_FIXED_H_
+#define _IMU_FIXED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * integer sensor processing for FPU-less or softfp builds
+ *   q16_t : Q16.16, physical values (G, digree/s, digree)
+ *   q15_t : Q1.15, filter coefficients
+ * tables are filled by imu_fixed_init, the kernels are integer only.
+ *
+ * error bounds, checked by imu_fixed_test_main against double math:
+ *   imu_fixed_scale   : 1 LSB (2^-16) + 2^-24 relative
+ *   imu_fixed_sqrt    : 1 LSB + 2^-20 relative
+ *   imu_fixed_atan2   : 0.002 digree
+ *   imu_fixed_tilt    : 0.005 digree for |a| >= 0.1G
+ *
+ * Build with IMU_FIXED_POINT (USER_DEFS in project_def.prop) to run
+ * imu_tilt_update on these kernels instead of float.
+ */
+typedef int32_t q16_t;
+typedef int16_t q15_t;
+
+#define Q16_ONE							(65536)
+#define Q16_FROM_FLOAT(f)				((q16_t)((f) * 65536.0f + ((f) >= 0 ? 0.5f : -0.5f)))
+#define Q16_TO_FLOAT(q)					((float)(q) / 65536.0f)
+#define Q15_FROM_FLOAT(f)				((q15_t)((f) * 32767.0f + 0.5f))
+
+typedef struct{
+	q16_t x, y, z;
+}imu_fixed_vec_s;
+
+/** first order low pass y += alpha * (x - y), per axis */
+typedef struct{
+	q15_t alpha;
+	bool primed;
+	imu_fixed_vec_s y;
+}imu_fixed_lowpass_s;
+
+void imu_fixed_init(void);
+
+int32_t imu_fixed_scale_q24(float scale);		/* per LSB scale for imu_fixed_scale */
+void imu_fixed_scale(const int16_t raw[3], const int32_t scale_q24[3], imu_fixed_vec_s *out);
+void imu_fixed_lowpass_init(imu_fixed_lowpass_s *lp, float alpha);
+void imu_fixed_lowpass(imu_fixed_lowpass_s *lp, imu_fixed_vec_s *v);
+uint32_t imu_fixed_sqrt(uint64_t v);
+q16_t imu_fixed_atan2(q16_t y, q16_t x);
+void imu_fixed_tilt(const imu_fixed_vec_s *accel, q16_t *roll, q16_t *pitch);
+
+/*
+ * raw accel to filtered roll & pitch, fixed or float by build
+ */
+#ifdef IMU_FIXED_POINT
+typedef q16_t imu_angle_t;
+#else
+typedef float imu_angle_t;
+#endif
+
+typedef struct{
+#ifdef IMU_FIXED_POINT
+	int32_t scale_q24[3];
+	imu_fixed_lowpass_s lp;
+#else
+	float scale;
+	float alpha;
+	bool primed;
+	float y[3];
+#endif
+}imu_tilt_s;
+
+void imu_tilt_init(imu_tilt_s *tilt, float accel_scale, float alpha);
+void imu_tilt_update(imu_tilt_s *tilt, const int16_t raw[3], imu_angle_t *roll, imu_angle_t *pitch);
+
+#endif /* _IMU_FIXED_H_ */
@@ -55,6 +55,114 @@ typedef struct {
     uint16_t raw;   /*!< Raw chip temperature */
 } MPU9250_temperature_val;
 
+/**
+ * @struct MPU9250_sample
+ * @brief accel, temperature & gyro read together in one burst.
+ */
+typedef struct {
+    MPU9250_accel_val accel;
+    MPU9250_gyro_val gyro;
+    MPU9250_temperature_val temperature;
+    float temp;                 /*!< Computed chip temperature (digC) */
+    long long timestamp_us;     /*!< mtime_now_us() when the burst started */
+} MPU9250_sample;
+
+/**
+ * @struct MPU9250_fifo_stats
+ * @brief FIFO streaming counters.
+ */
+typedef struct {
+    unsigned int reads;         /*!< resource_mpu9250_fifo_read calls that found frames */
+    unsigned int frames;        /*!< frames decoded */
+    unsigned int overflows;     /*!< FIFO found full & reset */
+    unsigned int frames_lost;   /*!< at least this many frames dropped by resets */
+} MPU9250_fifo_stats;
+
+/**
+ * @struct MPU9250_drdy_stats
+ * @brief data ready interrupt counters.
+ */
+typedef struct {
+    unsigned int interrupts;        /*!< interrupt callbacks */
+    unsigned int samples;           /*!< samples handed to the callback */
+    unsigned int spurious;          /*!< interrupts without RAW_DATA_RDY_INT */
+    unsigned int missed;            /*!< sample periods without an interrupt */
+    unsigned int latency_min_us;    /*!< interrupt callback until sample read */
+    unsigned int latency_max_us;
+    unsigned long long latency_sum_us;
+    unsigned int interval_min_us;   /*!< between interrupts */
+    unsigned int interval_max_us;
+} MPU9250_drdy_stats;
+
+typedef void (*MPU9250_drdy_cb)(const MPU9250_sample *sample, void *user_data);
+
+/**
+ * @struct MPU9250_wom_config
+ * @brief wake-on-motion setup.
+ */
+typedef struct {
+    unsigned int threshold_mg;  /*!< accel change that wakes, 4mG steps up to 1020mG */
+    uint8_t lp_odr;             /*!< MPU9250_BIT_LP_ACCEL_ODR, accel samples while asleep */
+    unsigned int holdoff_ms;    /*!< motion this soon after an event is not reported again */
+} MPU9250_wom_config;
+
+/**
+ * @struct MPU9250_wom_stats
+ * @brief wake-on-motion counters.
+ */
+typedef struct {
+    unsigned int interrupts;    /*!< interrupt callbacks */
+    unsigned int events;        /*!< motion reported to the callback */
+    unsigned int suppressed;    /*!< motion within holdoff_ms of an event */
+    unsigned int spurious;      /*!< interrupts without WOM_INT */
+    unsigned int latency_max_us;    /*!< interrupt callback until the application callback */
+} MPU9250_wom_stats;
+
+/* timestamp_us : mtime_now_us() of the interrupt */
+typedef void (*MPU9250_wom_cb)(long long timestamp_us, void *user_data);
+
+/**
+ * @struct MPU9250_acq_config
+ * @brief acquisition thread setup.
+ */
+typedef struct {
+    uint8_t smplrt_div;         /*!< 1kHz / (1 + smplrt_div) */
+    bool use_fifo;              /*!< drain the FIFO every fifo_wake_ms instead of one read per sample */
+    unsigned int fifo_wake_ms;
+    unsigned int ring_size;     /*!< samples, power of 2 */
+} MPU9250_acq_config;
+
+/**
+ * @struct MPU9250_acq_stats
+ * @brief acquisition thread counters.
+ */
+typedef struct {
+    unsigned int produced;      /*!< samples put in the ring */
+    unsigned int overruns;      /*!< samples dropped, the ring was full */
+    unsigned int read_errors;
+    unsigned int late;          /*!< sample periods the thread woke up too late for */
+    unsigned int high_water;    /*!< most samples waiting in the ring */
+} MPU9250_acq_stats;
+
+/**
+ * @struct MPU9250_scale
+ * @brief physical value of one LSB.
+ */
+typedef struct {
+    float accel;    /*!< G */
+    float gyro;     /*!< digree/s */
+    float mag[3];   /*!< AK8963 sensitivity adjustment per axis */
+} MPU9250_scale;
+
+/**
+ * @struct MPU9250_spi_stats
+ * @brief SPI traffic of the driver.
+ */
+typedef struct {
+    unsigned int transfers;     /*!< peripheral_spi_transfer calls */
+    unsigned long long bytes;   /*!< bytes clocked, both directions count once */
+} MPU9250_spi_stats;
+
 /*
  * MPU-9250
  */
@@ -113,6 +221,9 @@ typedef struct {
 #define MPU9250_REG_GYRO_YOUT_HL        (69)    //2 Bytes
 #define MPU9250_REG_GYRO_ZOUT_HL        (71)    //2 Bytes
 #define MPU9250_REG_EXT_SENS_DATA_00    (73)    //Max 24 Bytes
+#define MPU9250_SAMPLE_LEN              (14)    /*!< ACCEL_XOUT_H .. GYRO_ZOUT_L */
+#define MPU9250_FIFO_SIZE               (512)   /*!< FIFO bytes */
+#define MPU9250_INT_GPIO                (22)    /*!< GPIO wired to the INT pin */
 /* --- */
 #define MPU9250_REG_I2C_SLV0_DO         (99)
 #define MPU9250_REG_I2C_SLV1_DO         (100)
@@ -136,6 +247,10 @@ typedef struct {
 #define MPU9250_REG_ZA_OFFSET_HL        (125)   //2 Bytes
 /* @} */
 
+/* offset register units, independent of the full scale */
+#define MPU9250_GYRO_OFFSET_LSB         (32.8f)     /* per digree/s */
+#define MPU9250_ACCEL_OFFSET_LSB        (1024.0f)   /* per G, bits 15:1, bit 0 is kept */
+
 /**
  * AK8963 (Included MPU-9250 package.)
  */
@@ -197,6 +312,60 @@ typedef enum {
     MPU9250_BIT_A_DLPFCFG_MASK = 0x07,
 }   MPU9250_BIT_A_DLPFCFG;
 
+typedef enum {
+    MPU9250_BIT_FIFO_EN_TEMP = 0x80,
+    MPU9250_BIT_FIFO_EN_GYRO_X = 0x40,
+    MPU9250_BIT_FIFO_EN_GYRO_Y = 0x20,
+    MPU9250_BIT_FIFO_EN_GYRO_Z = 0x10,
+    MPU9250_BIT_FIFO_EN_ACCEL = 0x08,
+    MPU9250_BIT_FIFO_EN_GYRO = 0x70,
+    MPU9250_BIT_FIFO_EN_MASK = 0xF8,
+}   MPU9250_BIT_FIFO_EN;
+
+typedef enum {
+    MPU9250_BIT_INT_PIN_CFG_LATCH_INT_EN = 0x20,
+    MPU9250_BIT_INT_PIN_CFG_INT_ANYRD_2CLEAR = 0x10,
+}   MPU9250_BIT_INT_PIN_CFG;
+
+/* INT_ENABLE & INT_STATUS */
+typedef enum {
+    MPU9250_BIT_INT_WOM = 0x40,
+    MPU9250_BIT_INT_FIFO_OFLOW = 0x10,
+    MPU9250_BIT_INT_RAW_RDY = 0x01,
+}   MPU9250_BIT_INT;
+
+/* LP_ACCEL_ODR, Hz */
+typedef enum {
+    MPU9250_BIT_LP_ACCEL_ODR_0_24HZ = 0x00,
+    MPU9250_BIT_LP_ACCEL_ODR_0_49HZ = 0x01,
+    MPU9250_BIT_LP_ACCEL_ODR_0_98HZ = 0x02,
+    MPU9250_BIT_LP_ACCEL_ODR_1_95HZ = 0x03,
+    MPU9250_BIT_LP_ACCEL_ODR_3_91HZ = 0x04,
+    MPU9250_BIT_LP_ACCEL_ODR_7_81HZ = 0x05,
+    MPU9250_BIT_LP_ACCEL_ODR_15_63HZ = 0x06,
+    MPU9250_BIT_LP_ACCEL_ODR_31_25HZ = 0x07,
+    MPU9250_BIT_LP_ACCEL_ODR_62_50HZ = 0x08,
+    MPU9250_BIT_LP_ACCEL_ODR_125HZ = 0x09,
+    MPU9250_BIT_LP_ACCEL_ODR_250HZ = 0x0A,
+    MPU9250_BIT_LP_ACCEL_ODR_500HZ = 0x0B,
+}   MPU9250_BIT_LP_ACCEL_ODR;
+
+typedef enum {
+    MPU9250_BIT_MOT_DETECT_CTRL_ACCEL_INTEL_EN = 0x80,
+    MPU9250_BIT_MOT_DETECT_CTRL_ACCEL_INTEL_MODE = 0x40,   /* compare with the previous sample */
+}   MPU9250_BIT_MOT_DETECT_CTRL;
+
+typedef enum {
+    MPU9250_BIT_PWR_MGMT_1_CYCLE = 0x20,
+    MPU9250_BIT_PWR_MGMT_1_CLKSEL_AUTO = 0x01,
+}   MPU9250_BIT_PWR_MGMT_1;
+
+typedef enum {
+    MPU9250_BIT_USER_CTRL_FIFO_EN = 0x40,
+    MPU9250_BIT_USER_CTRL_I2C_MST_EN = 0x20,
+    MPU9250_BIT_USER_CTRL_FIFO_RST = 0x04,
+}   MPU9250_BIT_USER_CTRL;
+
 /*  MPU9250 access function */
 bool resource_mpu9250_dev_init(void);
 bool resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL gyro_fs, MPU9250_BIT_ACCEL_FS_SEL accel_fs, MPU9250_BIT_DLPF_CFG dlpf_cfg, MPU9250_BIT_A_DLPFCFG a_dlpfcfg);
@@ -205,6 +374,30 @@ bool resource_mpu9250_read_gyro(MPU9250_gyro_val *gyro_val);
 bool resource_mpu9250_read_accel(MPU9250_accel_val *accel_val);
 bool resource_mpu9250_read_temperature(MPU9250_temperature_val *temperature_val);
 bool resource_mpu9250_read_magnetometer(MPU9250_magnetometer_val *magnetometer_val);
+bool resource_mpu9250_read_sample(MPU9250_sample *sample);
+int resource_mpu9250_read_burst(uint8_t addr, uint8_t *vals, int len);
+bool resource_mpu9250_fifo_start(uint8_t fifo_en, uint8_t smplrt_div);
+bool resource_mpu9250_fifo_stop(void);
+int resource_mpu9250_fifo_read(MPU9250_sample *samples, int max);
+void resource_mpu9250_fifo_get_stats(MPU9250_fifo_stats *stats);
+bool resource_mpu9250_drdy_start(int gpio_pin, uint8_t smplrt_div, MPU9250_drdy_cb cb, void *user_data);
+bool resource_mpu9250_drdy_stop(void);
+void resource_mpu9250_drdy_get_stats(MPU9250_drdy_stats *stats);
+bool resource_mpu9250_wom_start(int gpio_pin, const MPU9250_wom_config *config, MPU9250_wom_cb cb, void *user_data);
+bool resource_mpu9250_wom_stop(void);
+void resource_mpu9250_wom_get_stats(MPU9250_wom_stats *stats);
+void resource_mpu9250_get_scale(MPU9250_scale *scale);
+void resource_mpu9250_get_spi_stats(MPU9250_spi_stats *stats);
+bool resource_mpu9250_set_offsets(const float gyro_bias[3], const float accel_offset[3]);
+void resource_mpu9250_set_mag_correction(const float offset[3], const float matrix[3][3]);
+
+/* acquisition thread, owns the SPI device between start & stop */
+bool resource_mpu9250_acq_start(const MPU9250_acq_config *config);
+void resource_mpu9250_acq_stop(void);
+unsigned int resource_mpu9250_acq_peek(const MPU9250_sample **samples, unsigned int max);
+void resource_mpu9250_acq_release(unsigned int n);
+void resource_mpu9250_acq_get_stats(MPU9250_acq_stats *stats);
+void resource_mpu9250_reset_spi_stats(void);
 int resource_mpu9250_spi_init(void);
 void resource_mpu9250_spi_fini(void);
 
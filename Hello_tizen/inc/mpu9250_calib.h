@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MPU9250_CALIB_H_
+#define _MPU9250_CALIB_H_
+
+#include <stdbool.h>
+#include "mpu9250.h"
+
+#define MPU9250_CALIB_WINDOW			(100)	/* samples per stationary window */
+#define MPU9250_CALIB_GYRO_STD_MAX		(0.5f)	/* digree/s, stationary below */
+#define MPU9250_CALIB_ACCEL_STD_MAX		(0.01f)	/* G, stationary below */
+#define MPU9250_CALIB_POSES				(24)	/* accel orientations kept */
+#define MPU9250_CALIB_MAG_MIN			(100)	/* samples for the ellipsoid fit */
+#define MPU9250_CALIB_FILE				"mpu9250_calib.txt"	/* in app_get_data_path */
+
+typedef enum {
+	MPU9250_CALIB_GYRO = 0x01,
+	MPU9250_CALIB_ACCEL = 0x02,
+	MPU9250_CALIB_MAG = 0x04,
+} mpu9250_calib_part_e;
+
+/** calibration result, the parts in valid are usable */
+typedef struct{
+	unsigned int valid;					/* mpu9250_calib_part_e */
+	float gyro_bias[3];					/* digree/s */
+	float accel_offset[3];				/* G */
+	float mag_offset[3];				/* hard iron */
+	float mag_matrix[3][3];				/* soft iron, ellipsoid to a sphere of mag_radius */
+	float mag_radius;
+	float temp;							/* chip temperature of the stationary windows */
+}mpu9250_calib_data_s;
+
+typedef struct{
+	unsigned int windows;				/* complete windows */
+	unsigned int stationary;			/* windows quiet enough for gyro bias */
+	unsigned int poses;					/* distinct accel orientations */
+	unsigned int mag_samples;
+}mpu9250_calib_stats_s;
+
+typedef struct _mpu9250_calib_s *mpu9250_calib_h;
+
+/*
+ * Collects samples taken with the chip offsets cleared
+ * (resource_mpu9250_set_offsets(NULL, NULL)) and no magnetometer correction.
+ *   gyro  : mean of the stationary windows
+ *   accel : sphere fit of the stationary orientations, with fewer than 4
+ *           the one seen longest is taken as lying on an axis
+ *   mag   : ellipsoid fit, needs the device turned through all directions
+ */
+bool mpu9250_calib_create(mpu9250_calib_h *calib);
+void mpu9250_calib_destroy(mpu9250_calib_h calib);
+void mpu9250_calib_feed(mpu9250_calib_h calib, const MPU9250_sample *samples, int num);
+void mpu9250_calib_feed_mag(mpu9250_calib_h calib, const MPU9250_magnetometer_val *mag);
+void mpu9250_calib_get_stats(mpu9250_calib_h calib, mpu9250_calib_stats_s *stats);
+unsigned int mpu9250_calib_solve(mpu9250_calib_h calib, mpu9250_calib_data_s *data);
+
+/* MPU9250_CALIB_FILE, kept across restarts */
+bool mpu9250_calib_save(const mpu9250_calib_data_s *data);
+bool mpu9250_calib_load(mpu9250_calib_data_s *data);
+
+/* gyro & accel into the offset registers, magnetometer on the host; after every dev_init */
+bool mpu9250_calib_apply(const mpu9250_calib_data_s *data);
+
+#endif /* _MPU9250_CALIB_H_ */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MTIME_H_
+#define _MTIME_H_
+
+#include <stdbool.h>
+
+/*
+ * monotonic time base for protocol timeouts & sample timestamps
+ * CLOCK_MONOTONIC, or a virtual clock that only moves when told to
+ */
+long long mtime_now_us(void);
+long long mtime_now_ms(void);
+double mtime_now(void);							/* sec, drop-in for ecore_time_get() */
+
+/* last value taken by mtime_update(), for hot loops, any thread may read it */
+long long mtime_update(void);
+long long mtime_cached_us(void);
+
+/* sleep on the real clock, advance the virtual one without waiting */
+void mtime_sleep_us(long long us);
+
+/*
+ * virtual clock, timeout paths run at full speed in tests
+ */
+void mtime_virtual_start(long long start_us);
+void mtime_virtual_advance(long long us);
+void mtime_virtual_stop(void);
+bool mtime_is_virtual(void);
+
+#endif /* _MTIME_H_ */
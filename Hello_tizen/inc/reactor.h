@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+#include "uart.h"
+
+#define REACTOR_TX_BUF_SIZE				(1024)
+#define REACTOR_POLL_INTERVAL			(0.01)	/* sec, peripheral-io ports without fd */
+
+typedef struct _reactor_source_s *reactor_source_h;
+
+/**
+ * @brief called from the main loop with bytes received on the port.
+ */
+typedef void (*reactor_read_cb)(reactor_source_h source, const uint8_t *data, int len, void *user_data);
+
+/*
+ * Ecore main loop I/O for serial devices
+ * ports opened on a tty node (config.dev_path) are watched by fd and cost
+ * nothing while idle, peripheral-io does not expose an fd, so those ports
+ * are polled every REACTOR_POLL_INTERVAL even when nothing arrives
+ */
+bool reactor_add_port(uart_port_h port, reactor_read_cb read_cb, void *user_data, reactor_source_h *source);
+void reactor_remove(reactor_source_h source);
+bool reactor_write(reactor_source_h source, const uint8_t *data, uint32_t length);
+uint32_t reactor_tx_pending(reactor_source_h source);
+uart_port_h reactor_get_port(reactor_source_h source);
+
+#endif /* _REACTOR_H_ */
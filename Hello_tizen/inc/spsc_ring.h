@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+#include <stdbool.h>
+
+typedef struct _spsc_ring_s *spsc_ring_h;
+
+/*
+ * lock-free ring for one producer thread and one consumer thread
+ * elements are used in place : reserve / commit on the producer side,
+ * peek / release on the consumer side, both return contiguous runs
+ */
+bool spsc_ring_create(unsigned int elem_size, unsigned int capacity, spsc_ring_h *ring);	/* capacity : power of 2 */
+void spsc_ring_destroy(spsc_ring_h ring);
+
+/* producer */
+unsigned int spsc_ring_reserve(spsc_ring_h ring, void **elems, unsigned int max);
+void spsc_ring_commit(spsc_ring_h ring, unsigned int n);
+
+/* consumer */
+unsigned int spsc_ring_peek(spsc_ring_h ring, void **elems, unsigned int max);
+void spsc_ring_release(spsc_ring_h ring, unsigned int n);
+
+unsigned int spsc_ring_count(spsc_ring_h ring);
+unsigned int spsc_ring_capacity(spsc_ring_h ring);
+
+#endif /* _SPSC_RING_H_ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UART_H_
+#define _UART_H_
+
+#include <peripheral_io.h>
+#include <sys/uio.h>
+
+#define UART_PORT_ANCHOR3				(1)		// RPI3 : UART0, ANCHOR3 : UART1
+#define UART_RX_BUF_SIZE				(256)
+#define UART_TX_BUF_SIZE				(256)
+#define UART_IOV_MAX					(8)		/* pieces per uart_port_writev */
+
+typedef enum{
+	UART_FLOW_CONTROL_NONE = 0,		/* no flow control */
+	UART_FLOW_CONTROL_RTSCTS,		/* hardware RTS/CTS */
+	UART_FLOW_CONTROL_XONXOFF,		/* software XON/XOFF, text only sessions */
+}uart_flow_control_e;
+
+typedef struct{
+	unsigned int tx_bytes;
+	unsigned int rx_bytes;
+	unsigned int tx_errors;			/* failed writes */
+	unsigned int rx_errors;			/* failed reads */
+	unsigned int overrun;			/* bytes lost in UART / tty buffer */
+	unsigned int framing;			/* framing & parity errors */
+}uart_stats_s;
+
+/**
+ * @struct uart_port_config_s
+ * @brief UART port configuration, 8N1 is always used.
+ */
+typedef struct{
+	int port;								/*!< peripheral-io UART port number */
+	const char *dev_path;					/*!< tty device node (pty, USB serial), used instead of port when set */
+	peripheral_uart_baud_rate_e baud_rate;
+	uart_flow_control_e flow;
+}uart_port_config_s;
+
+typedef struct _uart_port_s *uart_port_h;
+
+/*
+ * UART port object, one per device
+ */
+bool uart_port_open(const uart_port_config_s *config, uart_port_h *port);
+void uart_port_close(uart_port_h port);
+bool uart_port_set_baud_rate(uart_port_h port, peripheral_uart_baud_rate_e baud_rate);
+peripheral_uart_baud_rate_e uart_port_get_baud_rate(uart_port_h port);
+bool uart_port_set_flow_control(uart_port_h port, uart_flow_control_e flow);
+bool uart_port_write(uart_port_h port, const uint8_t *data, uint32_t length);
+int uart_port_write_some(uart_port_h port, const uint8_t *data, uint32_t length);
+bool uart_port_writev(uart_port_h port, const struct iovec *iov, int iovcnt);
+int uart_port_read(uart_port_h port, uint8_t *data, uint32_t length);
+peripheral_error_e uart_port_read_byte(uart_port_h port, uint8_t *data);
+int uart_port_read_timeout(uart_port_h port, uint8_t *data, uint32_t length, int timeout_ms);
+bool uart_port_read_data(uart_port_h port, uint8_t *data, uint32_t length, bool blocking_mode);
+void uart_port_flush(uart_port_h port);
+int uart_port_get_fd(uart_port_h port);
+bool uart_port_rx_buffered(uart_port_h port);
+void uart_port_get_stats(uart_port_h port, uart_stats_s *stats);
+void uart_port_reset_stats(uart_port_h port);
+bool uart_port_open_pty(peripheral_uart_baud_rate_e baud_rate, uart_port_h *port, int *peer);
+
+#endif /* _UART_H_ */
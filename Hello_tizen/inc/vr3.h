@@ -19,7 +19,28 @@
 #ifndef _VR3_H_
 #define _VR3_H_
 
+#include "uart.h"
+
 #define VR_DEFAULT_TIMEOUT				(1000)
+#define VR_FRAME_MIN					(4)		/* head, length, cmd, end */
+#define VR_FRAME_MAX					(2+255)	/* head, length byte & what it counts */
+#define VR_IDLE_GAP						(20)	/* ms without a byte ends a partial frame */
+#define VR_RECORD_NUM					(256)	/* record numbers the length byte allows */
+#define VR_RECORD_ANY					(-1)	/* catch-all subscription */
+#define VR_SIG_MAX						(32)	/* signature bytes kept in the cache */
+#define VR_TRAIN_UNKNOWN				(0xF0)	/* train status not known */
+#define VR_TRAIN_ALL_PKTS				(51)	/* packets answering a check of all records */
+#define VR_RECOGNIZER_SLOTS				(7)		/* records the recognizer holds at once */
+#define VR_CONTEXT_MAX					(8)
+#define VR_BAUD_MAX						(38400)	/* fastest rate VR3 supports */
+#define VR_BAUD_PROBE_TIMEOUT			(100)	/* ms, CHECK_SYSTEM answer at a probed rate */
+#define VR_SIG_NAME_MAX					(10)	/* signature given as a string */
+#define VR_TRAIN_TIMEOUT				(8000)	/* ms, the user has to speak */
+#define VR_TRAIN_BATCH_MAX				(126)	/* records per FRAME_CMD_TRAIN, its answer length byte limits it */
+#define VR_PIPELINE_DEPTH				(4)		/* frames sent ahead of their answers */
+
+#define VR_STA_OK						(0x00)
+#define VR_STA_FAILED					(0xF1)	/* no answer, error frame or bad argument, never sent by the module */
 
 /***************************************************************************/
 #define FRAME_HEAD						(0xAA)
@@ -59,6 +80,7 @@
 #define FRAME_CMD_VR					(0x0D)	//Voice recognized
 #define FRAME_CMD_PROMPT				(0x0A)
 #define FRAME_CMD_ERROR					(0xFF)
+#define FRAME_CMD_NONE					(0xF0)	//not sent by the module, left in buf when no frame arrived
 
 /***************************************************************************/
 // #define FRAME_ERR_UDCMD				(0x00)
@@ -110,43 +132,136 @@ typedef enum{
 } group_t;
 
 
-/* 
- * resource for serial port 
+/** one VR3 module, every handle_VR_* / resource_VR_* call takes it */
+typedef struct _vr3_s *vr3_h;
+
+/**
+ * @brief called with each complete frame, FRAME_HEAD to FRAME_END.
+ * frame points into the parser, do not feed the same parser from here,
+ * set stop to keep further frames in the parser for the next call.
  */
-bool resource_serial_init(void);
-bool resource_write_data(uint8_t *data, uint32_t length);
-bool resource_read_data(uint8_t *data, uint32_t length, bool blocking_mode);
-void resource_serial_fini(void);
+typedef void (*vr_frame_cb)(const uint8_t *frame, int len, void *user_data);
+
+typedef struct{
+	uint8_t buf[VR_FRAME_MAX];
+	int pos;
+	vr_frame_cb frame_cb;
+	void *user_data;
+	unsigned int frames;			/* frames emitted */
+	unsigned int bad_frames;		/* heads dropped for bad length or FRAME_END */
+	unsigned int dropped;			/* bytes skipped while resyncing */
+	bool stop;
+}vr_parser_s;
+
+/*
+ * VR3 frame parser, bytes in any chunk size
+ */
+void vr_parser_init(vr_parser_s *parser, vr_frame_cb frame_cb, void *user_data);
+void vr_parser_reset(vr_parser_s *parser);
+int vr_parser_feed(vr_parser_s *parser, const uint8_t *data, int len);
+void vr_parser_flush(vr_parser_s *parser);
+
+/**
+ * @brief recognized record, from a FRAME_CMD_VR frame.
+ */
+typedef struct{
+	uint8_t group;					/*!< FF: none, 0x8n: user group, 0x0n: system group */
+	uint8_t record;					/*!< record number recognized */
+	uint8_t index;					/*!< position of the record in the recognizer */
+	uint8_t sig_len;
+	const uint8_t *sig;				/*!< signature, valid during the callback only */
+	long long rx_us;				/*!< CLOCK_MONOTONIC time the frame was read from the port */
+}vr_event_s;
+
+typedef void (*vr_event_cb)(const vr_event_s *event, void *user_data);
+
+typedef struct{
+	unsigned int events;			/* dispatched to a subscriber */
+	unsigned int unhandled;			/* no subscriber, not even catch-all */
+	unsigned int other_frames;		/* not FRAME_CMD_VR */
+	unsigned int latency_min_us;
+	unsigned int latency_max_us;
+	unsigned long long latency_sum_us;
+}vr_event_stats_s;
 
 /* 
  * resource for VR3 Voice Recognition Module 
  */
 int millis(void);
-void resource_VR_send_cmd2_pkt(uint8_t cmd, uint8_t subcmd, uint8_t *buf, uint8_t len);
-void resource_VR_send_cmd_pkt(uint8_t cmd, uint8_t *buf, uint8_t len);
-void resource_VR_send_pkt(uint8_t *buf, uint8_t len);
-int resource_VR_receive(uint8_t *buf, int len, uint16_t timeout);
-int resource_VR_receive_pkt(uint8_t *buf, uint16_t timeout);
+bool resource_VR_open(uart_port_h port, vr3_h *vr);
+void resource_VR_close(vr3_h vr);
+uart_port_h resource_VR_get_port(vr3_h vr);
+void resource_VR_setTimeout(vr3_h vr, int timeout);
+void resource_VR_send_cmd2_pkt(vr3_h vr, uint8_t cmd, uint8_t subcmd, uint8_t *buf, uint8_t len);
+void resource_VR_send_cmd_pkt(vr3_h vr, uint8_t cmd, uint8_t *buf, uint8_t len);
+void resource_VR_send_pkt(vr3_h vr, uint8_t *buf, uint8_t len);
+int resource_VR_receive(vr3_h vr, uint8_t *buf, int len, uint16_t timeout);
+int resource_VR_receive_pkt(vr3_h vr, uint8_t *buf, uint16_t timeout);
 int resource_VR_cleanDup(uint8_t *des, uint8_t *buf, int len);
-void resource_VR_setup(void);
+void resource_VR_setup(vr3_h vr);
 void resource_VR_printVR(uint8_t *buf);
 
 
 /* 
  * handle VR3 Voice Recognition Module 
  */
-int handle_VR_recognize(uint8_t *buf, int timeout);
-int handle_VR_load(uint8_t *records, uint8_t len, uint8_t *buf);
-int handle_VR_load_one(uint8_t record, uint8_t *buf);
-int handle_VR_setAutoLoad(uint8_t *records, uint8_t len);
-int handle_VR_disableAutoLoad(void);
-int handle_VR_setSignature(uint8_t record, const void *buf, uint8_t len);
-int handle_VR_deleteSignature(uint8_t record);
-int handle_VR_checkSignature(uint8_t record, uint8_t *buf);
-int handle_VR_clear(void);
-int handle_VR_checkRecognizer(uint8_t *buf);
-int handle_VR_checkRecord(uint8_t *buf, uint8_t *records, uint8_t len);
-void handle_VR_loop_check(void);
+int handle_VR_recognize(vr3_h vr, uint8_t *buf, int timeout);
+int handle_VR_load(vr3_h vr, uint8_t *records, uint8_t len, uint8_t *buf);
+int handle_VR_load_one(vr3_h vr, uint8_t record, uint8_t *buf);
+int handle_VR_setAutoLoad(vr3_h vr, uint8_t *records, uint8_t len);
+int handle_VR_disableAutoLoad(vr3_h vr);
+int handle_VR_setSignature(vr3_h vr, uint8_t record, const void *buf, uint8_t len);
+int handle_VR_deleteSignature(vr3_h vr, uint8_t record);
+int handle_VR_checkSignature(vr3_h vr, uint8_t record, uint8_t *buf);
+int handle_VR_clear(vr3_h vr);
+int handle_VR_checkRecognizer(vr3_h vr, uint8_t *buf);
+int handle_VR_checkRecord(vr3_h vr, uint8_t *buf, uint8_t *records, uint8_t len);
+void handle_VR_loop_check(vr3_h vr);
+
+/*
+ * cache of train status & signatures
+ */
+typedef struct{
+	unsigned int round_trips_avoided;	/* commands answered from memory */
+	unsigned int packets_avoided;		/* frames not sent nor received for them */
+}vr_cache_stats_s;
+
+void handle_VR_cache_invalidate(vr3_h vr);
+void handle_VR_cache_set_train(vr3_h vr, uint8_t record, uint8_t status);
+void handle_VR_cache_get_stats(vr3_h vr, vr_cache_stats_s *stats);
+
+/*
+ * recognizer slot manager, records grouped by context
+ */
+typedef struct{
+	unsigned int switches;				/* handle_VR_context_activate calls */
+	unsigned int hits;					/* context was resident already */
+	unsigned int loads;
+	unsigned int clears;
+	unsigned int records_loaded;
+	unsigned int latency_min_us;
+	unsigned int latency_max_us;
+	unsigned long long latency_sum_us;
+}vr_slot_stats_s;
+
+int handle_VR_context_define(vr3_h vr, int context, const uint8_t *records, uint8_t len);
+int handle_VR_context_activate(vr3_h vr, int context);
+int handle_VR_context_get_active(vr3_h vr);
+void handle_VR_slot_touch(vr3_h vr, uint8_t record);
+void handle_VR_slot_loaded(vr3_h vr, uint8_t record);
+void handle_VR_slot_cleared(vr3_h vr);
+void handle_VR_slot_invalidate(vr3_h vr);
+void handle_VR_slot_get_stats(vr3_h vr, vr_slot_stats_s *stats);
+void handle_VR_slot_reset_stats(vr3_h vr);
+
+/*
+ * recognition events from the main loop, no blocking
+ */
+bool handle_VR_event_start(vr3_h vr);
+void handle_VR_event_stop(vr3_h vr);
+void handle_VR_subscribe(vr3_h vr, int record, vr_event_cb cb, void *user_data);
+void handle_VR_event_get_stats(vr3_h vr, vr_event_stats_s *stats);
+void handle_VR_event_reset_stats(vr3_h vr);
 
 
 /* ---------------------------------------------------------------------------------------
@@ -154,27 +269,40 @@ void handle_VR_loop_check(void);
  */
 
 /******************************* TRAIN CONTROL ******************************/
-int handle_VR_train(uint8_t *records, uint8_t len, uint8_t *buf);
-int handle_VR_train_one(uint8_t record, uint8_t *buf);
-int handle_VR_trainWithSignature(uint8_t record, const void *buf, uint8_t len, uint8_t * retbuf);
+int handle_VR_train(vr3_h vr, uint8_t *records, uint8_t len, uint8_t *buf);
+int handle_VR_train_one(vr3_h vr, uint8_t record, uint8_t *buf);
+int handle_VR_trainWithSignature(vr3_h vr, uint8_t record, const void *buf, uint8_t len, uint8_t * retbuf);
+
+/******************************* BATCH CONTROL ******************************/
+/** one record of a batch */
+typedef struct{
+	uint8_t record;
+	const char *sig;				/*!< signature string, up to VR_SIG_NAME_MAX */
+}vr_record_req_s;
+
+int handle_VR_setSignatures(vr3_h vr, const vr_record_req_s *reqs, int num, uint8_t *status);
+int handle_VR_checkSignatures(vr3_h vr, const uint8_t *records, int num, uint8_t *status);
+int handle_VR_trainBatch(vr3_h vr, const vr_record_req_s *reqs, int num, uint8_t *status);
 
 /******************************* GROUP CONTROL ******************************/
-int handle_VR_setGroupControl(uint8_t ctrl);
-int handle_VR_checkGroupControl(void);
-int handle_VR_setUserGroup(uint8_t grp, uint8_t *records, uint8_t len);
-int handle_VR_checkUserGroup(uint8_t grp, uint8_t *buf);
-int handle_VR_loadSystemGroup(uint8_t grp, uint8_t *buf);
-int handle_VR_loadUserGroup(uint8_t grp, uint8_t *buf);
-int handle_VR_restoreSystemSettings(void);
-int handle_VR_checkSystemSettings(uint8_t* buf);
+int handle_VR_setGroupControl(vr3_h vr, uint8_t ctrl);
+int handle_VR_checkGroupControl(vr3_h vr);
+int handle_VR_setUserGroup(vr3_h vr, uint8_t grp, uint8_t *records, uint8_t len);
+int handle_VR_checkUserGroup(vr3_h vr, uint8_t grp, uint8_t *buf);
+int handle_VR_loadSystemGroup(vr3_h vr, uint8_t grp, uint8_t *buf);
+int handle_VR_loadUserGroup(vr3_h vr, uint8_t grp, uint8_t *buf);
+int handle_VR_restoreSystemSettings(vr3_h vr);
+int handle_VR_checkSystemSettings(vr3_h vr, uint8_t* buf);
 
 /***************************** RESOURCE CONTROL *****************************/
-int resource_VR_setBaudRate(unsigned long br);
-int resource_VR_setIOMode(io_mode_t mode);
-int resource_VR_resetIO(uint8_t *ios, uint8_t len);
-int resource_VR_setPulseWidth(uint8_t level);
-int resource_VR_test(uint8_t cmd, uint8_t *bsr);
-int resource_VR_writehex(uint8_t *buf, uint8_t len);
+int resource_VR_setBaudRate(vr3_h vr, unsigned long br);
+int resource_VR_probeBaudRate(vr3_h vr);
+int resource_VR_negotiateBaudRate(vr3_h vr);
+int resource_VR_setIOMode(vr3_h vr, io_mode_t mode);
+int resource_VR_resetIO(vr3_h vr, uint8_t *ios, uint8_t len);
+int resource_VR_setPulseWidth(vr3_h vr, uint8_t level);
+int resource_VR_test(vr3_h vr, uint8_t cmd, uint8_t *bsr);
+int resource_VR_writehex(vr3_h vr, uint8_t *buf, uint8_t len);
 
 
 #endif /* _VR3_H_ */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VR3_EMU_H_
+#define _VR3_EMU_H_
+
+#include "vr3.h"
+
+#define VR_EMU_RECORDS					(80)	/* records the module has */
+#define VR_EMU_SCRIPT_MAX				(1024)	/* scripted recognitions queued at once */
+
+typedef struct _vr_emu_s *vr_emu_h;
+
+typedef struct{
+	bool link_delay;					/* take as long as the bytes need on the link */
+	unsigned int cmd_delay_us;			/* module think time per command */
+	unsigned int train_prompt_ms;		/* time the user takes per training prompt */
+	unsigned int noise_every;			/* noise burst in front of every n-th frame, 0: none */
+	unsigned int noise_max;				/* bytes per burst, 1 ~ noise_max */
+}vr_emu_config_s;
+
+/** recognition played by the module, delay_ms after the previous one */
+typedef struct{
+	unsigned int delay_ms;
+	uint8_t record;
+}vr_emu_event_s;
+
+typedef struct{
+	unsigned int requests;				/* commands answered */
+	unsigned int frames;				/* frames sent */
+	unsigned int events;				/* FRAME_CMD_VR frames sent */
+	unsigned int events_missed;			/* scripted record was not in the recognizer */
+	unsigned int noise_bytes;
+	unsigned long long bytes;
+}vr_emu_stats_s;
+
+/*
+ * VR3 module emulator on a pty, runs on its own thread
+ * starts at 9600 baud, even records below VR_EMU_RECORDS trained as "rec<n>"
+ */
+bool vr_emu_start(const vr_emu_config_s *config, vr_emu_h *emu);
+void vr_emu_stop(vr_emu_h emu);
+uart_port_h vr_emu_get_port(vr_emu_h emu);
+void vr_emu_restart(vr_emu_h emu);
+bool vr_emu_play(vr_emu_h emu, const vr_emu_event_s *script, int num);
+bool vr_emu_playing(vr_emu_h emu);
+void vr_emu_get_stats(vr_emu_h emu, vr_emu_stats_s *stats);
+
+#endif /* _VR3_EMU_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VR3_INTERNAL_H_
+#define _VR3_INTERNAL_H_
+
+/*
+ * VR3 driver state, shared by handle_vr3*.c only
+ */
+#include "vr3.h"
+#include "reactor.h"
+
+/** train status & signatures as last seen on the module */
+typedef struct{
+	uint8_t train[VR_RECORD_NUM];			/* VR_TRAIN_UNKNOWN until queried */
+	bool train_all;							/* every record is known */
+	bool sig_valid[VR_RECORD_NUM];
+	uint8_t sig_len[VR_RECORD_NUM];
+	uint8_t sig[VR_RECORD_NUM][VR_SIG_MAX];
+	vr_cache_stats_s stats;
+}vr_cache_s;
+
+/** frame handed over by the parser to resource_VR_receive_pkt */
+typedef struct{
+	vr_parser_s parser;						/* keeps bytes read past a frame */
+	uint8_t *buf;
+	int len;
+}vr_rx_s;
+
+typedef struct{
+	uint8_t records[VR_RECOGNIZER_SLOTS];
+	uint8_t len;
+}vr_context_s;
+
+/** what the recognizer holds, as far as the driver knows */
+typedef struct{
+	vr_context_s contexts[VR_CONTEXT_MAX];
+	int context_active;
+	uint8_t resident[VR_RECOGNIZER_SLOTS];
+	int resident_num;
+	bool resident_known;
+	long long last_used[VR_RECORD_NUM];
+	vr_slot_stats_s stats;
+}vr_slot_s;
+
+typedef struct{
+	vr_event_cb cb;
+	void *user_data;
+}vr_subscription_s;
+
+typedef struct{
+	vr_subscription_s subs[VR_RECORD_NUM];
+	vr_subscription_s sub_any;
+	reactor_source_h source;
+	vr_parser_s parser;
+	vr_event_stats_s stats;
+	long long rx_us;						/* when the current chunk came from the port */
+	bool dispatching;						/* inside the parser, vr must stay */
+	bool close_pending;						/* resource_VR_close called from a subscriber */
+}vr_event_state_s;
+
+struct _vr3_s {
+	uart_port_h port;						/* owned by the caller */
+	int timeout;							/* ms, command answers */
+	uint8_t buf[VR_FRAME_MAX];				/* last frame received */
+	vr_rx_s rx;
+	vr_cache_s cache;
+	vr_slot_s slot;
+	vr_event_state_s event;
+};
+
+#endif /* _VR3_INTERNAL_H_ */
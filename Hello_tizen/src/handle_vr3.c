@@ -28,8 +28,14 @@
 #include <unistd.h>
 #include <app_common.h>
 #include <time.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "hello_tizen.h"
 #include "hello.h"
 #include "vr3.h"
+#include "vr3_internal.h"
+#include "vr3_emu.h"
+#include "mtime.h"
 
 /* Record for test */
 #define onRecord    (1)		/* On record */
@@ -37,19 +43,149 @@
 #define fwRecord    (3)		/* Forward record */
 #define bwRecord    (4)		/* Backward record */
 
-static int timeout = VR_DEFAULT_TIMEOUT;
 
-/** temp data buffer */
-uint8_t vr_buf[32];
-uint8_t hextab[17]="0123456789ABCDEF";
+int millis(void)
+{
+    // a current time of milliseconds, wraps after 24.8 days : use mtime_now_ms for intervals
+    return mtime_now_ms();
+}
 
+/* frame handed over by the parser to resource_VR_receive_pkt */
+static void resource_VR_frame_cb(const uint8_t *frame, int len, void *user_data)
+{
+	vr_rx_s *rx = user_data;
 
-int millis(void)
+	memcpy(rx->buf, frame, len);
+	rx->len = len;
+	rx->parser.stop = true;
+}
+
+/**
+    @brief driver context for a Voice Recognition module on an opened UART port.
+           contexts share nothing, one per thread needs no locking.
+    @param port --> UART port, stays owned by the caller.
+           vr --> new context.
+*/
+bool resource_VR_open(uart_port_h port, vr3_h *vr)
+{
+	vr3_h v;
+
+	if(port == NULL || vr == NULL){
+		return false;
+	}
+
+	v = calloc(1, sizeof(*v));
+	if(v == NULL){
+		LOGE("out of memory");
+		return false;
+	}
+
+	v->port = port;
+	v->timeout = VR_DEFAULT_TIMEOUT;
+	v->slot.context_active = -1;
+	vr_parser_init(&v->rx.parser, resource_VR_frame_cb, &v->rx);
+	handle_VR_cache_invalidate(v);
+	handle_VR_slot_invalidate(v);
+
+	*vr = v;
+	return true;
+}
+
+/**
+    @brief free the context, the UART port is not closed.
+           safe from a subscriber, the free waits until the chunk is done.
+*/
+void resource_VR_close(vr3_h vr)
+{
+	if(vr == NULL){
+		return;
+	}
+
+	handle_VR_event_stop(vr);
+	if(vr->event.dispatching){
+		vr->event.close_pending = true;
+		return;
+	}
+	free(vr);
+}
+
+uart_port_h resource_VR_get_port(vr3_h vr)
+{
+	return vr->port;
+}
+
+/**
+    @brief time to wait for a command answer, ms.
+*/
+void resource_VR_setTimeout(vr3_h vr, int timeout)
 {
-    // a current time of milliseconds
-    return ( clock() * 1000 / CLOCKS_PER_SEC );
+	vr->timeout = timeout;
 }
 
+/**
+    @brief forget cached train status & signatures,
+           for changes made behind the driver (module reset, other host).
+*/
+void handle_VR_cache_invalidate(vr3_h vr)
+{
+	memset(vr->cache.train, VR_TRAIN_UNKNOWN, sizeof(vr->cache.train));
+	memset(vr->cache.sig_valid, 0x0, sizeof(vr->cache.sig_valid));
+	vr->cache.train_all = false;
+}
+
+/**
+    @brief record train status seen on the wire or set by the driver.
+*/
+void handle_VR_cache_set_train(vr3_h vr, uint8_t record, uint8_t status)
+{
+	vr->cache.train[record] = status;
+	if (status == VR_TRAIN_UNKNOWN)
+		vr->cache.train_all = false;
+}
+
+static void handle_VR_cache_set_sig(vr3_h vr, uint8_t record, const uint8_t *sig, uint8_t len)
+{
+	if (len > VR_SIG_MAX) {
+		vr->cache.sig_valid[record] = false;
+		return;
+	}
+	memcpy(vr->cache.sig[record], sig, len);
+	vr->cache.sig_len[record] = len;
+	vr->cache.sig_valid[record] = true;
+}
+
+/**
+    @brief serial round trips answered from the cache.
+*/
+void handle_VR_cache_get_stats(vr3_h vr, vr_cache_stats_s *stats)
+{
+	if (stats != NULL)
+		*stats = vr->cache.stats;
+}
+
+/**
+    @brief write header, data area & FRAME_END in one transfer.
+    @param head --> FRAME_HEAD, length, command bytes
+           head_len --> length of head
+           buf --> data area
+           len --> length of buf
+*/
+static void resource_VR_write_frame(vr3_h vr, uint8_t *head, uint8_t head_len, uint8_t *buf, uint8_t len)
+{
+	static const uint8_t end = FRAME_END;
+	struct iovec iov[3];
+
+	iov[0].iov_base = head;
+	iov[0].iov_len = head_len;
+	iov[1].iov_base = buf;
+	iov[1].iov_len = len;
+	iov[2].iov_base = (void *)&end;
+	iov[2].iov_len = 1;
+
+	if (uart_port_writev(vr->port, iov, 3) == false) {
+		LOGE("uart_port_writev failed");
+	}
+}
 
 /**
     @brief send data packet in Voice Recognition module protocol format.
@@ -58,20 +194,11 @@ int millis(void)
            buf --> data area
            len --> length of buf
 */
-void resource_VR_send_cmd2_pkt(uint8_t cmd, uint8_t subcmd, uint8_t *buf, uint8_t len)
+void resource_VR_send_cmd2_pkt(vr3_h vr, uint8_t cmd, uint8_t subcmd, uint8_t *buf, uint8_t len)
 {
-	uint8_t data[len+5];
-
-	data[0] = FRAME_HEAD;
-	data[1] = len+3;
-	data[2] = cmd;
-	data[3] = subcmd;
-	memcpy(&data[4], buf, len);
-	data[len+4] = FRAME_END;
+	uint8_t head[4] = { FRAME_HEAD, len+3, cmd, subcmd };
 
-	if (resource_write_data(&data[0], len+5) == false) {
-		LOGE("resource_write_data failed");
-	}
+	resource_VR_write_frame(vr, head, sizeof(head), buf, len);
 }
 
 /**
@@ -80,19 +207,11 @@ void resource_VR_send_cmd2_pkt(uint8_t cmd, uint8_t subcmd, uint8_t *buf, uint8_
            buf --> data area
            len --> length of buf
 */
-void resource_VR_send_cmd_pkt(uint8_t cmd, uint8_t *buf, uint8_t len)
+void resource_VR_send_cmd_pkt(vr3_h vr, uint8_t cmd, uint8_t *buf, uint8_t len)
 {
-	uint8_t data[len+4];
-
-	data[0] = FRAME_HEAD;
-	data[1] = len+2;
-	data[2] = cmd;
-	memcpy(&data[3], buf, len);
-	data[len+3] = FRAME_END;
+	uint8_t head[3] = { FRAME_HEAD, len+2, cmd };
 
-	if (resource_write_data(&data[0], len+4) == false) {
-		LOGE("resource_write_data failed");
-	}
+	resource_VR_write_frame(vr, head, sizeof(head), buf, len);
 }
 
 /**
@@ -100,18 +219,11 @@ void resource_VR_send_cmd_pkt(uint8_t cmd, uint8_t *buf, uint8_t len)
     @param buf --> data area
            len --> length of buf
 */
-void resource_VR_send_pkt(uint8_t *buf, uint8_t len)
+void resource_VR_send_pkt(vr3_h vr, uint8_t *buf, uint8_t len)
 {
-	uint8_t data[len+3];
+	uint8_t head[2] = { FRAME_HEAD, len+1 };
 
-	data[0] = FRAME_HEAD;
-	data[1] = len+1;
-	memcpy(&data[2], buf, len);
-	data[len+2] = FRAME_END;
-
-	if (resource_write_data(&data[0], len+3) == false) {
-		LOGE("resource_write_data failed");
-	}
+	resource_VR_write_frame(vr, head, sizeof(head), buf, len);
 }
 
 
@@ -119,50 +231,71 @@ void resource_VR_send_pkt(uint8_t *buf, uint8_t len)
     @brief receive data .
     @param buf --> return value buffer.
            len --> length expect to receive.
-           timeout --> time of reveiving
+           timeout --> time of reveiving, ms
     @retval number of received bytes, 0 means no data received.
 */
-int resource_VR_receive(uint8_t *buf, int len, uint16_t timeout)
+int resource_VR_receive(vr3_h vr, uint8_t *buf, int len, uint16_t timeout)
 {
 	int ret;
 
-	if (resource_read_data(buf, len, true) == false) {
-		LOGE("resource_read_data failed");
-		ret = false;
+	ret = uart_port_read_timeout(vr->port, buf, len, timeout);
+	if (ret < 0) {
+		LOGE("uart_port_read_timeout failed, ret [%d]", ret);
+		return 0;
 	}
-	ret = len;
 
 	return ret;
 }
 
 /**
     @brief receive a valid data packet in Voice Recognition module protocol format.
-    @param buf --> return value buffer.
-           timeout --> time of reveiving
+           noise and broken frames in front of it are skipped.
+    @param buf --> return value buffer, VR_FRAME_MAX bytes.
+           timeout --> time of reveiving, ms
     @retval '>0' --> success, packet lenght(length of all data in buf)
-            '<0' --> failed
+            '<0' --> failed, no valid packet within timeout,
+                     buf[2] is FRAME_CMD_NONE then
 */
-int resource_VR_receive_pkt(uint8_t *buf, uint16_t timeout)
+int resource_VR_receive_pkt(vr3_h vr, uint8_t *buf, uint16_t timeout)
 {
-	int ret;
-	ret = resource_VR_receive(buf, 2, timeout);
-	if(ret != 2){
-		return -1;
-	}
-	if(buf[0] != FRAME_HEAD){
-		return -2;
-	}
-	if(buf[1] < 2){
-		return -3;
+	vr_parser_s *parser = &vr->rx.parser;
+	unsigned int dropped = parser->dropped;
+	long long start = mtime_now_ms(), elapsed;
+	int remain = timeout;
+	int wait;
+	uint8_t ch;
+
+	vr->rx.buf = buf;
+	vr->rx.len = 0;
+
+	/* a frame may be left from the last call, then one byte at a time */
+	vr_parser_feed(parser, NULL, 0);
+	while (vr->rx.len == 0) {
+		wait = (parser->pos > 0 && remain > VR_IDLE_GAP) ? VR_IDLE_GAP : remain;
+		if (uart_port_read_timeout(vr->port, &ch, 1, wait) == 1) {
+			vr_parser_feed(parser, &ch, 1);
+		} else if (parser->pos > 0) {
+			/* a bad length byte holds the frame, look behind it */
+			vr_parser_flush(parser);
+		} else if (remain <= 0) {
+			break;
+		}
+		elapsed = mtime_now_ms() - start;
+		remain = elapsed < timeout ? timeout - (int)elapsed : 0;
 	}
-	ret = resource_VR_receive(buf+2, buf[1], timeout);
-	if(buf[buf[1]+1] != FRAME_END){
-		return -4;
+
+	if (parser->dropped != dropped)
+		LOGE("skipped [%u] bytes", parser->dropped - dropped);
+	if (vr->rx.len == 0) {
+		/* an earlier frame left in buf must not pass for the answer */
+		buf[1] = 0;
+		buf[2] = FRAME_CMD_NONE;
+		return -1;
 	}
 
 	//LOGI(buf, buf[1]+2);
 
-	return buf[1]+2;
+	return vr->rx.len;
 }
 
 /** remove duplicates */
@@ -199,16 +332,16 @@ int resource_VR_cleanDup(uint8_t *des, uint8_t *buf, int len)
 		timeout --> wait time for receiving packet.
 	@retval length of valid data in buf. 0 means no data received.
 */
-int handle_VR_recognize(uint8_t *buf, int timeout)
+int handle_VR_recognize(vr3_h vr, uint8_t *buf, int timeout)
 {
 	int ret, i;
-	ret = resource_VR_receive_pkt(vr_buf, timeout);
-	if(vr_buf[2] != FRAME_CMD_VR){
+	ret = resource_VR_receive_pkt(vr, vr->buf, timeout);
+	if(vr->buf[2] != FRAME_CMD_VR){
 		return -1;
 	}
 	if(ret > 0){
-		for(i = 0; i < (vr_buf[1] - 3); i++){
-			buf[i] = vr_buf[4+i];
+		for(i = 0; i < (vr->buf[1] - 3); i++){
+			buf[i] = vr->buf[4+i];
 		}
 		return i;
 	}
@@ -217,6 +350,18 @@ int handle_VR_recognize(uint8_t *buf, int timeout)
 }
 
 
+/* records the load answer in vr->buf reports as loaded or already there */
+static void handle_VR_load_update_slots(vr3_h vr)
+{
+	int i;
+
+	for(i=0; i+1<vr->buf[1]-3; i+=2){
+		if(vr->buf[5+i] == 0x00 || vr->buf[5+i] == 0xFC){
+			handle_VR_slot_loaded(vr, vr->buf[4+i]);
+		}
+	}
+}
+
 /**
     @brief Load records to recognizer.
     @param records --> record data buffer pointer.
@@ -235,20 +380,21 @@ int handle_VR_recognize(uint8_t *buf, int timeout)
             0 --> success, buf=0, and no data returned.
             '<0' --> failed.
 */
-int handle_VR_load(uint8_t *records, uint8_t len, uint8_t *buf)
+int handle_VR_load(vr3_h vr, uint8_t *records, uint8_t len, uint8_t *buf)
 {
-	uint8_t ret;
-	resource_VR_send_cmd_pkt(FRAME_CMD_LOAD, records, len);
-	ret = resource_VR_receive_pkt(vr_buf, timeout);
+	int ret;
+	resource_VR_send_cmd_pkt(vr, FRAME_CMD_LOAD, records, len);
+	ret = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 	if(ret<=0){
 		return -1;
 	}
-	if(vr_buf[2] != FRAME_CMD_LOAD){
+	if(vr->buf[2] != FRAME_CMD_LOAD){
 		return -1;
 	}
+	handle_VR_load_update_slots(vr);
 	if(buf != 0){
-		memcpy(buf, vr_buf+3, vr_buf[1]-2);
-		return vr_buf[1]-2;
+		memcpy(buf, vr->buf+3, vr->buf[1]-2);
+		return vr->buf[1]-2;
 	}
 	return 0;
 }
@@ -270,20 +416,21 @@ int handle_VR_load(uint8_t *records, uint8_t len, uint8_t *buf)
             0 --> success, buf=0, and no data returned.
             '<0' --> failed.
 */
-int handle_VR_load_one(uint8_t record, uint8_t *buf)
+int handle_VR_load_one(vr3_h vr, uint8_t record, uint8_t *buf)
 {
-	uint8_t ret;
-	resource_VR_send_cmd_pkt(FRAME_CMD_LOAD, &record, 1);
-	ret = resource_VR_receive_pkt(vr_buf, timeout);
+	int ret;
+	resource_VR_send_cmd_pkt(vr, FRAME_CMD_LOAD, &record, 1);
+	ret = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 	if(ret<=0){
 		return -1;
 	}
-	if(vr_buf[2] != FRAME_CMD_LOAD){
+	if(vr->buf[2] != FRAME_CMD_LOAD){
 		return -1;
 	}
+	handle_VR_load_update_slots(vr);
 	if(buf != 0){
-		memcpy(buf, vr_buf+3, vr_buf[1]-2);
-		return vr_buf[1]-2;
+		memcpy(buf, vr->buf+3, vr->buf[1]-2);
+		return vr->buf[1]-2;
 	}
 	return 0;
 }
@@ -295,7 +442,7 @@ int handle_VR_load_one(uint8_t record, uint8_t *buf)
     @retval 0 --> success
             -1 --> failed
 */
-int handle_VR_setAutoLoad(uint8_t *records, uint8_t len)
+int handle_VR_setAutoLoad(vr3_h vr, uint8_t *records, uint8_t len)
 {
 	int ret;
 	uint8_t map;
@@ -310,12 +457,12 @@ int handle_VR_setAutoLoad(uint8_t *records, uint8_t len)
 		return -1;
 	}
 
-	resource_VR_send_cmd2_pkt(FRAME_CMD_SET_AL, map, records, len);
-	ret = resource_VR_receive_pkt(vr_buf, timeout);
+	resource_VR_send_cmd2_pkt(vr, FRAME_CMD_SET_AL, map, records, len);
+	ret = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 	if(ret<=0){
 		return -1;
 	}
-	if(vr_buf[2] != FRAME_CMD_SET_AL){
+	if(vr->buf[2] != FRAME_CMD_SET_AL){
 		return -1;
 	}
 	return 0;
@@ -328,10 +475,10 @@ int handle_VR_setAutoLoad(uint8_t *records, uint8_t len)
     @retval 0 --> success
             -1 --> failed
 */
-int handle_VR_disableAutoLoad(void)
+int handle_VR_disableAutoLoad(vr3_h vr)
 {
 	/* record & len to 0 for disable */
-    return handle_VR_setAutoLoad(0, 0);
+    return handle_VR_setAutoLoad(vr, 0, 0);
 }
 
 
@@ -343,7 +490,7 @@ int handle_VR_disableAutoLoad(void)
     @retval 0 --> success, buf=0, and no data returned.
             '<0' --> failed.
 */
-int handle_VR_setSignature(uint8_t record, const void *buf, uint8_t len)
+int handle_VR_setSignature(vr3_h vr, uint8_t record, const void *buf, uint8_t len)
 {
 	int ret;
 
@@ -354,7 +501,7 @@ int handle_VR_setSignature(uint8_t record, const void *buf, uint8_t len)
 			return -1;
 		}
 		len = strlen((char *)buf);
-		if(len>10){
+		if(len>VR_SIG_NAME_MAX){
 			return -1;
 		}
 	}else if(len != 0 && buf != 0){
@@ -362,14 +509,17 @@ int handle_VR_setSignature(uint8_t record, const void *buf, uint8_t len)
 	}else{
 		return -1;
 	}
-	resource_VR_send_cmd2_pkt(FRAME_CMD_SET_SIG, record, (uint8_t *)buf, len);
-	ret = resource_VR_receive_pkt(vr_buf, timeout);
+	resource_VR_send_cmd2_pkt(vr, FRAME_CMD_SET_SIG, record, (uint8_t *)buf, len);
+	ret = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 	if(ret<=0){
+		vr->cache.sig_valid[record] = false;
 		return -1;
 	}
-	if(vr_buf[2] != FRAME_CMD_SET_SIG){
+	if(vr->buf[2] != FRAME_CMD_SET_SIG){
+		vr->cache.sig_valid[record] = false;
 		return -1;
 	}
+	handle_VR_cache_set_sig(vr, record, buf, len);
 	return 0;
 }
 
@@ -379,10 +529,10 @@ int handle_VR_setSignature(uint8_t record, const void *buf, uint8_t len)
     @retval  0 --> success
             -1 --> failed
 */
-int handle_VR_deleteSignature(uint8_t record)
+int handle_VR_deleteSignature(vr3_h vr, uint8_t record)
 {
 	/* buf & len to 0 for delete */
-    return handle_VR_setSignature(record, 0, 0);
+    return handle_VR_setSignature(vr, record, 0, 0);
 }
 
 /**
@@ -393,25 +543,32 @@ int handle_VR_deleteSignature(uint8_t record)
             0 --> success, buf=0, and no data returned.
             '<0' --> failed.
 */
-int handle_VR_checkSignature(uint8_t record, uint8_t *buf)
+int handle_VR_checkSignature(vr3_h vr, uint8_t record, uint8_t *buf)
 {
 	int ret;
 	if(record < 0){
 		return -1;
 	}
-	resource_VR_send_cmd2_pkt(FRAME_CMD_CHECK_SIG, record, 0, 0);
-	ret = resource_VR_receive_pkt(vr_buf, timeout);
+	if(vr->cache.sig_valid[record]){
+		vr->cache.stats.round_trips_avoided++;
+		vr->cache.stats.packets_avoided += 2;
+		memcpy(buf, vr->cache.sig[record], vr->cache.sig_len[record]);
+		return vr->cache.sig_len[record];
+	}
+	resource_VR_send_cmd2_pkt(vr, FRAME_CMD_CHECK_SIG, record, 0, 0);
+	ret = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 
 	if(ret<=0){
 		return -1;
 	}
-	if(vr_buf[2] != FRAME_CMD_CHECK_SIG){
+	if(vr->buf[2] != FRAME_CMD_CHECK_SIG){
 		return -1;
 	}
 
-	if(vr_buf[4]>0){
-		memcpy(buf, vr_buf+5, vr_buf[4]);
-		return vr_buf[4];
+	handle_VR_cache_set_sig(vr, record, vr->buf+5, vr->buf[4]);
+	if(vr->buf[4]>0){
+		memcpy(buf, vr->buf+5, vr->buf[4]);
+		return vr->buf[4];
 	}else{
 		return 0;
 	}
@@ -422,21 +579,22 @@ int handle_VR_checkSignature(uint8_t record, uint8_t *buf)
     @retval  0 --> success
             -1 --> failed
 */
-int handle_VR_clear(void)
+int handle_VR_clear(vr3_h vr)
 {
 	int len;
 
-	resource_VR_send_cmd_pkt(FRAME_CMD_CLEAR, 0, 0);
-	len = resource_VR_receive_pkt(vr_buf, timeout);
+	resource_VR_send_cmd_pkt(vr, FRAME_CMD_CLEAR, 0, 0);
+	len = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 	if(len<=0){
 		LOGE("Module Clear Fail...");
 		return -1;
 	}
 
-	if(vr_buf[2] != FRAME_CMD_CLEAR){
+	if(vr->buf[2] != FRAME_CMD_CLEAR){
 		LOGE("Module Clear Fail...");
 		return -1;
 	}
+	handle_VR_slot_cleared(vr);
 
 	LOGI("VR Module Cleared");
 	return 0;
@@ -454,67 +612,121 @@ int handle_VR_clear(void)
     @retval '>0' --> success, length of data in buf
             -1 --> failed
 */
-int handle_VR_checkRecognizer(uint8_t *buf)
+int handle_VR_checkRecognizer(vr3_h vr, uint8_t *buf)
 {
 	int len;
-	resource_VR_send_cmd_pkt(FRAME_CMD_CHECK_BSR, 0, 0);
-	len = resource_VR_receive_pkt(vr_buf, timeout);
+	resource_VR_send_cmd_pkt(vr, FRAME_CMD_CHECK_BSR, 0, 0);
+	len = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 	if(len<=0){
 		return -1;
 	}
 
-	if(vr_buf[2] != FRAME_CMD_CHECK_BSR){
+	if(vr->buf[2] != FRAME_CMD_CHECK_BSR){
 		return -1;
 	}
 
-	if(vr_buf[1] != 0x0D){
+	if(vr->buf[1] != 0x0D){
 		return -1;
 	}
 
-	memcpy(buf, vr_buf+3, vr_buf[1]-2);
+	memcpy(buf, vr->buf+3, vr->buf[1]-2);
 
-	return vr_buf[1]-2;
+	return vr->buf[1]-2;
 }
 
 /**
-    @brief check record train status.
+    @brief answer a check record train status from the cache.
+    @retval Number of trained records, -1 if a record is not cached
+*/
+static int handle_VR_checkRecord_cached(vr3_h vr, uint8_t *buf, uint8_t *records, uint8_t len)
+{
+	int i, trained = 0;
+
+	if(records == 0 && len == 0){
+		if(!vr->cache.train_all){
+			return -1;
+		}
+		memcpy(buf, vr->cache.train, 255);
+		for(i=0; i<255; i++){
+			trained += vr->cache.train[i] == 0x01;
+		}
+	}else{
+		for(i=0; i<len; i++){
+			if(vr->cache.train[records[i]] == VR_TRAIN_UNKNOWN){
+				return -1;
+			}
+		}
+		len = resource_VR_cleanDup(vr->buf, records, len);
+		for(i=0; i<len; i++){
+			buf[2*i+1] = vr->buf[i];
+			buf[2*i+2] = vr->cache.train[vr->buf[i]];
+			trained += buf[2*i+2] == 0x01;
+		}
+		buf[0] = len;
+	}
+
+	return trained;
+}
+
+/**
+    @brief check record train status, from the cache when every asked record is known.
     @param buf --> return value
              buf[0]     -->  Number of checked records
              buf[2i+1]  -->  Record number.
              buf[2i+2]  -->  Record train status. (00: untrained, 01: trained, FF: record value out of range)
              (i = 0 ~ buf[0]-1 )
-    @retval Number of trained records
+           records = 0 & len = 0 checks all records,
+             buf[record] --> train status, 255 bytes
+           len --> up to VR_TRAIN_BATCH_MAX records.
+    @retval Number of trained records, -1 --> failed
 */
-int handle_VR_checkRecord(uint8_t *buf, uint8_t *records, uint8_t len)
+int handle_VR_checkRecord(vr3_h vr, uint8_t *buf, uint8_t *records, uint8_t len)
 {
 	int ret;
 	int cnt = 0;
-	unsigned long start_millis;
+	long long start_millis;
+
+	if(len > VR_TRAIN_BATCH_MAX){
+		return -1;
+	}
+
+	if((records == 0 && len == 0) || (records != 0 && len > 0)){
+		ret = handle_VR_checkRecord_cached(vr, buf, records, len);
+		if(ret >= 0){
+			vr->cache.stats.round_trips_avoided++;
+			vr->cache.stats.packets_avoided += len ? 2 : 1 + VR_TRAIN_ALL_PKTS;
+			return ret;
+		}
+	}
+
 	if(records == 0 && len==0){
         memset(buf, 0xF0, 255);
-		resource_VR_send_cmd2_pkt(FRAME_CMD_CHECK_TRAIN, 0xFF, 0, 0);
-		start_millis = millis();
+		resource_VR_send_cmd2_pkt(vr, FRAME_CMD_CHECK_TRAIN, 0xFF, 0, 0);
+		start_millis = mtime_now_ms();
 		while(1){
-			len = resource_VR_receive_pkt(vr_buf, timeout);
+			len = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 			if(len>0){
-				if(vr_buf[2] == FRAME_CMD_CHECK_TRAIN){
-                    for(int i=0; i<vr_buf[1]-3; i+=2){
-                        buf[vr_buf[4+i]]=vr_buf[4+i+1];
+				if(vr->buf[2] == FRAME_CMD_CHECK_TRAIN){
+                    for(int i=0; i<vr->buf[1]-3; i+=2){
+                        buf[vr->buf[4+i]]=vr->buf[4+i+1];
+                        handle_VR_cache_set_train(vr, vr->buf[4+i], vr->buf[4+i+1]);
                     }
 					cnt++;
-					if(cnt == 51){
-						return vr_buf[3];
+					if(cnt == VR_TRAIN_ALL_PKTS){
+						/* every packet carries its own count, add them up */
+						vr->cache.train_all = true;
+						return handle_VR_checkRecord_cached(vr, buf, 0, 0);
 					}
 				}else{
 					return -3;
 				}
-				start_millis = millis();
+				start_millis = mtime_now_ms();
 			}
 
-			if(millis()-start_millis > 500){
+			if(mtime_now_ms()-start_millis > 500){
 				if(cnt>0){
 					buf[0] = cnt*5;
-					return vr_buf[3];
+					return vr->buf[3];
 				}
 				return -2;
 			}
@@ -522,14 +734,17 @@ int handle_VR_checkRecord(uint8_t *buf, uint8_t *records, uint8_t len)
 		}
 
 	}else if(len>0){
-		ret = resource_VR_cleanDup(vr_buf, records, len);
-		resource_VR_send_cmd_pkt(FRAME_CMD_CHECK_TRAIN, vr_buf, ret);
-		ret = resource_VR_receive_pkt(vr_buf, timeout);
+		ret = resource_VR_cleanDup(vr->buf, records, len);
+		resource_VR_send_cmd_pkt(vr, FRAME_CMD_CHECK_TRAIN, vr->buf, ret);
+		ret = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
 		if(ret>0){
-			if(vr_buf[2] == FRAME_CMD_CHECK_TRAIN){
-				memcpy(buf+1, vr_buf+4, vr_buf[1]-3);
-				buf[0] = (vr_buf[1]-3)/2;
-				return vr_buf[3];
+			if(vr->buf[2] == FRAME_CMD_CHECK_TRAIN){
+				memcpy(buf+1, vr->buf+4, vr->buf[1]-3);
+				buf[0] = (vr->buf[1]-3)/2;
+				for(int i=0; i<buf[0]; i++){
+					handle_VR_cache_set_train(vr, buf[2*i+1], buf[2*i+2]);
+				}
+				return vr->buf[3];
 			}else{
 				return -3;
 			}
@@ -542,6 +757,530 @@ int handle_VR_checkRecord(uint8_t *buf, uint8_t *records, uint8_t len)
 
 }
 
+/**
+    @brief check system settings.
+    @param buf --> return value buffer.
+             buf[0]  -->  status
+             buf[1]  -->  baud rate (0: 9600, 1: 2400, 2: 4800, 3: 9600, 4: 19200, 5: 38400)
+             buf[2]  -->  output IO mode
+             buf[3]  -->  output IO pulse width
+             buf[4]  -->  auto load
+             buf[5]  -->  group control
+    @retval '>0' --> success, length of data in buf
+            -1 --> failed
+*/
+int handle_VR_checkSystemSettings(vr3_h vr, uint8_t* buf)
+{
+	int len;
+
+	resource_VR_send_cmd_pkt(vr, FRAME_CMD_CHECK_SYSTEM, 0, 0);
+	len = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
+	if(len<=0){
+		return -1;
+	}
+	if(vr->buf[2] != FRAME_CMD_CHECK_SYSTEM){
+		return -1;
+	}
+
+	memcpy(buf, vr->buf+3, vr->buf[1]-2);
+
+	return vr->buf[1]-2;
+}
+
+/* VR3 baud rate code & host setting, fastest first */
+static const struct{
+	unsigned long br;
+	uint8_t code;
+	peripheral_uart_baud_rate_e host;
+}vr_baud_table[] = {
+	{ 38400, 5, PERIPHERAL_UART_BAUD_RATE_38400 },
+	{ 19200, 4, PERIPHERAL_UART_BAUD_RATE_19200 },
+	{ 9600,  3, PERIPHERAL_UART_BAUD_RATE_9600 },
+	{ 4800,  2, PERIPHERAL_UART_BAUD_RATE_4800 },
+	{ 2400,  1, PERIPHERAL_UART_BAUD_RATE_2400 },
+};
+
+#define VR_BAUD_NUM		(int)(sizeof(vr_baud_table) / sizeof(vr_baud_table[0]))
+
+/* host port to entry i, then CHECK_SYSTEM must answer */
+static bool resource_VR_tryBaudRate(vr3_h vr, int i)
+{
+	uint8_t buf[VR_FRAME_MAX];
+	int saved = vr->timeout;
+	int ret;
+
+	if(uart_port_set_baud_rate(vr->port, vr_baud_table[i].host) == false){
+		return false;
+	}
+	uart_port_flush(vr->port);
+
+	vr->timeout = VR_BAUD_PROBE_TIMEOUT;
+	ret = handle_VR_checkSystemSettings(vr, buf);
+	vr->timeout = saved;
+
+	return ret > 0;
+}
+
+/**
+    @brief find the rate the module talks at, host port is left there.
+    @retval baud rate found, -1 if the module does not answer at any rate
+*/
+int resource_VR_probeBaudRate(vr3_h vr)
+{
+	peripheral_uart_baud_rate_e current = uart_port_get_baud_rate(vr->port);
+	int i;
+
+	/* current host rate first, it is right almost every time */
+	for(i=0; i<VR_BAUD_NUM; i++){
+		if(vr_baud_table[i].host == current && resource_VR_tryBaudRate(vr, i)){
+			return vr_baud_table[i].br;
+		}
+	}
+	for(i=0; i<VR_BAUD_NUM; i++){
+		if(vr_baud_table[i].host != current && resource_VR_tryBaudRate(vr, i)){
+			LOGI("VR3 found at [%lu] baud", vr_baud_table[i].br);
+			return vr_baud_table[i].br;
+		}
+	}
+
+	LOGE("VR3 does not answer at any baud rate");
+	return -1;
+}
+
+/**
+    @brief switch module & host UART to br, verified with FRAME_CMD_CHECK_SYSTEM.
+           VR3 stores the new rate and may only use it after a restart,
+           then the host goes back to the old rate and the switch is pending,
+           resource_VR_probeBaudRate finds the module after the restart.
+    @param br --> 2400, 4800, 9600, 19200, 38400 (VR_BAUD_MAX)
+    @retval 0 --> switched
+            1 --> module answers at the old rate, new rate after restart
+            -1 --> failed, host at the rate the module answers
+*/
+int resource_VR_setBaudRate(vr3_h vr, unsigned long br)
+{
+	peripheral_uart_baud_rate_e old = uart_port_get_baud_rate(vr->port);
+	uint8_t code;
+	int i, old_i = -1;
+	int len;
+
+	for(i=0; i<VR_BAUD_NUM && vr_baud_table[i].br != br; i++)
+		;
+	if(i == VR_BAUD_NUM){
+		LOGE("VR3 does not support [%lu] baud", br);
+		return -1;
+	}
+	code = vr_baud_table[i].code;
+	for(old_i=0; old_i<VR_BAUD_NUM && vr_baud_table[old_i].host != old; old_i++)
+		;
+
+	resource_VR_send_cmd_pkt(vr, FRAME_CMD_SET_BR, &code, 1);
+	len = resource_VR_receive_pkt(vr, vr->buf, vr->timeout);
+	if(len>0 && vr->buf[2] != FRAME_CMD_SET_BR){
+		LOGE("FRAME_CMD_SET_BR failed");
+		return -1;
+	}
+	/* no reply is fine, a module switching at once answers at the new rate */
+
+	if(resource_VR_tryBaudRate(vr, i)){
+		LOGI("VR3 at [%lu] baud", br);
+		return 0;
+	}
+
+	/* roll back, the module still answers at the old rate until restarted */
+	if(old_i < VR_BAUD_NUM && resource_VR_tryBaudRate(vr, old_i)){
+		LOGI("VR3 takes [%lu] baud after restart", br);
+		return 1;
+	}
+
+	return resource_VR_probeBaudRate(vr) > 0 ? 1 : -1;
+}
+
+/**
+    @brief move to the fastest rate the module takes, VR_BAUD_MAX.
+    @retval same as resource_VR_setBaudRate
+*/
+int resource_VR_negotiateBaudRate(vr3_h vr)
+{
+	int br = resource_VR_probeBaudRate(vr);
+
+	if(br < 0){
+		return -1;
+	}
+	if(br == VR_BAUD_MAX){
+		return 0;
+	}
+
+	return resource_VR_setBaudRate(vr, VR_BAUD_MAX);
+}
+
+/****************************************************************************/
+/******************************* TRAIN CONTROL ******************************/
+
+/* prompts come while the user speaks, the answer to cmd comes last */
+static int handle_VR_train_wait(vr3_h vr, uint8_t cmd)
+{
+	int len;
+
+	while(1){
+		len = resource_VR_receive_pkt(vr, vr->buf, VR_TRAIN_TIMEOUT);
+		if(len<=0){
+			return -1;
+		}
+		if(vr->buf[2] == FRAME_CMD_PROMPT){
+			LOGI("Record:\t%d\t%.*s", vr->buf[3], vr->buf[1]-3, (char *)&vr->buf[4]);
+			continue;
+		}
+		return vr->buf[2] == cmd ? len : -1;
+	}
+}
+
+/**
+    @brief train records, the user says each one twice.
+    @param records --> record data buffer pointer, up to VR_TRAIN_BATCH_MAX.
+           len --> number of records.
+           buf --> pointer of return value buffer, optional.
+             buf[0]     -->  number of records trained successfully.
+             buf[2i+1]  -->  record number
+             buf[2i+2]  -->  train result. (00: trained, FE: train timeout, FF: value out of range)
+             (i = 0 ~ buf[0]-1 )
+    @retval '>0' --> length of valid data in buf.
+            0 --> success, buf=0, and no data returned.
+            '<0' --> failed.
+*/
+int handle_VR_train(vr3_h vr, uint8_t *records, uint8_t len, uint8_t *buf)
+{
+	int i;
+
+	if(len == 0 || len > VR_TRAIN_BATCH_MAX){
+		return -1;
+	}
+
+	resource_VR_send_cmd_pkt(vr, FRAME_CMD_TRAIN, records, len);
+	if(handle_VR_train_wait(vr, FRAME_CMD_TRAIN) < 0){
+		for(i=0; i<len; i++){
+			handle_VR_cache_set_train(vr, records[i], VR_TRAIN_UNKNOWN);
+		}
+		return -1;
+	}
+
+	for(i=0; i+1<vr->buf[1]-3; i+=2){
+		handle_VR_cache_set_train(vr, vr->buf[4+i], vr->buf[5+i] == 0x00 ? 0x01 : VR_TRAIN_UNKNOWN);
+	}
+	if(buf != 0){
+		memcpy(buf, vr->buf+3, vr->buf[1]-2);
+		return vr->buf[1]-2;
+	}
+	return 0;
+}
+
+/**
+    @brief train one record, see handle_VR_train.
+*/
+int handle_VR_train_one(vr3_h vr, uint8_t record, uint8_t *buf)
+{
+	return handle_VR_train(vr, &record, 1, buf);
+}
+
+/**
+    @brief train one record and set its signature.
+    @param record --> record value.
+           buf --> signature buffer.
+           len --> length of buf, 0 takes buf as a string.
+           retbuf --> return value buffer, optional.
+             retbuf[0]  -->  number of records trained successfully.
+             retbuf[1]  -->  record number
+             retbuf[2]  -->  train result. (00: trained, FE: train timeout, FF: value out of range)
+             retbuf[3]~ -->  signature
+    @retval '>0' --> length of valid data in retbuf.
+            0 --> success, retbuf=0, and no data returned.
+            '<0' --> failed.
+*/
+int handle_VR_trainWithSignature(vr3_h vr, uint8_t record, const void *buf, uint8_t len, uint8_t * retbuf)
+{
+	if(buf == 0){
+		return -1;
+	}
+	if(len == 0){
+		len = strlen((char *)buf);
+		if(len>VR_SIG_NAME_MAX){
+			return -1;
+		}
+	}
+
+	resource_VR_send_cmd2_pkt(vr, FRAME_CMD_SIG_TRAIN, record, (uint8_t *)buf, len);
+	if(handle_VR_train_wait(vr, FRAME_CMD_SIG_TRAIN) < 0){
+		handle_VR_cache_set_train(vr, record, VR_TRAIN_UNKNOWN);
+		vr->cache.sig_valid[record] = false;
+		return -1;
+	}
+
+	if(vr->buf[5] == 0x00){
+		handle_VR_cache_set_train(vr, record, 0x01);
+		handle_VR_cache_set_sig(vr, record, buf, len);
+	}else{
+		handle_VR_cache_set_train(vr, record, VR_TRAIN_UNKNOWN);
+	}
+	if(retbuf != 0){
+		memcpy(retbuf, vr->buf+3, vr->buf[1]-2);
+		return vr->buf[1]-2;
+	}
+	return 0;
+}
+
+/****************************************************************************/
+/******************************* BATCH CONTROL ******************************/
+
+/** request idx[i] goes out, answer gets the frame or NULL when it was lost */
+typedef void (*vr_pipe_send_fn)(vr3_h vr, int i, void *data);
+typedef bool (*vr_pipe_answer_fn)(vr3_h vr, int i, const uint8_t *frame, void *data);
+
+/*
+ * keep up to VR_PIPELINE_DEPTH frames on the way to the module, it answers
+ * them in order. answer returns false for a frame that is not the answer
+ * to i, then i was lost and the frame is tried on the next request.
+ */
+static void resource_VR_pipeline(vr3_h vr, const int *idx, int num, vr_pipe_send_fn send, vr_pipe_answer_fn answer, void *data)
+{
+	int sent = 0, done = 0;
+
+	while(done < num){
+		while(sent < num && sent - done < VR_PIPELINE_DEPTH){
+			send(vr, idx[sent++], data);
+		}
+
+		if(resource_VR_receive_pkt(vr, vr->buf, vr->timeout) <= 0){
+			/* nothing more comes, everything in flight is lost */
+			while(done < sent){
+				answer(vr, idx[done++], NULL, data);
+			}
+			continue;
+		}
+		if(vr->buf[2] == FRAME_CMD_VR){
+			continue;
+		}
+
+		while(done < sent && !answer(vr, idx[done], vr->buf, data)){
+			answer(vr, idx[done++], NULL, data);
+		}
+		if(done < sent){
+			done++;
+		}
+	}
+}
+
+typedef struct{
+	const vr_record_req_s *reqs;
+	uint8_t *status;
+}vr_batch_s;
+
+static void handle_VR_setSignatures_send(vr3_h vr, int i, void *data)
+{
+	vr_batch_s *batch = data;
+	const vr_record_req_s *req = &batch->reqs[i];
+
+	resource_VR_send_cmd2_pkt(vr, FRAME_CMD_SET_SIG, req->record, (uint8_t *)req->sig, req->sig ? strlen(req->sig) : 0);
+}
+
+static bool handle_VR_setSignatures_answer(vr3_h vr, int i, const uint8_t *frame, void *data)
+{
+	vr_batch_s *batch = data;
+	const vr_record_req_s *req = &batch->reqs[i];
+
+	if(frame == NULL || frame[2] != FRAME_CMD_SET_SIG){
+		vr->cache.sig_valid[req->record] = false;
+		batch->status[i] = VR_STA_FAILED;
+		return frame == NULL || frame[2] == FRAME_CMD_ERROR;
+	}
+
+	handle_VR_cache_set_sig(vr, req->record, (const uint8_t *)req->sig, req->sig ? strlen(req->sig) : 0);
+	batch->status[i] = VR_STA_OK;
+	return true;
+}
+
+/**
+    @brief set the signatures of many records, frames pipelined.
+    @param reqs --> record & signature string, NULL deletes the signature.
+           num --> number of reqs.
+           status --> per record, VR_STA_OK or VR_STA_FAILED.
+    @retval number of records set, -1 --> failed
+*/
+int handle_VR_setSignatures(vr3_h vr, const vr_record_req_s *reqs, int num, uint8_t *status)
+{
+	vr_batch_s batch = { reqs, status };
+	int *idx;
+	int i, n = 0, ok = 0;
+
+	if(reqs == 0 || status == 0 || num <= 0){
+		return -1;
+	}
+	idx = malloc(num * sizeof(int));
+	if(idx == 0){
+		return -1;
+	}
+
+	for(i=0; i<num; i++){
+		if(reqs[i].sig != 0 && strlen(reqs[i].sig) > VR_SIG_NAME_MAX){
+			status[i] = VR_STA_FAILED;
+		}else{
+			idx[n++] = i;
+		}
+	}
+	resource_VR_pipeline(vr, idx, n, handle_VR_setSignatures_send, handle_VR_setSignatures_answer, &batch);
+
+	for(i=0; i<num; i++){
+		ok += status[i] == VR_STA_OK;
+	}
+	free(idx);
+	return ok;
+}
+
+static void handle_VR_checkSignatures_send(vr3_h vr, int i, void *data)
+{
+	vr_batch_s *batch = data;
+
+	resource_VR_send_cmd2_pkt(vr, FRAME_CMD_CHECK_SIG, batch->reqs[i].record, 0, 0);
+}
+
+static bool handle_VR_checkSignatures_answer(vr3_h vr, int i, const uint8_t *frame, void *data)
+{
+	vr_batch_s *batch = data;
+
+	if(frame == NULL){
+		batch->status[i] = VR_STA_FAILED;
+		return true;
+	}
+	if(frame[2] != FRAME_CMD_CHECK_SIG || frame[3] != batch->reqs[i].record){
+		batch->status[i] = VR_STA_FAILED;
+		return frame[2] == FRAME_CMD_ERROR;
+	}
+
+	handle_VR_cache_set_sig(vr, frame[3], frame+5, frame[4]);
+	batch->status[i] = VR_STA_OK;
+	return true;
+}
+
+/**
+    @brief read the signatures of many records into the cache, frames pipelined.
+           handle_VR_checkSignature answers from the cache afterwards.
+    @param records --> record numbers.
+           num --> number of records.
+           status --> per record, VR_STA_OK or VR_STA_FAILED.
+    @retval number of signatures known, -1 --> failed
+*/
+int handle_VR_checkSignatures(vr3_h vr, const uint8_t *records, int num, uint8_t *status)
+{
+	vr_record_req_s *reqs;
+	vr_batch_s batch;
+	int *idx;
+	int i, n = 0, ok = 0;
+
+	if(records == 0 || status == 0 || num <= 0){
+		return -1;
+	}
+	reqs = malloc(num * sizeof(*reqs));
+	idx = malloc(num * sizeof(int));
+	if(reqs == 0 || idx == 0){
+		free(reqs);
+		free(idx);
+		return -1;
+	}
+
+	for(i=0; i<num; i++){
+		reqs[i].record = records[i];
+		reqs[i].sig = 0;
+		if(vr->cache.sig_valid[records[i]]){
+			status[i] = VR_STA_OK;
+			vr->cache.stats.round_trips_avoided++;
+			vr->cache.stats.packets_avoided += 2;
+		}else{
+			idx[n++] = i;
+		}
+	}
+	batch.reqs = reqs;
+	batch.status = status;
+	resource_VR_pipeline(vr, idx, n, handle_VR_checkSignatures_send, handle_VR_checkSignatures_answer, &batch);
+
+	for(i=0; i<num; i++){
+		ok += status[i] == VR_STA_OK;
+	}
+	free(reqs);
+	free(idx);
+	return ok;
+}
+
+/**
+    @brief train many records and set their signatures.
+           one FRAME_CMD_TRAIN per VR_TRAIN_BATCH_MAX records,
+           then the signatures through handle_VR_setSignatures.
+    @param reqs --> record & signature string, NULL leaves the signature.
+           num --> number of reqs.
+           status --> per record, train result (00: trained, FE: train timeout,
+                      FF: value out of range), VR_STA_FAILED if there was no answer
+                      or the signature failed.
+    @retval number of records trained & signed, -1 --> failed
+*/
+int handle_VR_trainBatch(vr3_h vr, const vr_record_req_s *reqs, int num, uint8_t *status)
+{
+	uint8_t records[VR_TRAIN_BATCH_MAX];
+	uint8_t ret[VR_FRAME_MAX];
+	vr_record_req_s *sigs;
+	uint8_t *sig_status;
+	int *sig_idx;
+	int i, j, n, len, nsig = 0, ok = 0;
+
+	if(reqs == 0 || status == 0 || num <= 0){
+		return -1;
+	}
+
+	for(i=0; i<num; i+=n){
+		n = num - i < VR_TRAIN_BATCH_MAX ? num - i : VR_TRAIN_BATCH_MAX;
+		for(j=0; j<n; j++){
+			records[j] = reqs[i+j].record;
+			status[i+j] = VR_STA_FAILED;
+		}
+		len = handle_VR_train(vr, records, n, ret);
+		/* ret[0] count, then record & result pairs in request order */
+		for(j=0; j<n && 2*j+2 < len; j++){
+			if(ret[2*j+1] == records[j]){
+				status[i+j] = ret[2*j+2];
+			}
+		}
+	}
+
+	sigs = malloc(num * sizeof(*sigs));
+	sig_status = malloc(num);
+	sig_idx = malloc(num * sizeof(int));
+	if(sigs == 0 || sig_status == 0 || sig_idx == 0){
+		free(sigs);
+		free(sig_status);
+		free(sig_idx);
+		return -1;
+	}
+	for(i=0; i<num; i++){
+		if(status[i] == 0x00 && reqs[i].sig != 0){
+			sig_idx[nsig] = i;
+			sigs[nsig++] = reqs[i];
+		}
+	}
+	if(nsig > 0){
+		handle_VR_setSignatures(vr, sigs, nsig, sig_status);
+		for(i=0; i<nsig; i++){
+			if(sig_status[i] != VR_STA_OK){
+				status[sig_idx[i]] = VR_STA_FAILED;
+			}
+		}
+	}
+
+	for(i=0; i<num; i++){
+		ok += status[i] == 0x00;
+	}
+	free(sigs);
+	free(sig_status);
+	free(sig_idx);
+	return ok;
+}
+
 /****************************************************************************/
 /******************************* VR3 CONTROL ********************************/
 
@@ -552,11 +1291,13 @@ int handle_VR_checkRecord(uint8_t *buf, uint8_t *records, uint8_t len)
            len     --> number of parameters
 */
 
-void resource_VR_setup(void)
+void resource_VR_setup(vr3_h vr)
 {
+	static const uint8_t motor_records[] = { onRecord, offRecord, fwRecord, bwRecord };
+
 	LOGI("Elechouse Voice Recognition V3 Module\r\nControl PWM Motor sample");
 
-	if(handle_VR_clear() == 0){
+	if(handle_VR_clear(vr) == 0){
 		LOGI("Recognizer cleared.");
 	}else{
 		LOGI("Not find VoiceRecognitionModule.");
@@ -564,20 +1305,10 @@ void resource_VR_setup(void)
 		while(1);
 	}
 
-	if(handle_VR_load_one((uint8_t)onRecord, 0) >= 0){
-		LOGI("onRecord loaded");
-	}
-
-	if(handle_VR_load_one((uint8_t)offRecord, 0) >= 0){
-		LOGI("offRecord loaded");
-	}
-
-	if(handle_VR_load_one((uint8_t)fwRecord, 0) >= 0){
-		LOGI("fwRecord loaded");
-	}
-
-	if(handle_VR_load_one((uint8_t)bwRecord, 0) >= 0){
-		LOGI("bwRecord loaded");
+	/* motor commands as the default context, one batched load */
+	handle_VR_context_define(vr, 0, motor_records, sizeof(motor_records));
+	if(handle_VR_context_activate(vr, 0) >= 0){
+		LOGI("onRecord, offRecord, fwRecord, bwRecord loaded");
 	}
 }
 
@@ -620,12 +1351,12 @@ void resource_VR_printVR(uint8_t *buf)
 
 }
 
-void handle_VR_loop_check(void)
+void handle_VR_loop_check(vr3_h vr)
 {
 	int ret;
 	uint8_t buf[64];
 
-	ret = handle_VR_recognize(buf, 50);
+	ret = handle_VR_recognize(vr, buf, 50);
 
 	if(ret>0){
 		switch(buf[1]){
@@ -661,3 +1392,311 @@ void handle_VR_loop_check(void)
 		resource_VR_printVR(buf);
 	}
 }
+
+
+#define VR_SEND_TEST_FRAMES		(20000)
+
+typedef struct{
+	int peer;
+	long expect;
+}vr_send_sink_s;
+
+/* pty peer, swallows everything the senders write */
+static void *vr_send_sink(void *data)
+{
+	vr_send_sink_s *sink = data;
+	uint8_t buf[1024];
+	ssize_t n;
+
+	while (sink->expect > 0) {
+		n = read(sink->peer, buf, sizeof(buf));
+		if (n <= 0)
+			break;
+		sink->expect -= n;
+	}
+
+	return NULL;
+}
+
+/*
+ * frames per second of small VR3 commands over a pty,
+ * resource_VR_send_cmd_pkt against assembling the frame by hand
+ */
+int  vr_send_test_main(void)
+{
+	uart_port_h port = NULL;
+	vr3_h vr = NULL;
+	vr_send_sink_s sink;
+	pthread_t thread;
+	uint8_t records[1] = { onRecord };
+	uint8_t frame[8];
+	double start, elapsed;
+	int pass, i;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (uart_port_open_pty(PERIPHERAL_UART_BAUD_RATE_115200, &port, &sink.peer) == false) {
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+	if (resource_VR_open(port, &vr) == false) {
+		uart_port_close(port);
+		close(sink.peer);
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		/* check train command, 5 bytes on the wire */
+		sink.expect = (long)VR_SEND_TEST_FRAMES * 5;
+		if (pthread_create(&thread, NULL, vr_send_sink, &sink) != 0) {
+			LOGE("pthread_create failed");
+			break;
+		}
+
+		start = mtime_now();
+		for (i = 0; i < VR_SEND_TEST_FRAMES; i++) {
+			if (pass == 0) {
+				resource_VR_send_cmd_pkt(vr, FRAME_CMD_CHECK_TRAIN, records, sizeof(records));
+			} else {
+				frame[0] = FRAME_HEAD;
+				frame[1] = sizeof(records)+2;
+				frame[2] = FRAME_CMD_CHECK_TRAIN;
+				memcpy(&frame[3], records, sizeof(records));
+				frame[sizeof(records)+3] = FRAME_END;
+				uart_port_write(vr->port, frame, sizeof(records)+4);
+			}
+		}
+		pthread_join(thread, NULL);
+		elapsed = mtime_now() - start;
+
+		LOGI("%s : [%d] frames in [%.3f] s, [%.0f] frames/s", pass == 0 ? "uart_port_writev" : "copy + write",
+				VR_SEND_TEST_FRAMES, elapsed, VR_SEND_TEST_FRAMES / elapsed);
+	}
+
+	resource_VR_close(vr);
+	uart_port_close(port);
+	close(sink.peer);
+	LOGI("%s exiting...\n", __func__);
+	return 0;
+}
+
+
+#define VR_CACHE_TEST_ROUNDS	(20)
+
+/*
+ * repeated train status & signature queries, first from the module then from the cache
+ */
+int  vr_cache_test_main(void)
+{
+	vr_cache_stats_s stats;
+	uint8_t buf[255], sig[VR_SIG_MAX];
+	uint8_t records[3] = { onRecord, offRecord, fwRecord };
+	long long start, first = 0, cached = 0;
+	int round, ret = 0;
+	vr_emu_stats_s emu_stats;
+	vr_emu_h emu = NULL;
+	vr3_h vr = NULL;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (vr_emu_start(NULL, &emu) == false) {
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+	if (resource_VR_open(vr_emu_get_port(emu), &vr) == false) {
+		vr_emu_stop(emu);
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+	memset(&vr->cache.stats, 0x0, sizeof(vr->cache.stats));
+
+	for (round = 0; round < VR_CACHE_TEST_ROUNDS; round++) {
+		start = mtime_now_us();
+		if (handle_VR_checkRecord(vr, buf, 0, 0) != 40 || buf[2] != 0x01 || buf[3] != 0x00 || buf[100] != 0xFF)
+			ret = -1;
+		if (handle_VR_checkRecord(vr, buf, records, sizeof(records)) != 1 || buf[0] != 3 || buf[4] != 0x01)
+			ret = -1;
+		if (handle_VR_checkSignature(vr, offRecord, sig) != 4 || memcmp(sig, "rec2", 4) != 0)
+			ret = -1;
+		if (round == 0)
+			first = mtime_now_us() - start;
+		else
+			cached += mtime_now_us() - start;
+	}
+
+	handle_VR_cache_get_stats(vr, &stats);
+	vr_emu_get_stats(emu, &emu_stats);
+	LOGI("first round [%lld] us, cached rounds avg [%lld] us", first, cached / (VR_CACHE_TEST_ROUNDS - 1));
+	LOGI("[%u] requests reached the module, [%u] round trips & [%u] packets avoided",
+			emu_stats.requests, stats.round_trips_avoided, stats.packets_avoided);
+
+	resource_VR_close(vr);
+	vr_emu_stop(emu);
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
+
+
+#define VR_BAUD_TEST_SWEEPS		(3)
+
+static long long vr_baud_test_sweep(vr3_h vr)
+{
+	uint8_t buf[255];
+	long long start = mtime_now_us();
+	int i;
+
+	for (i = 0; i < VR_BAUD_TEST_SWEEPS; i++) {
+		handle_VR_cache_invalidate(vr);
+		if (handle_VR_checkRecord(vr, buf, 0, 0) < 0)
+			return -1;
+	}
+
+	return (mtime_now_us() - start) / VR_BAUD_TEST_SWEEPS;
+}
+
+/*
+ * full train status sweep from the module at 9600 baud and after moving to VR_BAUD_MAX
+ */
+int  vr_baud_test_main(void)
+{
+	vr_emu_config_s config = { .link_delay = true };
+	long long slow, fast;
+	vr_emu_h emu = NULL;
+	vr3_h vr = NULL;
+	int ret;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (vr_emu_start(&config, &emu) == false) {
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+	if (resource_VR_open(vr_emu_get_port(emu), &vr) == false) {
+		vr_emu_stop(emu);
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+
+	slow = vr_baud_test_sweep(vr);
+	LOGI("9600 baud : check all records [%lld] us", slow);
+
+	ret = resource_VR_negotiateBaudRate(vr);
+	LOGI("negotiate : ret [%d], host at [%d]", ret, uart_port_get_baud_rate(vr->port));
+	if (ret == 1) {
+		vr_emu_restart(emu);
+		handle_VR_slot_invalidate(vr);
+		ret = resource_VR_probeBaudRate(vr) == VR_BAUD_MAX ? 0 : -1;
+	}
+
+	fast = vr_baud_test_sweep(vr);
+	LOGI("%d baud : check all records [%lld] us, [%.1f] x", VR_BAUD_MAX, fast, fast > 0 ? (double)slow / fast : 0.0);
+
+	resource_VR_close(vr);
+	vr_emu_stop(emu);
+	LOGI("%s exiting...\n", __func__);
+	return (ret == 0 && slow > 0 && fast > 0) ? 0 : -1;
+}
+
+
+#define VR_BATCH_TEST_RECORDS	(VR_EMU_RECORDS)
+
+typedef struct{
+	long long train;
+	long long sign;
+	long long verify;
+	unsigned int requests;
+	int verified;
+}vr_batch_test_s;
+
+/* train, name and read back every record, one command at a time or batched */
+static int vr_batch_test_run(bool batch, vr_batch_test_s *result)
+{
+	vr_emu_config_s config = { .link_delay = true, .cmd_delay_us = 2000, .train_prompt_ms = 1 };
+	static char names[VR_BATCH_TEST_RECORDS][VR_SIG_NAME_MAX + 1];
+	vr_record_req_s reqs[VR_BATCH_TEST_RECORDS];
+	uint8_t records[VR_BATCH_TEST_RECORDS];
+	uint8_t status[VR_BATCH_TEST_RECORDS];
+	uint8_t sig[VR_SIG_MAX];
+	vr_emu_stats_s stats;
+	vr_emu_h emu = NULL;
+	vr3_h vr = NULL;
+	long long start;
+	int i;
+
+	if (vr_emu_start(&config, &emu) == false)
+		return -1;
+	if (resource_VR_open(vr_emu_get_port(emu), &vr) == false) {
+		vr_emu_stop(emu);
+		return -1;
+	}
+
+	for (i = 0; i < VR_BATCH_TEST_RECORDS; i++) {
+		snprintf(names[i], sizeof(names[i]), "cmd%d", i);
+		records[i] = i;
+		reqs[i].record = i;
+		reqs[i].sig = names[i];
+	}
+
+	memset(result, 0x0, sizeof(*result));
+	start = mtime_now_us();
+	if (batch) {
+		handle_VR_trainBatch(vr, reqs, VR_BATCH_TEST_RECORDS, status);
+	} else {
+		for (i = 0; i < VR_BATCH_TEST_RECORDS; i++)
+			handle_VR_train_one(vr, i, 0);
+		result->train = mtime_now_us() - start;
+		start = mtime_now_us();
+		for (i = 0; i < VR_BATCH_TEST_RECORDS; i++)
+			handle_VR_setSignature(vr, i, names[i], 0);
+		result->sign = mtime_now_us() - start;
+	}
+	if (batch)
+		result->train = mtime_now_us() - start;
+
+	/* read back from the module, not from the cache */
+	handle_VR_cache_invalidate(vr);
+	start = mtime_now_us();
+	if (batch)
+		handle_VR_checkSignatures(vr, records, VR_BATCH_TEST_RECORDS, status);
+	for (i = 0; i < VR_BATCH_TEST_RECORDS; i++) {
+		memset(sig, 0x0, sizeof(sig));
+		if (handle_VR_checkSignature(vr, i, sig) == (int)strlen(names[i]) && memcmp(sig, names[i], strlen(names[i])) == 0)
+			result->verified++;
+	}
+	result->verify = mtime_now_us() - start;
+
+	vr_emu_get_stats(emu, &stats);
+	result->requests = stats.requests;
+	resource_VR_close(vr);
+	vr_emu_stop(emu);
+
+	return result->verified == VR_BATCH_TEST_RECORDS ? 0 : -1;
+}
+
+/*
+ * provisioning 80 named records at 9600 baud, 2 ms module time per command,
+ * training prompts answered at once so the serial traffic shows
+ */
+int  vr_batch_test_main(void)
+{
+	vr_batch_test_s one, batch;
+	int ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (vr_batch_test_run(false, &one) < 0)
+		ret = -1;
+	LOGI("one at a time : train [%lld] ms, sign [%lld] ms, verify [%lld] ms, [%u] commands, [%d] verified",
+			one.train / 1000, one.sign / 1000, one.verify / 1000, one.requests, one.verified);
+
+	if (vr_batch_test_run(true, &batch) < 0)
+		ret = -1;
+	LOGI("batch : train & sign [%lld] ms, verify [%lld] ms, [%u] commands, [%d] verified",
+			batch.train / 1000, batch.verify / 1000, batch.requests, batch.verified);
+
+	LOGI("provisioning [%lld] ms -> [%lld] ms", (one.train + one.sign + one.verify) / 1000, (batch.train + batch.verify) / 1000);
+
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
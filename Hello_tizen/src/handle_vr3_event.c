@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Voice recognition events from the Ecore main loop.
+ *        The VR3 port is watched by the reactor, FRAME_CMD_VR frames are
+ *        decoded as they arrive and dispatched through a per record table.
+ *        Blocking handle_VR_* commands must not be used on the same
+ *        context between handle_VR_event_start and handle_VR_event_stop.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <Ecore.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "vr3.h"
+#include "vr3_internal.h"
+#include "reactor.h"
+#include "mtime.h"
+
+/*
+ * FRAME_HEAD | len | FRAME_CMD_VR | 00 | group | record | index | sig len | sig | FRAME_END
+ */
+static void vr_event_frame_cb(const uint8_t *frame, int len, void *user_data)
+{
+	vr3_h vr = user_data;
+	vr_subscription_s *sub;
+	vr_event_s event;
+	unsigned int latency;
+
+	if (frame[2] != FRAME_CMD_VR || len < 9) {
+		vr->event.stats.other_frames++;
+		return;
+	}
+
+	event.group = frame[4];
+	event.record = frame[5];
+	event.index = frame[6];
+	event.sig_len = frame[7];
+	if (event.sig_len > len - 9)
+		event.sig_len = len - 9;
+	event.sig = event.sig_len ? &frame[8] : NULL;
+	event.rx_us = vr->event.rx_us;
+
+	handle_VR_slot_touch(vr, event.record);
+
+	sub = vr->event.subs[event.record].cb ? &vr->event.subs[event.record] : &vr->event.sub_any;
+	if (sub->cb == NULL) {
+		vr->event.stats.unhandled++;
+		return;
+	}
+
+	latency = mtime_now_us() - vr->event.rx_us;
+	if (vr->event.stats.events == 0 || latency < vr->event.stats.latency_min_us)
+		vr->event.stats.latency_min_us = latency;
+	if (latency > vr->event.stats.latency_max_us)
+		vr->event.stats.latency_max_us = latency;
+	vr->event.stats.latency_sum_us += latency;
+	vr->event.stats.events++;
+
+	sub->cb(&event, sub->user_data);
+
+	/* stopped or closed by the subscriber, the rest of the chunk is not delivered */
+	if (vr->event.source == NULL)
+		vr->event.parser.stop = true;
+}
+
+static void vr_event_read_cb(reactor_source_h source, const uint8_t *data, int len, void *user_data)
+{
+	vr3_h vr = user_data;
+
+	vr->event.rx_us = mtime_update();
+	vr->event.dispatching = true;
+	vr_parser_feed(&vr->event.parser, data, len);
+	vr->event.dispatching = false;
+
+	if (vr->event.close_pending)
+		free(vr);
+}
+
+/*
+ * deliver recognized records to their subscribers from the main loop
+ */
+bool handle_VR_event_start(vr3_h vr)
+{
+	if (vr->event.source != NULL)
+		return true;
+
+	vr_parser_init(&vr->event.parser, vr_event_frame_cb, vr);
+	if (reactor_add_port(vr->port, vr_event_read_cb, vr, &vr->event.source) == false) {
+		LOGE("reactor_add_port failed");
+		return false;
+	}
+
+	return true;
+}
+
+void handle_VR_event_stop(vr3_h vr)
+{
+	if (vr->event.source == NULL)
+		return;
+
+	reactor_remove(vr->event.source);
+	vr->event.source = NULL;
+}
+
+/*
+ * call cb when record is recognized, VR_RECORD_ANY for records nobody took
+ * a NULL cb removes the subscription
+ * cb may stop events or close vr, later frames of the same chunk are dropped
+ */
+void handle_VR_subscribe(vr3_h vr, int record, vr_event_cb cb, void *user_data)
+{
+	vr_subscription_s *sub;
+
+	if (record == VR_RECORD_ANY)
+		sub = &vr->event.sub_any;
+	else if (record >= 0 && record < VR_RECORD_NUM)
+		sub = &vr->event.subs[record];
+	else
+		return;
+
+	sub->cb = cb;
+	sub->user_data = user_data;
+}
+
+/*
+ * dispatch latency: chunk read from the port until its subscriber is called
+ */
+void handle_VR_event_get_stats(vr3_h vr, vr_event_stats_s *stats)
+{
+	if (stats != NULL)
+		*stats = vr->event.stats;
+}
+
+void handle_VR_event_reset_stats(vr3_h vr)
+{
+	memset(&vr->event.stats, 0x0, sizeof(vr->event.stats));
+}
+
+
+#define VR_EVENT_TEST_COUNT		(500)
+
+typedef struct{
+	int peer;
+	volatile long long sent_us;
+	int received;
+	int per_record[5];
+	long long e2e_sum_us;
+	long long e2e_max_us;
+	vr3_h vr;
+	int closed;							/* frames seen by vr_event_test_close_cb */
+}vr_event_test_s;
+
+/* module side, one recognized record every 2..10 ms */
+static void *vr_event_test_peer(void *data)
+{
+	vr_event_test_s *test = data;
+	uint8_t frame[11] = { FRAME_HEAD, 0x09, FRAME_CMD_VR, 0x00, 0xFF, 0, 0, 0x02, 'o', 'n', FRAME_END };
+	int i;
+
+	for (i = 0; i < VR_EVENT_TEST_COUNT; i++) {
+		usleep(2000 + rand() % 8000);
+		frame[5] = i % 5 ? i % 5 : 9;		/* 9 has no subscriber of its own */
+		frame[6] = frame[5];
+		while (test->sent_us != 0)
+			usleep(100);
+		test->sent_us = mtime_now_us();
+		if (write(test->peer, frame, sizeof(frame)) != sizeof(frame))
+			break;
+	}
+
+	return NULL;
+}
+
+static void vr_event_test_cb(const vr_event_s *event, void *user_data)
+{
+	vr_event_test_s *test = user_data;
+	long long e2e = mtime_now_us() - test->sent_us;
+
+	test->sent_us = 0;
+	test->per_record[event->record < 5 ? event->record : 0]++;
+	test->e2e_sum_us += e2e;
+	if (e2e > test->e2e_max_us)
+		test->e2e_max_us = e2e;
+
+	if (++test->received == VR_EVENT_TEST_COUNT)
+		ecore_main_loop_quit();
+}
+
+/* "exit" : the subscriber closes the driver from its callback */
+static void vr_event_test_close_cb(const vr_event_s *event, void *user_data)
+{
+	vr_event_test_s *test = user_data;
+
+	test->closed++;
+	resource_VR_close(test->vr);
+	test->vr = NULL;
+}
+
+static Eina_Bool vr_event_test_quit(void *data)
+{
+	ecore_main_loop_quit();
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static Eina_Bool vr_event_test_timeout(void *data)
+{
+	LOGE("timed out");
+	ecore_main_loop_quit();
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/*
+ * recognized records from a pty peer to subscribers through the main loop
+ */
+int  vr_event_test_main(void)
+{
+	vr_event_test_s test;
+	vr_event_stats_s stats;
+	uart_port_h port = NULL;
+	vr3_h vr = NULL;
+	Ecore_Timer *timer;
+	pthread_t thread;
+	int record;
+
+	LOGI("%s starting...\n", __func__);
+
+	memset(&test, 0x0, sizeof(test));
+	if (uart_port_open_pty(PERIPHERAL_UART_BAUD_RATE_9600, &port, &test.peer) == false) {
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+	if (resource_VR_open(port, &vr) == false) {
+		uart_port_close(port);
+		close(test.peer);
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+
+	for (record = 1; record < 5; record++)
+		handle_VR_subscribe(vr, record, vr_event_test_cb, &test);
+	handle_VR_subscribe(vr, VR_RECORD_ANY, vr_event_test_cb, &test);
+	handle_VR_event_reset_stats(vr);
+	handle_VR_event_start(vr);
+
+	pthread_create(&thread, NULL, vr_event_test_peer, &test);
+	timer = ecore_timer_add(VR_EVENT_TEST_COUNT * 0.02, vr_event_test_timeout, NULL);
+	ecore_main_loop_begin();
+	if (test.received == VR_EVENT_TEST_COUNT)
+		ecore_timer_del(timer);
+	else
+		pthread_cancel(thread);
+	pthread_join(thread, NULL);
+
+	handle_VR_event_stop(vr);
+	for (record = 1; record < 5; record++)
+		handle_VR_subscribe(vr, record, NULL, NULL);
+	handle_VR_subscribe(vr, VR_RECORD_ANY, NULL, NULL);
+
+	handle_VR_event_get_stats(vr, &stats);
+	LOGI("[%d] events, records 1..4 [%d %d %d %d], catch-all [%d]", test.received,
+			test.per_record[1], test.per_record[2], test.per_record[3], test.per_record[4], test.per_record[0]);
+	if (stats.events > 0)
+		LOGI("dispatch latency : min [%u] us, avg [%llu] us, max [%u] us",
+				stats.latency_min_us, stats.latency_sum_us / stats.events, stats.latency_max_us);
+	if (test.received > 0)
+		LOGI("pty write to callback : avg [%lld] us, max [%lld] us", test.e2e_sum_us / test.received, test.e2e_max_us);
+
+	/* two frames in one chunk, the first one closes the driver */
+	uint8_t frames[22] = { FRAME_HEAD, 0x09, FRAME_CMD_VR, 0x00, 0xFF, 1, 1, 0x02, 'o', 'n', FRAME_END,
+			FRAME_HEAD, 0x09, FRAME_CMD_VR, 0x00, 0xFF, 2, 2, 0x02, 'o', 'n', FRAME_END };
+	test.vr = vr;
+	handle_VR_subscribe(vr, VR_RECORD_ANY, vr_event_test_close_cb, &test);
+	handle_VR_event_start(vr);
+	if (write(test.peer, frames, sizeof(frames)) != sizeof(frames))
+		test.closed = -1;
+	ecore_timer_add(0.2, vr_event_test_quit, NULL);
+	ecore_main_loop_begin();
+	LOGI("closed from a subscriber : [%d] of 2 frames delivered", test.closed);
+	if (test.vr != NULL)
+		resource_VR_close(test.vr);
+
+	uart_port_close(port);
+	close(test.peer);
+	LOGI("%s exiting...\n", __func__);
+	return test.received == VR_EVENT_TEST_COUNT && test.closed == 1 ? 0 : -1;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Recognizer slot manager.
+ *        The VR3 recognizer holds VR_RECOGNIZER_SLOTS records and can only
+ *        be emptied as a whole (FRAME_CMD_CLEAR), records are appended with
+ *        FRAME_CMD_LOAD. Commands are grouped in contexts, activating one
+ *        loads what is missing in one batch, spare slots keep the most
+ *        recently recognized records of earlier contexts.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "vr3.h"
+#include "vr3_internal.h"
+#include "vr3_emu.h"
+#include "mtime.h"
+
+static bool vr_slot_is_resident(vr3_h vr, uint8_t record)
+{
+	int i;
+
+	for (i = 0; i < vr->slot.resident_num; i++)
+		if (vr->slot.resident[i] == record)
+			return true;
+
+	return false;
+}
+
+/**
+    @brief the recognizer was emptied, called by handle_VR_clear.
+*/
+void handle_VR_slot_cleared(vr3_h vr)
+{
+	vr->slot.resident_num = 0;
+	vr->slot.resident_known = true;
+}
+
+/**
+    @brief record is in the recognizer, called by handle_VR_load.
+*/
+void handle_VR_slot_loaded(vr3_h vr, uint8_t record)
+{
+	if (vr_slot_is_resident(vr, record) || vr->slot.resident_num == VR_RECOGNIZER_SLOTS)
+		return;
+
+	vr->slot.resident[vr->slot.resident_num++] = record;
+}
+
+/**
+    @brief recognizer state unknown, e.g. after a module reset.
+*/
+void handle_VR_slot_invalidate(vr3_h vr)
+{
+	vr->slot.resident_num = 0;
+	vr->slot.resident_known = false;
+}
+
+/**
+    @brief record was just recognized, keeps it in a spare slot longer.
+*/
+void handle_VR_slot_touch(vr3_h vr, uint8_t record)
+{
+	vr->slot.last_used[record] = mtime_now_us();
+}
+
+/**
+    @brief define the records of a context, up to VR_RECOGNIZER_SLOTS.
+    @retval 0 --> success
+            -1 --> failed
+*/
+int handle_VR_context_define(vr3_h vr, int context, const uint8_t *records, uint8_t len)
+{
+	if (context < 0 || context >= VR_CONTEXT_MAX || len > VR_RECOGNIZER_SLOTS)
+		return -1;
+	if (len > 0 && records == NULL)
+		return -1;
+
+	memcpy(vr->slot.contexts[context].records, records, len);
+	vr->slot.contexts[context].len = len;
+
+	return 0;
+}
+
+/*
+ * fill spare slots with the most recently recognized earlier residents
+ */
+static int vr_slot_pick_spares(vr3_h vr, const vr_context_s *ctx, uint8_t *load, int n)
+{
+	uint8_t cand[VR_RECOGNIZER_SLOTS];
+	int i, j, best, num = 0;
+
+	for (i = 0; i < vr->slot.resident_num; i++) {
+		for (j = 0; j < ctx->len && ctx->records[j] != vr->slot.resident[i]; j++)
+			;
+		if (j == ctx->len && vr->slot.last_used[vr->slot.resident[i]] > 0)
+			cand[num++] = vr->slot.resident[i];
+	}
+
+	while (n < VR_RECOGNIZER_SLOTS && num > 0) {
+		for (best = 0, i = 1; i < num; i++)
+			if (vr->slot.last_used[cand[i]] > vr->slot.last_used[cand[best]])
+				best = i;
+		load[n++] = cand[best];
+		cand[best] = cand[--num];
+	}
+
+	return n;
+}
+
+/**
+    @brief make the records of context resident in the recognizer.
+           nothing is sent when they all are, missing ones are loaded
+           in one batch if they fit, otherwise the recognizer is cleared
+           and reloaded with the context & recently used records.
+    @retval 0 --> success
+            -1 --> failed
+*/
+int handle_VR_context_activate(vr3_h vr, int context)
+{
+	const vr_context_s *ctx;
+	uint8_t load[VR_RECOGNIZER_SLOTS];
+	long long start = mtime_now_us();
+	unsigned int latency;
+	int i, n = 0;
+
+	if (context < 0 || context >= VR_CONTEXT_MAX)
+		return -1;
+
+	ctx = &vr->slot.contexts[context];
+
+	if (vr->slot.resident_known) {
+		for (i = 0; i < ctx->len; i++)
+			if (!vr_slot_is_resident(vr, ctx->records[i]))
+				load[n++] = ctx->records[i];
+	}
+
+	if (vr->slot.resident_known && n == 0) {
+		vr->slot.stats.hits++;
+	} else if (vr->slot.resident_known && vr->slot.resident_num + n <= VR_RECOGNIZER_SLOTS) {
+		if (handle_VR_load(vr, load, n, 0) < 0)
+			goto error;
+		vr->slot.stats.loads++;
+		vr->slot.stats.records_loaded += n;
+	} else {
+		/* spares come from what is resident now, CLEAR forgets it */
+		memcpy(load, ctx->records, ctx->len);
+		n = vr_slot_pick_spares(vr, ctx, load, ctx->len);
+		if (handle_VR_clear(vr) < 0)
+			goto error;
+		if (n > 0 && handle_VR_load(vr, load, n, 0) < 0)
+			goto error;
+		vr->slot.stats.clears++;
+		vr->slot.stats.loads++;
+		vr->slot.stats.records_loaded += n;
+	}
+
+	vr->slot.context_active = context;
+
+	latency = mtime_now_us() - start;
+	if (vr->slot.stats.switches == 0 || latency < vr->slot.stats.latency_min_us)
+		vr->slot.stats.latency_min_us = latency;
+	if (latency > vr->slot.stats.latency_max_us)
+		vr->slot.stats.latency_max_us = latency;
+	vr->slot.stats.latency_sum_us += latency;
+	vr->slot.stats.switches++;
+
+	return 0;
+
+error:
+	LOGE("context [%d] activation failed", context);
+	handle_VR_slot_invalidate(vr);
+	return -1;
+}
+
+int handle_VR_context_get_active(vr3_h vr)
+{
+	return vr->slot.context_active;
+}
+
+/**
+    @brief switch latency and recognizer traffic of context changes.
+*/
+void handle_VR_slot_get_stats(vr3_h vr, vr_slot_stats_s *stats)
+{
+	if (stats != NULL)
+		*stats = vr->slot.stats;
+}
+
+void handle_VR_slot_reset_stats(vr3_h vr)
+{
+	memset(&vr->slot.stats, 0x0, sizeof(vr->slot.stats));
+}
+
+
+#define VR_SLOT_TEST_SWITCHES	(60)
+
+/*
+ * context switches through the slot manager against clear & load every time,
+ * on a software module with 9600 baud link timing
+ */
+int  vr_slot_test_main(void)
+{
+	static const uint8_t home[] = { 2, 4, 6, 8 };
+	static const uint8_t drive[] = { 10, 12, 14, 16, 18 };
+	static const uint8_t media[] = { 2, 4, 20, 22 };
+	static const uint8_t phone[] = { 24, 26, 28 };
+	static const int pattern[] = { 0, 2, 0, 2, 1, 0, 3, 0, 2, 0 };	/* home, media, home, ... */
+	vr_emu_config_s config = { .link_delay = true };
+	vr_slot_stats_s stats;
+	vr_emu_stats_s emu_stats;
+	vr_emu_h emu = NULL;
+	vr3_h vr = NULL;
+	long long start, naive;
+	unsigned int requests;
+	int i, ctx, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (vr_emu_start(&config, &emu) == false) {
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+	if (resource_VR_open(vr_emu_get_port(emu), &vr) == false) {
+		vr_emu_stop(emu);
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+
+	handle_VR_context_define(vr, 0, home, sizeof(home));
+	handle_VR_context_define(vr, 1, drive, sizeof(drive));
+	handle_VR_context_define(vr, 2, media, sizeof(media));
+	handle_VR_context_define(vr, 3, phone, sizeof(phone));
+
+	/* every switch clears and loads the whole context */
+	vr_emu_get_stats(emu, &emu_stats);
+	requests = emu_stats.requests;
+	start = mtime_now_us();
+	for (i = 0; i < VR_SLOT_TEST_SWITCHES; i++) {
+		ctx = pattern[i % (sizeof(pattern) / sizeof(pattern[0]))];
+		if (handle_VR_clear(vr) < 0 || handle_VR_load(vr, vr->slot.contexts[ctx].records, vr->slot.contexts[ctx].len, 0) < 0)
+			ret = -1;
+	}
+	naive = mtime_now_us() - start;
+	vr_emu_get_stats(emu, &emu_stats);
+	LOGI("clear & load : [%d] switches, avg [%lld] us, [%u] commands", VR_SLOT_TEST_SWITCHES,
+			naive / VR_SLOT_TEST_SWITCHES, emu_stats.requests - requests);
+
+	handle_VR_slot_invalidate(vr);
+	handle_VR_slot_reset_stats(vr);
+	vr_emu_get_stats(emu, &emu_stats);
+	requests = emu_stats.requests;
+	for (i = 0; i < VR_SLOT_TEST_SWITCHES; i++) {
+		ctx = pattern[i % (sizeof(pattern) / sizeof(pattern[0]))];
+		if (handle_VR_context_activate(vr, ctx) < 0)
+			ret = -1;
+		/* the user says something of this context */
+		handle_VR_slot_touch(vr, vr->slot.contexts[ctx].records[i % vr->slot.contexts[ctx].len]);
+	}
+	handle_VR_slot_get_stats(vr, &stats);
+	vr_emu_get_stats(emu, &emu_stats);
+
+	/* drive does not fit next to media, the clear must keep the touched media record */
+	handle_VR_context_activate(vr, 2);
+	handle_VR_slot_touch(vr, media[2]);
+	if (handle_VR_context_activate(vr, 1) < 0 || !vr_slot_is_resident(vr, media[2])) {
+		LOGE("record [%d] not kept in a spare slot", media[2]);
+		ret = -1;
+	}
+
+	LOGI("slot manager : [%u] switches, avg [%llu] us, min [%u] us, max [%u] us, [%u] commands",
+			stats.switches, stats.latency_sum_us / stats.switches, stats.latency_min_us, stats.latency_max_us,
+			emu_stats.requests - requests);
+	LOGI("slot manager : [%u] already resident, [%u] loads, [%u] clears, [%u] records loaded",
+			stats.hits, stats.loads, stats.clears, stats.records_loaded);
+
+	resource_VR_close(vr);
+	vr_emu_stop(emu);
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
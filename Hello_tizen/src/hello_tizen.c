@@ -14,6 +14,7 @@ bool service_app_create(void *data)
 void service_app_terminate(void *data)
 {
     // Todo: add your code here.
+    mdm_fini();
     return;
 }
 
@@ -26,12 +27,22 @@ void service_app_control(app_control_h app_control, void *data)
 	char buffer[32];
 	char rbuffer[32];
 
+	/*
+	 * blocking sequence, the main loop waits for it : only single AT commands
+	 * have a non-blocking form (mdm_command_async), init, baud negotiation,
+	 * PDP & socket calls still wait for their answers
+	 */
+
 //	while(true)
 //	{
 		/* Check for BG96 initializtion */
         if(!mdm_init())
 			LOGE("BG96 Initialized");
 
+        /* Move the link to the fastest common baud rate */
+        if(!mdm_setBaudRate())
+			LOGE("BG96 Baud rate negotiated");
+
         /* Check for Cellular station registration */
 //		if(!mdm_IsRegistred())
 //			LOGE("BG96 Network Registred");
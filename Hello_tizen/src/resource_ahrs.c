@@ -0,0 +1,538 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Madgwick gradient descent orientation filter.
+ *        The gyro rate is integrated as a quaternion derivative and pulled
+ *        towards the orientation that explains the measured gravity (and
+ *        earth field) by one normalized gradient step of size beta.
+ *        S.O.H. Madgwick, "An efficient orientation filter for inertial
+ *        and inertial/magnetic sensor arrays", 2010.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "ahrs.h"
+#include "mtime.h"
+
+#define AHRS_DEG2RAD				(0.0174532925f)
+#define AHRS_DT_MAX					(0.5f)	/* sec, longer gaps restart the integration */
+
+struct _ahrs_s {
+	float q0, q1, q2, q3;
+	float beta;
+	long long last_us;						/* timestamp of the last sample, 0 : none */
+};
+
+bool ahrs_create(float beta, ahrs_h *ahrs)
+{
+	ahrs_h a;
+
+	if (ahrs == NULL)
+		return false;
+
+	a = calloc(1, sizeof(*a));
+	if (a == NULL)
+		return false;
+
+	a->beta = beta;
+	ahrs_reset(a);
+
+	*ahrs = a;
+	return true;
+}
+
+void ahrs_destroy(ahrs_h ahrs)
+{
+	free(ahrs);
+}
+
+void ahrs_reset(ahrs_h ahrs)
+{
+	ahrs->q0 = 1.0f;
+	ahrs->q1 = ahrs->q2 = ahrs->q3 = 0.0f;
+	ahrs->last_us = 0;
+}
+
+static float ahrs_inv_sqrt(float x)
+{
+	return 1.0f / sqrtf(x);
+}
+
+static void ahrs_integrate(ahrs_h a, float qdot0, float qdot1, float qdot2, float qdot3, float dt)
+{
+	float norm;
+
+	a->q0 += qdot0 * dt;
+	a->q1 += qdot1 * dt;
+	a->q2 += qdot2 * dt;
+	a->q3 += qdot3 * dt;
+
+	norm = ahrs_inv_sqrt(a->q0 * a->q0 + a->q1 * a->q1 + a->q2 * a->q2 + a->q3 * a->q3);
+	a->q0 *= norm;
+	a->q1 *= norm;
+	a->q2 *= norm;
+	a->q3 *= norm;
+}
+
+void ahrs_update_imu(ahrs_h a, const float gyro[3], const float accel[3], float dt)
+{
+	float q0 = a->q0, q1 = a->q1, q2 = a->q2, q3 = a->q3;
+	float gx = gyro[0], gy = gyro[1], gz = gyro[2];
+	float ax = accel[0], ay = accel[1], az = accel[2];
+	float qdot0, qdot1, qdot2, qdot3;
+	float s0, s1, s2, s3, norm;
+	float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2, _8q1, _8q2;
+	float q0q0, q1q1, q2q2, q3q3;
+
+	/* rate of change from the gyro */
+	qdot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+	qdot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+	qdot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+	qdot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+	if (ax != 0.0f || ay != 0.0f || az != 0.0f) {
+		norm = ahrs_inv_sqrt(ax * ax + ay * ay + az * az);
+		ax *= norm;
+		ay *= norm;
+		az *= norm;
+
+		_2q0 = 2.0f * q0;
+		_2q1 = 2.0f * q1;
+		_2q2 = 2.0f * q2;
+		_2q3 = 2.0f * q3;
+		_4q0 = 4.0f * q0;
+		_4q1 = 4.0f * q1;
+		_4q2 = 4.0f * q2;
+		_8q1 = 8.0f * q1;
+		_8q2 = 8.0f * q2;
+		q0q0 = q0 * q0;
+		q1q1 = q1 * q1;
+		q2q2 = q2 * q2;
+		q3q3 = q3 * q3;
+
+		/* gradient of the gravity error */
+		s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+		s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+		s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+		s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+		norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+		if (norm > 0.0f) {
+			norm = ahrs_inv_sqrt(norm);
+			qdot0 -= a->beta * s0 * norm;
+			qdot1 -= a->beta * s1 * norm;
+			qdot2 -= a->beta * s2 * norm;
+			qdot3 -= a->beta * s3 * norm;
+		}
+	}
+
+	ahrs_integrate(a, qdot0, qdot1, qdot2, qdot3, dt);
+}
+
+void ahrs_update_marg(ahrs_h a, const float gyro[3], const float accel[3], const float mag[3], float dt)
+{
+	float q0 = a->q0, q1 = a->q1, q2 = a->q2, q3 = a->q3;
+	float gx = gyro[0], gy = gyro[1], gz = gyro[2];
+	float ax = accel[0], ay = accel[1], az = accel[2];
+	float mx = mag[0], my = mag[1], mz = mag[2];
+	float qdot0, qdot1, qdot2, qdot3;
+	float s0, s1, s2, s3, norm;
+	float hx, hy, _2bx, _2bz, _4bx, _4bz;
+	float _2q0mx, _2q0my, _2q0mz, _2q1mx, _2q0, _2q1, _2q2, _2q3, _2q0q2, _2q2q3;
+	float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
+	float ex, ey, ez, hbx, hby, hbz;
+
+	if (mx == 0.0f && my == 0.0f && mz == 0.0f) {
+		ahrs_update_imu(a, gyro, accel, dt);
+		return;
+	}
+
+	qdot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+	qdot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+	qdot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+	qdot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+	if (ax != 0.0f || ay != 0.0f || az != 0.0f) {
+		norm = ahrs_inv_sqrt(ax * ax + ay * ay + az * az);
+		ax *= norm;
+		ay *= norm;
+		az *= norm;
+
+		norm = ahrs_inv_sqrt(mx * mx + my * my + mz * mz);
+		mx *= norm;
+		my *= norm;
+		mz *= norm;
+
+		_2q0mx = 2.0f * q0 * mx;
+		_2q0my = 2.0f * q0 * my;
+		_2q0mz = 2.0f * q0 * mz;
+		_2q1mx = 2.0f * q1 * mx;
+		_2q0 = 2.0f * q0;
+		_2q1 = 2.0f * q1;
+		_2q2 = 2.0f * q2;
+		_2q3 = 2.0f * q3;
+		_2q0q2 = 2.0f * q0 * q2;
+		_2q2q3 = 2.0f * q2 * q3;
+		q0q0 = q0 * q0;
+		q0q1 = q0 * q1;
+		q0q2 = q0 * q2;
+		q0q3 = q0 * q3;
+		q1q1 = q1 * q1;
+		q1q2 = q1 * q2;
+		q1q3 = q1 * q3;
+		q2q2 = q2 * q2;
+		q2q3 = q2 * q3;
+		q3q3 = q3 * q3;
+
+		/* earth field in the earth frame, levelled onto x & z */
+		hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 + _2q1 * my * q2 + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
+		hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 - my * q1q1 + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
+		_2bx = sqrtf(hx * hx + hy * hy);
+		_2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 - mz * q1q1 + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
+		_4bx = 2.0f * _2bx;
+		_4bz = 2.0f * _2bz;
+
+		/* gravity & field errors */
+		ex = 2.0f * q1q3 - _2q0q2 - ax;
+		ey = 2.0f * q0q1 + _2q2q3 - ay;
+		ez = 1.0f - 2.0f * q1q1 - 2.0f * q2q2 - az;
+		hbx = _2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx;
+		hby = _2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my;
+		hbz = _2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz;
+
+		s0 = -_2q2 * ex + _2q1 * ey - _2bz * q2 * hbx + (-_2bx * q3 + _2bz * q1) * hby + _2bx * q2 * hbz;
+		s1 = _2q3 * ex + _2q0 * ey - 4.0f * q1 * ez + _2bz * q3 * hbx + (_2bx * q2 + _2bz * q0) * hby + (_2bx * q3 - _4bz * q1) * hbz;
+		s2 = -_2q0 * ex + _2q3 * ey - 4.0f * q2 * ez + (-_4bx * q2 - _2bz * q0) * hbx + (_2bx * q1 + _2bz * q3) * hby + (_2bx * q0 - _4bz * q2) * hbz;
+		s3 = _2q1 * ex + _2q2 * ey + (-_4bx * q3 + _2bz * q1) * hbx + (-_2bx * q0 + _2bz * q2) * hby + _2bx * q1 * hbz;
+
+		norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+		if (norm > 0.0f) {
+			norm = ahrs_inv_sqrt(norm);
+			qdot0 -= a->beta * s0 * norm;
+			qdot1 -= a->beta * s1 * norm;
+			qdot2 -= a->beta * s2 * norm;
+			qdot3 -= a->beta * s3 * norm;
+		}
+	}
+
+	ahrs_integrate(a, qdot0, qdot1, qdot2, qdot3, dt);
+}
+
+/**
+    @brief update with a batch of driver samples.
+           gyro deg/s to rad/s, the AK8963 axes are turned onto the
+           accel/gyro ones (x <-> y, -z). mag is used for every sample.
+*/
+void ahrs_update_samples(ahrs_h ahrs, const MPU9250_sample *samples, int num, const MPU9250_magnetometer_val *mag)
+{
+	float gyro[3], accel[3], field[3];
+	float dt;
+	int i;
+
+	if (mag != NULL) {
+		field[0] = mag->y;
+		field[1] = mag->x;
+		field[2] = -mag->z;
+	}
+
+	for (i = 0; i < num; i++) {
+		dt = (samples[i].timestamp_us - ahrs->last_us) * 1e-6f;
+		ahrs->last_us = samples[i].timestamp_us;
+		if (dt <= 0.0f || dt > AHRS_DT_MAX)
+			continue;
+
+		gyro[0] = samples[i].gyro.x * AHRS_DEG2RAD;
+		gyro[1] = samples[i].gyro.y * AHRS_DEG2RAD;
+		gyro[2] = samples[i].gyro.z * AHRS_DEG2RAD;
+		accel[0] = samples[i].accel.x;
+		accel[1] = samples[i].accel.y;
+		accel[2] = samples[i].accel.z;
+
+		if (mag != NULL)
+			ahrs_update_marg(ahrs, gyro, accel, field, dt);
+		else
+			ahrs_update_imu(ahrs, gyro, accel, dt);
+	}
+}
+
+void ahrs_get_quaternion(ahrs_h ahrs, float q[4])
+{
+	q[0] = ahrs->q0;
+	q[1] = ahrs->q1;
+	q[2] = ahrs->q2;
+	q[3] = ahrs->q3;
+}
+
+/* Z-Y-X : yaw about earth z, then pitch, then roll */
+void ahrs_get_euler(ahrs_h ahrs, float *roll, float *pitch, float *yaw)
+{
+	float q0 = ahrs->q0, q1 = ahrs->q1, q2 = ahrs->q2, q3 = ahrs->q3;
+	float sinp = 2.0f * (q0 * q2 - q1 * q3);
+
+	if (sinp > 1.0f)
+		sinp = 1.0f;
+	else if (sinp < -1.0f)
+		sinp = -1.0f;
+
+	if (roll != NULL)
+		*roll = atan2f(q0 * q1 + q2 * q3, 0.5f - q1 * q1 - q2 * q2);
+	if (pitch != NULL)
+		*pitch = asinf(sinp);
+	if (yaw != NULL)
+		*yaw = atan2f(q0 * q3 + q1 * q2, 0.5f - q2 * q2 - q3 * q3);
+}
+
+void ahrs_get_matrix(ahrs_h ahrs, float m[3][3])
+{
+	float q0 = ahrs->q0, q1 = ahrs->q1, q2 = ahrs->q2, q3 = ahrs->q3;
+
+	m[0][0] = 1.0f - 2.0f * (q2 * q2 + q3 * q3);
+	m[0][1] = 2.0f * (q1 * q2 - q0 * q3);
+	m[0][2] = 2.0f * (q1 * q3 + q0 * q2);
+	m[1][0] = 2.0f * (q1 * q2 + q0 * q3);
+	m[1][1] = 1.0f - 2.0f * (q1 * q1 + q3 * q3);
+	m[1][2] = 2.0f * (q2 * q3 - q0 * q1);
+	m[2][0] = 2.0f * (q1 * q3 - q0 * q2);
+	m[2][1] = 2.0f * (q2 * q3 + q0 * q1);
+	m[2][2] = 1.0f - 2.0f * (q1 * q1 + q2 * q2);
+}
+
+
+#define AHRS_TEST_RATE				(500)	/* Hz */
+#define AHRS_TEST_SEC				(60)
+#define AHRS_TEST_SETTLE_SEC		(10)
+#define AHRS_TEST_BENCH_UPDATES		(200000)
+
+typedef struct{
+	float gyro[3];
+	float accel[3];
+	float mag[3];
+	double q[4];							/* truth */
+}ahrs_test_step_s;
+
+static double ahrs_test_gauss(unsigned int *seed, double sigma)
+{
+	double u1 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+
+	return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static void ahrs_test_euler_to_q(double roll, double pitch, double yaw, double q[4])
+{
+	double cr = cos(roll / 2), sr = sin(roll / 2);
+	double cp = cos(pitch / 2), sp = sin(pitch / 2);
+	double cy = cos(yaw / 2), sy = sin(yaw / 2);
+
+	q[0] = cr * cp * cy + sr * sp * sy;
+	q[1] = sr * cp * cy - cr * sp * sy;
+	q[2] = cr * sp * cy + sr * cp * sy;
+	q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+/* v_body = R(q)^T v_earth */
+static void ahrs_test_to_body(const double q[4], const double v[3], float out[3])
+{
+	double w = q[0], x = q[1], y = q[2], z = q[3];
+
+	out[0] = (1 - 2 * (y * y + z * z)) * v[0] + 2 * (x * y + w * z) * v[1] + 2 * (x * z - w * y) * v[2];
+	out[1] = 2 * (x * y - w * z) * v[0] + (1 - 2 * (x * x + z * z)) * v[1] + 2 * (y * z + w * x) * v[2];
+	out[2] = 2 * (x * z + w * y) * v[0] + 2 * (y * z - w * x) * v[1] + (1 - 2 * (x * x + y * y)) * v[2];
+}
+
+/*
+ * rolling, pitching & turning sensor with 0.1G of 3Hz vibration on x,
+ * noisy gyro with a bias, noisy accel & magnetometer
+ */
+static ahrs_test_step_s *ahrs_test_trace(int num)
+{
+	static const double field[3] = { 0.5, 0.0, -0.866 };	/* 60 deg inclination */
+	static const double bias[3] = { 0.004, -0.003, 0.002 };
+	ahrs_test_step_s *trace = calloc(num + 1, sizeof(*trace));
+	unsigned int seed = 1;
+	double dt = 1.0 / AHRS_TEST_RATE, t, gravity[3] = { 0, 0, 1 };
+	double dq[4], *q, *n, vn, angle;
+	int i, k;
+
+	if (trace == NULL)
+		return NULL;
+
+	for (i = 0; i <= num; i++) {
+		t = i * dt;
+		ahrs_test_euler_to_q(0.5 * sin(2 * M_PI * 0.2 * t), 0.35 * sin(2 * M_PI * 0.13 * t + 1), 0.6 * t, trace[i].q);
+	}
+
+	for (i = 0; i < num; i++) {
+		q = trace[i].q;
+		n = trace[i + 1].q;
+		/* body rate that takes q to the next one : dq = q* x n */
+		dq[0] = q[0] * n[0] + q[1] * n[1] + q[2] * n[2] + q[3] * n[3];
+		dq[1] = q[0] * n[1] - q[1] * n[0] - q[2] * n[3] + q[3] * n[2];
+		dq[2] = q[0] * n[2] + q[1] * n[3] - q[2] * n[0] - q[3] * n[1];
+		dq[3] = q[0] * n[3] - q[1] * n[2] + q[2] * n[1] - q[3] * n[0];
+		vn = sqrt(dq[1] * dq[1] + dq[2] * dq[2] + dq[3] * dq[3]);
+		angle = 2 * atan2(vn, dq[0]);
+		for (k = 0; k < 3; k++)
+			trace[i].gyro[k] = (vn > 0 ? dq[k + 1] / vn * angle / dt : 0) + bias[k] + ahrs_test_gauss(&seed, 0.005);
+
+		ahrs_test_to_body(q, gravity, trace[i].accel);
+		ahrs_test_to_body(q, field, trace[i].mag);
+		trace[i].accel[0] += 0.1 * sin(2 * M_PI * 3 * i * dt);
+		for (k = 0; k < 3; k++) {
+			trace[i].accel[k] += ahrs_test_gauss(&seed, 0.01);
+			trace[i].mag[k] += ahrs_test_gauss(&seed, 0.01);
+		}
+	}
+
+	return trace;
+}
+
+/* rotation angle between estimate and truth, deg */
+static double ahrs_test_error(const float est[4], const double truth[4])
+{
+	double dot = fabs(est[0] * truth[0] + est[1] * truth[1] + est[2] * truth[2] + est[3] * truth[3]);
+
+	return 2 * acos(dot > 1 ? 1 : dot) * 180 / M_PI;
+}
+
+static double ahrs_test_wrap_deg(double rad)
+{
+	double deg = rad * 180 / M_PI;
+
+	while (deg > 180)
+		deg -= 360;
+	while (deg < -180)
+		deg += 360;
+	return fabs(deg);
+}
+
+static int ahrs_test_accuracy(const char *name, const ahrs_test_step_s *trace, int num, bool marg)
+{
+	ahrs_h ahrs;
+	float q[4], roll, pitch;
+	double err, sum = 0, max = 0, tilt_sum = 0, acc_sum = 0, acc_roll, acc_pitch, truth_roll, truth_pitch;
+	int i, n = 0;
+
+	if (ahrs_create(AHRS_BETA_DEFAULT, &ahrs) == false)
+		return -1;
+
+	for (i = 0; i < num; i++) {
+		if (marg)
+			ahrs_update_marg(ahrs, trace[i].gyro, trace[i].accel, trace[i].mag, 1.0f / AHRS_TEST_RATE);
+		else
+			ahrs_update_imu(ahrs, trace[i].gyro, trace[i].accel, 1.0f / AHRS_TEST_RATE);
+		if (i + 1 < AHRS_TEST_SETTLE_SEC * AHRS_TEST_RATE)
+			continue;
+
+		/* the filter has seen sample i, it estimates q[i + 1] */
+		ahrs_get_quaternion(ahrs, q);
+		err = ahrs_test_error(q, trace[i + 1].q);
+		sum += err * err;
+		if (err > max)
+			max = err;
+
+		ahrs_get_euler(ahrs, &roll, &pitch, NULL);
+		truth_roll = atan2(2 * (trace[i + 1].q[0] * trace[i + 1].q[1] + trace[i + 1].q[2] * trace[i + 1].q[3]),
+				1 - 2 * (trace[i + 1].q[1] * trace[i + 1].q[1] + trace[i + 1].q[2] * trace[i + 1].q[2]));
+		truth_pitch = asin(2 * (trace[i + 1].q[0] * trace[i + 1].q[2] - trace[i + 1].q[1] * trace[i + 1].q[3]));
+		tilt_sum += pow(ahrs_test_wrap_deg(roll - truth_roll), 2) + pow(ahrs_test_wrap_deg(pitch - truth_pitch), 2);
+
+		/* accel only, as mpu9250_compute_axis_angle does */
+		acc_roll = atan2(trace[i].accel[1], trace[i].accel[2]);
+		acc_pitch = atan2(-trace[i].accel[0], sqrt(trace[i].accel[1] * trace[i].accel[1] + trace[i].accel[2] * trace[i].accel[2]));
+		acc_sum += pow(ahrs_test_wrap_deg(acc_roll - atan2(2 * (trace[i].q[0] * trace[i].q[1] + trace[i].q[2] * trace[i].q[3]),
+				1 - 2 * (trace[i].q[1] * trace[i].q[1] + trace[i].q[2] * trace[i].q[2]))), 2)
+				+ pow(ahrs_test_wrap_deg(acc_pitch - asin(2 * (trace[i].q[0] * trace[i].q[2] - trace[i].q[1] * trace[i].q[3]))), 2);
+		n++;
+	}
+	ahrs_destroy(ahrs);
+
+	LOGI("%s : orientation error rms [%0.2f] deg, max [%0.2f] deg; roll/pitch rms [%0.2f] deg, accel only [%0.2f] deg",
+			name, sqrt(sum / n), max, sqrt(tilt_sum / (2 * n)), sqrt(acc_sum / (2 * n)));
+
+	/* IMU has no heading reference, its yaw drifts with the gyro bias */
+	return (marg ? sqrt(sum / n) < 3.0 : true) && sqrt(tilt_sum / (2 * n)) < 3.0 ? 0 : -1;
+}
+
+static void ahrs_test_cost(const ahrs_test_step_s *trace, int num)
+{
+	ahrs_h ahrs;
+	float roll, pitch, yaw;
+	long long start, imu, marg, euler, axis;
+	int i;
+
+	if (ahrs_create(AHRS_BETA_DEFAULT, &ahrs) == false)
+		return;
+
+	start = mtime_now_us();
+	for (i = 0; i < AHRS_TEST_BENCH_UPDATES; i++)
+		ahrs_update_imu(ahrs, trace[i % num].gyro, trace[i % num].accel, 1.0f / AHRS_TEST_RATE);
+	imu = mtime_now_us() - start;
+
+	start = mtime_now_us();
+	for (i = 0; i < AHRS_TEST_BENCH_UPDATES; i++)
+		ahrs_update_marg(ahrs, trace[i % num].gyro, trace[i % num].accel, trace[i % num].mag, 1.0f / AHRS_TEST_RATE);
+	marg = mtime_now_us() - start;
+
+	start = mtime_now_us();
+	for (i = 0; i < AHRS_TEST_BENCH_UPDATES; i++)
+		ahrs_get_euler(ahrs, &roll, &pitch, &yaw);
+	euler = mtime_now_us() - start;
+
+	start = mtime_now_us();
+	for (i = 0; i < AHRS_TEST_BENCH_UPDATES; i++)
+		mpu9250_compute_axis_angle(trace[i % num].accel[0], trace[i % num].accel[1], trace[i % num].accel[2], &roll, &pitch);
+	axis = mtime_now_us() - start;
+
+	ahrs_destroy(ahrs);
+
+	LOGI("cost per call : imu [%lld] ns, marg [%lld] ns, euler [%lld] ns, mpu9250_compute_axis_angle [%lld] ns",
+			imu * 1000 / AHRS_TEST_BENCH_UPDATES, marg * 1000 / AHRS_TEST_BENCH_UPDATES,
+			euler * 1000 / AHRS_TEST_BENCH_UPDATES, axis * 1000 / AHRS_TEST_BENCH_UPDATES);
+}
+
+/*
+ * accuracy on a synthetic motion trace & cost of one update
+ */
+int  ahrs_test_main(void)
+{
+	int num = AHRS_TEST_SEC * AHRS_TEST_RATE;
+	ahrs_test_step_s *trace;
+	int ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	trace = ahrs_test_trace(num);
+	if (trace == NULL) {
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+
+	if (ahrs_test_accuracy("imu", trace, num, false) < 0)
+		ret = -1;
+	if (ahrs_test_accuracy("marg", trace, num, true) < 0)
+		ret = -1;
+	ahrs_test_cost(trace, num);
+
+	free(trace);
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
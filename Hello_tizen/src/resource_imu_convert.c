@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Batch conversion of raw IMU samples.
+ *        Scales are reciprocals worked out once at configuration time
+ *        (resource_mpu9250_get_scale), so a block costs one widen,
+ *        one convert and one multiply per value. The NEON path does
+ *        8 values per iteration; the Debug build (-mfpu=vfpv3-d16) has
+ *        no NEON and uses the C loop.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+#include "hello_tizen.h"
+#include "hello.h"
+#include "imu_convert.h"
+#include "mtime.h"
+
+static void imu_convert_axis_c(const int16_t *restrict raw, float *restrict out, float scale, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		out[i] = (float)raw[i] * scale;
+}
+
+void imu_convert_axis(const int16_t *raw, float *out, float scale, int num)
+{
+#ifdef __ARM_NEON
+	int16x8_t r;
+	int i;
+
+	for (i = 0; i + 8 <= num; i += 8) {
+		r = vld1q_s16(&raw[i]);
+		vst1q_f32(&out[i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(r))), scale));
+		vst1q_f32(&out[i + 4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(r))), scale));
+	}
+	imu_convert_axis_c(&raw[i], &out[i], scale, num - i);
+#else
+	imu_convert_axis_c(raw, out, scale, num);
+#endif
+}
+
+void imu_convert_block(const imu_raw_block_s *raw, const float scale[3], imu_block_s *out)
+{
+	imu_convert_axis(raw->x, out->x, scale[0], raw->num);
+	imu_convert_axis(raw->y, out->y, scale[1], raw->num);
+	imu_convert_axis(raw->z, out->z, scale[2], raw->num);
+	out->num = raw->num;
+}
+
+void imu_scale_accel(const MPU9250_scale *scale, float out[3])
+{
+	out[0] = out[1] = out[2] = scale->accel;
+}
+
+void imu_scale_gyro(const MPU9250_scale *scale, float out[3])
+{
+	out[0] = out[1] = out[2] = scale->gyro;
+}
+
+void imu_scale_mag(const MPU9250_scale *scale, float out[3])
+{
+	memcpy(out, scale->mag, sizeof(scale->mag));
+}
+
+void imu_block_from_frames(const uint8_t *frames, int frame_len, int offset, int num, imu_raw_block_s *raw)
+{
+	const uint8_t *p = &frames[offset];
+	int i;
+
+	if (num > IMU_BLOCK_MAX)
+		num = IMU_BLOCK_MAX;
+
+	for (i = 0; i < num; i++, p += frame_len) {
+		raw->x[i] = (int16_t)((p[0] << 8) | p[1]);
+		raw->y[i] = (int16_t)((p[2] << 8) | p[3]);
+		raw->z[i] = (int16_t)((p[4] << 8) | p[5]);
+	}
+	raw->num = num;
+}
+
+
+#define IMU_CONVERT_TEST_ROUNDS		(40000)
+
+/*
+ * magnetometer samples (3 axes) per us : one value at a time with the
+ * ASA factor worked out each time as the read function did, the C kernel,
+ * and imu_convert_block
+ */
+int  imu_convert_test_main(void)
+{
+	static imu_raw_block_s raw;
+	static imu_block_s out, ref;
+	static uint8_t asa_regs[3] = { 176, 177, 165 };
+	volatile uint8_t *asa = asa_regs;	/* read each time, as the driver's calib array was */
+	float scale[3];
+	long long start, per_value, kernel_c, kernel;
+	double total = (double)IMU_CONVERT_TEST_ROUNDS * IMU_BLOCK_MAX;
+	unsigned int seed = 1;
+	int i, r, mismatches = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	for (i = 0; i < IMU_BLOCK_MAX; i++) {
+		raw.x[i] = rand_r(&seed);
+		raw.y[i] = rand_r(&seed);
+		raw.z[i] = rand_r(&seed);
+	}
+	raw.num = IMU_BLOCK_MAX;
+
+	/* magnetometer as read before : ASA factor worked out for every value */
+	start = mtime_now_us();
+	for (r = 0; r < IMU_CONVERT_TEST_ROUNDS; r++) {
+		for (i = 0; i < IMU_BLOCK_MAX; i++) {
+			ref.x[i] = raw.x[i] * ((((float)asa[0] - 128) / 256) + 1);
+			ref.y[i] = raw.y[i] * ((((float)asa[1] - 128) / 256) + 1);
+			ref.z[i] = raw.z[i] * ((((float)asa[2] - 128) / 256) + 1);
+		}
+		__asm__ volatile("" : : "r"(ref.x) : "memory");
+	}
+	per_value = mtime_now_us() - start;
+
+	for (i = 0; i < 3; i++)
+		scale[i] = (((float)asa[i] - 128) / 256) + 1;
+
+	start = mtime_now_us();
+	for (r = 0; r < IMU_CONVERT_TEST_ROUNDS; r++) {
+		imu_convert_axis_c(raw.x, out.x, scale[0], raw.num);
+		imu_convert_axis_c(raw.y, out.y, scale[1], raw.num);
+		imu_convert_axis_c(raw.z, out.z, scale[2], raw.num);
+		__asm__ volatile("" : : "r"(out.x) : "memory");
+	}
+	kernel_c = mtime_now_us() - start;
+
+	start = mtime_now_us();
+	for (r = 0; r < IMU_CONVERT_TEST_ROUNDS; r++) {
+		imu_convert_block(&raw, scale, &out);
+		__asm__ volatile("" : : "r"(out.x) : "memory");
+	}
+	kernel = mtime_now_us() - start;
+
+	for (i = 0; i < IMU_BLOCK_MAX; i++)
+		if (fabsf(out.x[i] - ref.x[i]) > 1e-5f * fabsf(ref.x[i]) + 1e-6f)
+			mismatches++;
+
+	LOGI("per value [%0.1f], C kernel [%0.1f], %s kernel [%0.1f] samples/us, [%d] mismatches",
+			total / per_value, total / kernel_c,
+#ifdef __ARM_NEON
+			"NEON",
+#else
+			"imu_convert_block (C)",
+#endif
+			total / kernel, mismatches);
+
+	LOGI("%s exiting...\n", __func__);
+	return mismatches == 0 ? 0 : -1;
+}
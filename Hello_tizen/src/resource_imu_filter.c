@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Host side filter chains for IMU streams.
+ *        Biquads run as transposed direct form II, one state pair per
+ *        axis. A decimator splits its FIR in factor branches of
+ *        taps_per_phase taps; input samples are dealt out to the branches
+ *        and only the kept outputs are computed, so a sample costs
+ *        taps_per_phase MACs whatever the factor. Blocks are filtered in
+ *        place, outputs never get ahead of the inputs they overwrite.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "imu_filter.h"
+#include "mtime.h"
+
+typedef enum {
+	IMU_FILTER_BIQUAD,
+	IMU_FILTER_DECIMATOR,
+} imu_filter_type_e;
+
+typedef struct{
+	imu_filter_type_e type;
+
+	/* biquad */
+	float b0, b1, b2, a1, a2;
+	float z1[3], z2[3];
+
+	/* decimator */
+	int factor;
+	int taps;							/* per phase */
+	int stride;							/* floats per branch buffer */
+	int phase;							/* branch the next input goes to */
+	float *coef;						/* factor x taps, each branch oldest first */
+	float *hist;						/* 3 axes x factor branches x stride */
+}imu_filter_stage_s;
+
+struct _imu_filter_s {
+	float rate_in;
+	float rate_out;
+	int num;
+	imu_filter_stage_s stages[IMU_FILTER_STAGES];
+};
+
+bool imu_filter_create(float rate_hz, imu_filter_h *filter)
+{
+	imu_filter_h f;
+
+	if (filter == NULL || rate_hz <= 0)
+		return false;
+
+	f = calloc(1, sizeof(*f));
+	if (f == NULL)
+		return false;
+
+	f->rate_in = f->rate_out = rate_hz;
+
+	*filter = f;
+	return true;
+}
+
+void imu_filter_destroy(imu_filter_h filter)
+{
+	int i;
+
+	if (filter == NULL)
+		return;
+
+	for (i = 0; i < filter->num; i++) {
+		free(filter->stages[i].coef);
+		free(filter->stages[i].hist);
+	}
+	free(filter);
+}
+
+static imu_filter_stage_s *imu_filter_new_stage(imu_filter_h filter, imu_filter_type_e type)
+{
+	imu_filter_stage_s *st;
+
+	if (filter->num == IMU_FILTER_STAGES) {
+		LOGE("no more than %d stages", IMU_FILTER_STAGES);
+		return NULL;
+	}
+
+	st = &filter->stages[filter->num];
+	memset(st, 0x0, sizeof(*st));
+	st->type = type;
+
+	return st;
+}
+
+bool imu_filter_add_biquad(imu_filter_h filter, const float b[3], const float a[2])
+{
+	imu_filter_stage_s *st = imu_filter_new_stage(filter, IMU_FILTER_BIQUAD);
+
+	if (st == NULL)
+		return false;
+
+	st->b0 = b[0];
+	st->b1 = b[1];
+	st->b2 = b[2];
+	st->a1 = a[0];
+	st->a2 = a[1];
+	filter->num++;
+
+	return true;
+}
+
+static bool imu_filter_add_rbj(imu_filter_h filter, float cutoff_hz, float q, bool highpass)
+{
+	double w0, cs, alpha, a0;
+	float b[3], a[2];
+
+	if (cutoff_hz <= 0 || cutoff_hz >= filter->rate_out / 2 || q <= 0) {
+		LOGE("cutoff [%f] Hz out of (0, %f)", cutoff_hz, filter->rate_out / 2);
+		return false;
+	}
+
+	w0 = 2 * M_PI * cutoff_hz / filter->rate_out;
+	cs = cos(w0);
+	alpha = sin(w0) / (2 * q);
+	a0 = 1 + alpha;
+
+	b[0] = (highpass ? (1 + cs) / 2 : (1 - cs) / 2) / a0;
+	b[1] = (highpass ? -(1 + cs) : 1 - cs) / a0;
+	b[2] = b[0];
+	a[0] = -2 * cs / a0;
+	a[1] = (1 - alpha) / a0;
+
+	return imu_filter_add_biquad(filter, b, a);
+}
+
+bool imu_filter_add_lowpass(imu_filter_h filter, float cutoff_hz, float q)
+{
+	return imu_filter_add_rbj(filter, cutoff_hz, q, false);
+}
+
+bool imu_filter_add_highpass(imu_filter_h filter, float cutoff_hz, float q)
+{
+	return imu_filter_add_rbj(filter, cutoff_hz, q, true);
+}
+
+bool imu_filter_add_decimator(imu_filter_h filter, int factor, int taps_per_phase, float cutoff_hz)
+{
+	imu_filter_stage_s *st;
+	int n = factor * taps_per_phase, k, p, j;
+	double fc, x, w, sum = 0, *h;
+
+	if (factor < 2 || taps_per_phase < 1 || n > IMU_FILTER_TAPS_MAX) {
+		LOGE("decimator %d x %d taps not supported", factor, taps_per_phase);
+		return false;
+	}
+	if (cutoff_hz == 0)
+		cutoff_hz = 0.4f * filter->rate_out / factor;
+	if (cutoff_hz < 0 || cutoff_hz >= filter->rate_out / 2)
+		return false;
+
+	st = imu_filter_new_stage(filter, IMU_FILTER_DECIMATOR);
+	if (st == NULL)
+		return false;
+
+	st->factor = factor;
+	st->taps = taps_per_phase;
+	st->stride = taps_per_phase + IMU_BLOCK_MAX / factor + 1;
+	st->phase = factor - 1;
+	st->coef = malloc(sizeof(float) * n);
+	st->hist = calloc(3 * factor * st->stride, sizeof(float));
+	h = malloc(sizeof(double) * n);
+	if (st->coef == NULL || st->hist == NULL || h == NULL) {
+		free(st->coef);
+		free(st->hist);
+		free(h);
+		return false;
+	}
+
+	/* windowed sinc, unity gain at DC */
+	fc = cutoff_hz / filter->rate_out;
+	for (k = 0; k < n; k++) {
+		x = k - (n - 1) / 2.0;
+		w = n > 1 ? 0.42 - 0.5 * cos(2 * M_PI * k / (n - 1)) + 0.08 * cos(4 * M_PI * k / (n - 1)) : 1;
+		h[k] = (x == 0 ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x)) * w;
+		sum += h[k];
+	}
+
+	/* branch p holds x[mM - p] and takes h[jM + p], newest j = 0 last */
+	for (p = 0; p < factor; p++)
+		for (j = 0; j < taps_per_phase; j++)
+			st->coef[p * taps_per_phase + j] = h[(taps_per_phase - 1 - j) * factor + p] / sum;
+	free(h);
+
+	filter->rate_out /= factor;
+	filter->num++;
+
+	return true;
+}
+
+float imu_filter_get_rate(imu_filter_h filter)
+{
+	return filter->rate_out;
+}
+
+void imu_filter_reset(imu_filter_h filter)
+{
+	imu_filter_stage_s *st;
+	int i;
+
+	for (i = 0; i < filter->num; i++) {
+		st = &filter->stages[i];
+		memset(st->z1, 0x0, sizeof(st->z1));
+		memset(st->z2, 0x0, sizeof(st->z2));
+		if (st->type == IMU_FILTER_DECIMATOR) {
+			st->phase = st->factor - 1;
+			memset(st->hist, 0x0, sizeof(float) * 3 * st->factor * st->stride);
+		}
+	}
+}
+
+static void imu_filter_biquad_axis(imu_filter_stage_s *st, int axis, float *x, int num)
+{
+	float b0 = st->b0, b1 = st->b1, b2 = st->b2, a1 = st->a1, a2 = st->a2;
+	float z1 = st->z1[axis], z2 = st->z2[axis], in, out;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		in = x[i];
+		out = b0 * in + z1;
+		z1 = b1 * in - a1 * out + z2;
+		z2 = b2 * in - a2 * out;
+		x[i] = out;
+	}
+
+	st->z1[axis] = z1;
+	st->z2[axis] = z2;
+}
+
+static int imu_filter_decimate_axis(imu_filter_stage_s *st, int axis, float *x, int num)
+{
+	const int factor = st->factor, taps = st->taps, stride = st->stride;
+	float *base = st->hist + axis * factor * stride;
+	const float *restrict h, *restrict u;
+	int i, j, b, p = st->phase, g = 0, out = 0;
+	float acc;
+
+	for (i = 0; i < num; i++) {
+		base[p * stride + taps - 1 + g] = x[i];
+		if (p-- > 0)
+			continue;
+
+		/* branch 0 got x[mM], output m is complete */
+		acc = 0;
+		for (b = 0; b < factor; b++) {
+			h = st->coef + b * taps;
+			u = base + b * stride + g;
+			for (j = 0; j < taps; j++)
+				acc += h[j] * u[j];
+		}
+		x[out++] = acc;
+		p = factor - 1;
+		g++;
+	}
+
+	/* keep taps - 1 samples of history and the group being filled */
+	if (g > 0)
+		for (b = 0; b < factor; b++)
+			memmove(base + b * stride, base + b * stride + g, sizeof(float) * taps);
+
+	return out;
+}
+
+/**
+    @brief run the chain over block in place.
+    @return samples left in the block
+*/
+int imu_filter_process(imu_filter_h filter, imu_block_s *block)
+{
+	imu_filter_stage_s *st;
+	int i, n;
+
+	for (i = 0; i < filter->num && block->num > 0; i++) {
+		st = &filter->stages[i];
+		if (st->type == IMU_FILTER_BIQUAD) {
+			imu_filter_biquad_axis(st, 0, block->x, block->num);
+			imu_filter_biquad_axis(st, 1, block->y, block->num);
+			imu_filter_biquad_axis(st, 2, block->z, block->num);
+		} else {
+			n = imu_filter_decimate_axis(st, 0, block->x, block->num);
+			imu_filter_decimate_axis(st, 1, block->y, block->num);
+			imu_filter_decimate_axis(st, 2, block->z, block->num);
+			st->phase = (st->phase - block->num % st->factor + st->factor) % st->factor;
+			block->num = n;
+		}
+	}
+
+	return block->num;
+}
+
+
+#define IMU_FILTER_TEST_RATE		(1000)
+#define IMU_FILTER_TEST_BLOCKS		(2000)
+
+typedef struct{
+	const char *name;
+	float rate;
+	bool (*build)(imu_filter_h filter);
+}imu_filter_test_chain_s;
+
+static bool imu_filter_test_fir20(imu_filter_h f)
+{
+	return imu_filter_add_decimator(f, 20, 16, 20);
+}
+
+static bool imu_filter_test_fir4x5(imu_filter_h f)
+{
+	return imu_filter_add_decimator(f, 4, 8, 25) && imu_filter_add_decimator(f, 5, 12, 20);
+}
+
+static bool imu_filter_test_iir_fir(imu_filter_h f)
+{
+	/* 4th order Butterworth at 20Hz, then a short FIR for the rest */
+	return imu_filter_add_lowpass(f, 20, 0.5412f) && imu_filter_add_lowpass(f, 20, 1.3066f)
+			&& imu_filter_add_decimator(f, 20, 4, 40);
+}
+
+static bool imu_filter_test_fir4(imu_filter_h f)
+{
+	return imu_filter_add_decimator(f, 4, 12, 0);
+}
+
+static bool imu_filter_test_hp(imu_filter_h f)
+{
+	return imu_filter_add_highpass(f, 0.5f, IMU_FILTER_Q_BUTTERWORTH);
+}
+
+static const imu_filter_test_chain_s imu_filter_test_chains[] = {
+	{ "1kHz->50Hz FIR /20 x16", 1000, imu_filter_test_fir20 },
+	{ "1kHz->50Hz FIR /4 x8, /5 x12", 1000, imu_filter_test_fir4x5 },
+	{ "1kHz->50Hz 2 biquads, FIR /20 x4", 1000, imu_filter_test_iir_fir },
+	{ "200Hz->50Hz FIR /4 x12", 200, imu_filter_test_fir4 },
+	{ "1kHz high pass 0.5Hz", 1000, imu_filter_test_hp },
+};
+
+/* amplitude of a sine of freq_hz after the chain, once settled */
+static double imu_filter_test_gain(const imu_filter_test_chain_s *chain, double freq_hz)
+{
+	static imu_block_s block;
+	imu_filter_h f;
+	double sum = 0;
+	long n = 0, t = 0, total = (long)chain->rate * 4;
+	int i;
+
+	if (imu_filter_create(chain->rate, &f) == false)
+		return -1;
+	if (chain->build(f) == false) {
+		imu_filter_destroy(f);
+		return -1;
+	}
+
+	while (t < total) {
+		for (i = 0; i < IMU_BLOCK_MAX; i++, t++)
+			block.x[i] = block.y[i] = block.z[i] = sin(2 * M_PI * freq_hz * t / chain->rate);
+		block.num = IMU_BLOCK_MAX;
+		imu_filter_process(f, &block);
+		if (t < total / 2)
+			continue;
+		for (i = 0; i < block.num; i++, n++)
+			sum += (double)block.x[i] * block.x[i];
+	}
+
+	imu_filter_destroy(f);
+	return n ? sqrt(2 * sum / n) : 0;
+}
+
+static long imu_filter_test_cpu_khz(void)
+{
+	FILE *fp = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "r");
+	long khz = 0;
+
+	if (fp == NULL)
+		return 0;
+	if (fscanf(fp, "%ld", &khz) != 1)
+		khz = 0;
+	fclose(fp);
+
+	return khz;
+}
+
+/*
+ * per chain : pass band gain, rejection of a tone that would alias onto
+ * the pass band, and cost per 3 axis input sample
+ */
+int  imu_filter_test_main(void)
+{
+	static imu_block_s block, src;
+	const imu_filter_test_chain_s *chain;
+	imu_filter_h f;
+	long khz = imu_filter_test_cpu_khz();
+	long long start, elapsed;
+	double total = (double)IMU_FILTER_TEST_BLOCKS * IMU_BLOCK_MAX, pass, alias, ns;
+	char cycles[48] = "";
+	unsigned int seed = 1, c;
+	int i, b, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	for (i = 0; i < IMU_BLOCK_MAX; i++) {
+		src.x[i] = rand_r(&seed) / (float)RAND_MAX - 0.5f;
+		src.y[i] = rand_r(&seed) / (float)RAND_MAX - 0.5f;
+		src.z[i] = rand_r(&seed) / (float)RAND_MAX - 0.5f;
+	}
+
+	for (c = 0; c < sizeof(imu_filter_test_chains) / sizeof(imu_filter_test_chains[0]); c++) {
+		chain = &imu_filter_test_chains[c];
+		if (imu_filter_create(chain->rate, &f) == false) {
+			LOGE("%s : create failed", chain->name);
+			ret = -1;
+			continue;
+		}
+		if (chain->build(f) == false) {
+			LOGE("%s : build failed", chain->name);
+			imu_filter_destroy(f);
+			ret = -1;
+			continue;
+		}
+
+		start = mtime_now_us();
+		for (b = 0; b < IMU_FILTER_TEST_BLOCKS; b++) {
+			memcpy(&block, &src, sizeof(block));
+			block.num = IMU_BLOCK_MAX;
+			imu_filter_process(f, &block);
+		}
+		elapsed = mtime_now_us() - start;
+		ns = elapsed * 1000.0 / total;
+		if (khz > 0)
+			snprintf(cycles, sizeof(cycles), ", [%0.0f] cycles", ns * khz / 1e6);
+
+		if (imu_filter_get_rate(f) < chain->rate) {
+			/* 2Hz in the pass band, 1.2 x output rate folds onto 0.2 x output rate */
+			pass = imu_filter_test_gain(chain, 2);
+			alias = imu_filter_test_gain(chain, imu_filter_get_rate(f) * 1.2);
+			LOGI("%s : [%0.1f] ns%s per sample, pass band [%+0.2f] dB, alias [%0.1f] dB",
+					chain->name, ns, cycles, 20 * log10(pass), 20 * log10(alias));
+			if (fabs(20 * log10(pass)) > 0.5 || 20 * log10(alias) > -40)
+				ret = -1;
+		} else {
+			pass = imu_filter_test_gain(chain, 10);
+			alias = imu_filter_test_gain(chain, 0.05);
+			LOGI("%s : [%0.1f] ns%s per sample, 10Hz [%+0.2f] dB, 0.05Hz [%0.1f] dB",
+					chain->name, ns, cycles, 20 * log10(pass), 20 * log10(alias));
+			if (fabs(20 * log10(pass)) > 0.5 || 20 * log10(alias) > -20)
+				ret = -1;
+		}
+
+		imu_filter_destroy(f);
+	}
+	if (khz == 0)
+		LOGI("cpu clock unknown, cycles not worked out");
+
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
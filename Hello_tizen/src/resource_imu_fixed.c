@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Fixed point scaling, low pass and tilt angles.
+ *        The Debug build passes floats in core registers (softfp) and
+ *        libm's atan2/sqrt are the bulk of the per sample cost, so the
+ *        tilt path has an integer variant: Q24 scales with a 32x32->64
+ *        multiply, a Q15 low pass, and interpolated tables for atan2
+ *        (257 entries) and sqrt (769 entries over [1, 4)).
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "mpu9250.h"
+#include "imu_fixed.h"
+#include "mtime.h"
+
+#define IMU_FIXED_ATAN_STEPS			(256)	/* atan over [0, 1] */
+#define IMU_FIXED_SQRT_STEPS			(768)	/* sqrt over [1, 4), 1/256 apart */
+#define IMU_FIXED_DEG_90				(90 * Q16_ONE)
+#define IMU_FIXED_DEG_180				(180 * Q16_ONE)
+#define IMU_RAD_TO_DEG					(57.29577951f)
+
+static q16_t atan_lut[IMU_FIXED_ATAN_STEPS + 1];		/* digree, Q16.16 */
+static uint32_t sqrt_lut[IMU_FIXED_SQRT_STEPS + 1];		/* Q2.30 */
+static bool lut_ready = false;
+
+/**
+    @brief fill the atan2 & sqrt tables, once before the other imu_fixed_* calls.
+*/
+void imu_fixed_init(void)
+{
+	int i;
+
+	if (lut_ready)
+		return;
+
+	for (i = 0; i <= IMU_FIXED_ATAN_STEPS; i++)
+		atan_lut[i] = lround(atan((double)i / IMU_FIXED_ATAN_STEPS) * (180.0 / M_PI) * Q16_ONE);
+	for (i = 0; i <= IMU_FIXED_SQRT_STEPS; i++)
+		sqrt_lut[i] = llround(sqrt(1.0 + (double)i / 256) * (1 << 30));
+
+	lut_ready = true;
+}
+
+/**
+    @brief per LSB scale (< 128) in Q8.24, e.g. MPU9250_scale.accel.
+*/
+int32_t imu_fixed_scale_q24(float scale)
+{
+	return (int32_t)lroundf(scale * (1 << 24));
+}
+
+void imu_fixed_scale(const int16_t raw[3], const int32_t scale_q24[3], imu_fixed_vec_s *out)
+{
+	out->x = (q16_t)(((int64_t)raw[0] * scale_q24[0] + (1 << 7)) >> 8);
+	out->y = (q16_t)(((int64_t)raw[1] * scale_q24[1] + (1 << 7)) >> 8);
+	out->z = (q16_t)(((int64_t)raw[2] * scale_q24[2] + (1 << 7)) >> 8);
+}
+
+/**
+    @brief alpha in (0, 1], the first sample primes the filter.
+*/
+void imu_fixed_lowpass_init(imu_fixed_lowpass_s *lp, float alpha)
+{
+	memset(lp, 0x0, sizeof(*lp));
+	lp->alpha = Q15_FROM_FLOAT(alpha);
+}
+
+static inline q16_t imu_fixed_lowpass_step(q15_t alpha, q16_t y, q16_t x)
+{
+	return y + (q16_t)(((int64_t)alpha * (x - y) + (1 << 14)) >> 15);
+}
+
+/*
+ * filtered in place, settles to within 0.5 / alpha LSB of a constant input
+ */
+void imu_fixed_lowpass(imu_fixed_lowpass_s *lp, imu_fixed_vec_s *v)
+{
+	if (!lp->primed) {
+		lp->y = *v;
+		lp->primed = true;
+		return;
+	}
+
+	lp->y.x = imu_fixed_lowpass_step(lp->alpha, lp->y.x, v->x);
+	lp->y.y = imu_fixed_lowpass_step(lp->alpha, lp->y.y, v->y);
+	lp->y.z = imu_fixed_lowpass_step(lp->alpha, lp->y.z, v->z);
+	*v = lp->y;
+}
+
+/**
+    @brief rounded square root, sqrt of a Q32.32 value is its Q16.16 root.
+*/
+uint32_t imu_fixed_sqrt(uint64_t v)
+{
+	uint32_t m, i, frac;
+	uint64_t t;
+	int k;
+
+	if (v == 0)
+		return 0;
+
+	/* v = m * 4^k with m in [1, 4) as Q24 */
+	k = (63 - __builtin_clzll(v)) >> 1;
+	m = 2 * k >= 24 ? (uint32_t)(v >> (2 * k - 24)) : (uint32_t)(v << (24 - 2 * k));
+	i = (m - (1 << 24)) >> 16;
+	frac = m & 0xFFFF;
+	t = sqrt_lut[i] + (((uint64_t)(sqrt_lut[i + 1] - sqrt_lut[i]) * frac) >> 16);
+
+	return (uint32_t)(((t << k) + (1 << 29)) >> 30);
+}
+
+/**
+    @brief atan2 in digree (-180, 180], 0 for the origin.
+*/
+q16_t imu_fixed_atan2(q16_t y, q16_t x)
+{
+	uint32_t ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+	uint32_t ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+	uint32_t hi, lo, t, i, frac;
+	int shift;
+	q16_t a;
+
+	if (ax == 0 && ay == 0)
+		return 0;
+
+	hi = ax > ay ? ax : ay;
+	lo = ax > ay ? ay : ax;
+
+	/* hi to 16 bits, so lo << 15 fits */
+	shift = 16 - (32 - __builtin_clz(hi));
+	if (shift < 0) {
+		hi = (hi + (1u << (-shift - 1))) >> -shift;
+		lo = (lo + (1u << (-shift - 1))) >> -shift;
+		if (lo > hi)
+			lo = hi;
+	} else {
+		hi <<= shift;
+		lo <<= shift;
+	}
+
+	/* lo / hi in Q15, table step is 1 / 256 */
+	t = ((lo << 15) + (hi >> 1)) / hi;
+	i = t >> 7;
+	frac = t & 0x7F;
+	if (i >= IMU_FIXED_ATAN_STEPS)
+		a = atan_lut[IMU_FIXED_ATAN_STEPS];
+	else
+		a = atan_lut[i] + (((atan_lut[i + 1] - atan_lut[i]) * (int32_t)frac + (1 << 6)) >> 7);
+
+	if (ay > ax)
+		a = IMU_FIXED_DEG_90 - a;
+	if (x < 0)
+		a = IMU_FIXED_DEG_180 - a;
+
+	return y < 0 ? -a : a;
+}
+
+/**
+    @brief roll = atan2(y, z), pitch = atan2(-x, sqrt(y^2 + z^2)), digree.
+*/
+void imu_fixed_tilt(const imu_fixed_vec_s *accel, q16_t *roll, q16_t *pitch)
+{
+	uint64_t yz = (uint64_t)((int64_t)accel->y * accel->y) + (uint64_t)((int64_t)accel->z * accel->z);
+
+	*roll = imu_fixed_atan2(accel->y, accel->z);
+	*pitch = imu_fixed_atan2(-accel->x, (q16_t)imu_fixed_sqrt(yz));
+}
+
+static inline void imu_float_lowpass(float alpha, bool *primed, float y[3], float v[3])
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (*primed)
+			y[i] += alpha * (v[i] - y[i]);
+		else
+			y[i] = v[i];
+		v[i] = y[i];
+	}
+	*primed = true;
+}
+
+static inline void imu_float_tilt(const float a[3], float *roll, float *pitch)
+{
+	*roll = atan2f(a[1], a[2]) * IMU_RAD_TO_DEG;
+	*pitch = atan2f(-a[0], sqrtf(a[1] * a[1] + a[2] * a[2])) * IMU_RAD_TO_DEG;
+}
+
+/**
+    @brief accel_scale as MPU9250_scale.accel, alpha is the low pass gain.
+*/
+void imu_tilt_init(imu_tilt_s *tilt, float accel_scale, float alpha)
+{
+	memset(tilt, 0x0, sizeof(*tilt));
+#ifdef IMU_FIXED_POINT
+	imu_fixed_init();
+	tilt->scale_q24[0] = tilt->scale_q24[1] = tilt->scale_q24[2] = imu_fixed_scale_q24(accel_scale);
+	imu_fixed_lowpass_init(&tilt->lp, alpha);
+#else
+	tilt->scale = accel_scale;
+	tilt->alpha = alpha;
+#endif
+}
+
+/**
+    @brief one raw accel sample in, filtered roll & pitch (digree) out.
+*/
+void imu_tilt_update(imu_tilt_s *tilt, const int16_t raw[3], imu_angle_t *roll, imu_angle_t *pitch)
+{
+#ifdef IMU_FIXED_POINT
+	imu_fixed_vec_s a;
+
+	imu_fixed_scale(raw, tilt->scale_q24, &a);
+	imu_fixed_lowpass(&tilt->lp, &a);
+	imu_fixed_tilt(&a, roll, pitch);
+#else
+	float a[3] = { raw[0] * tilt->scale, raw[1] * tilt->scale, raw[2] * tilt->scale };
+
+	imu_float_lowpass(tilt->alpha, &tilt->primed, tilt->y, a);
+	imu_float_tilt(a, roll, pitch);
+#endif
+}
+
+
+#define IMU_FIXED_TEST_SAMPLES		(100000)
+#define IMU_FIXED_TEST_ALPHA		(0.1f)
+
+static double imu_fixed_test_angle_err(double a, double b)
+{
+	double d = fabs(a - b);
+
+	return d > 180 ? 360 - d : d;
+}
+
+/*
+ * error of each fixed point kernel against double math, then the cost per
+ * sample of raw accel to filtered roll & pitch : fixed, float, and
+ * mpu9250_compute_axis_angle (double libm, unfiltered)
+ */
+int  imu_fixed_test_main(void)
+{
+	static int16_t raw[IMU_FIXED_TEST_SAMPLES][3];
+	const float accel_scale = 1.0f / 2048;		/* 16G */
+	const float gyro_scale = 1.0f / 16.4f;		/* 2000 dps */
+	int32_t scale_q24[3];
+	imu_fixed_vec_s v;
+	imu_fixed_lowpass_s lp;
+	float a[3], y[3], roll_f, pitch_f;
+	bool primed = false;
+	q16_t roll_q, pitch_q;
+	double err, ref, scale_err = 0, sqrt_err = 0, atan_err = 0, tilt_err = 0, lp_err = 0;
+	long long start, t_fixed, t_float, t_libm;
+	unsigned int seed = 1;
+	uint64_t u;
+	int i, j, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	imu_fixed_init();
+
+	/* scaling : every raw value, accel & gyro ranges, in LSB of Q16.16 */
+	for (j = 0; j < 2; j++) {
+		float s = j ? gyro_scale : accel_scale;
+		int16_t r[3];
+
+		scale_q24[0] = scale_q24[1] = scale_q24[2] = imu_fixed_scale_q24(s);
+		for (i = -32768; i < 32768; i++) {
+			r[0] = r[1] = r[2] = i;
+			imu_fixed_scale(r, scale_q24, &v);
+			ref = (double)i * s * Q16_ONE;
+			err = fabs(v.x - ref) - fabs(ref) / (1 << 24);
+			if (err > scale_err)
+				scale_err = err;
+		}
+	}
+
+	/* sqrt : random 32 ~ 62 bit values */
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		u = ((uint64_t)rand_r(&seed) << 31 | rand_r(&seed)) >> (rand_r(&seed) % 31);
+		ref = sqrt((double)u);
+		err = fabs(imu_fixed_sqrt(u) - ref) - ref / (1 << 20);
+		if (err > sqrt_err)
+			sqrt_err = err;
+	}
+
+	/* atan2 : random points, magnitudes 2^-10 .. 2^4 */
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		double ang = (rand_r(&seed) / (double)RAND_MAX) * 2 * M_PI;
+		double mag = ldexp(1.0 + rand_r(&seed) / (double)RAND_MAX, -10 + rand_r(&seed) % 15);
+		q16_t qy = (q16_t)lround(mag * sin(ang) * Q16_ONE), qx = (q16_t)lround(mag * cos(ang) * Q16_ONE);
+
+		err = imu_fixed_test_angle_err(Q16_TO_FLOAT(imu_fixed_atan2(qy, qx)), atan2(qy, qx) * (180.0 / M_PI));
+		if (err > atan_err)
+			atan_err = err;
+	}
+
+	/* random accel, 0.1 ~ 4G in any direction, as raw 16G samples */
+	scale_q24[0] = scale_q24[1] = scale_q24[2] = imu_fixed_scale_q24(accel_scale);
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		double d[3], n, mag = 0.1 + 3.9 * rand_r(&seed) / (double)RAND_MAX;
+
+		do {
+			for (j = 0; j < 3; j++)
+				d[j] = 2.0 * rand_r(&seed) / RAND_MAX - 1;
+			n = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		} while (n < 0.1 || n > 1);
+		for (j = 0; j < 3; j++)
+			raw[i][j] = (int16_t)lround(d[j] / n * mag * 2048);
+	}
+
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		double x = raw[i][0] / 2048.0, yy = raw[i][1] / 2048.0, z = raw[i][2] / 2048.0;
+
+		imu_fixed_scale(raw[i], scale_q24, &v);
+		imu_fixed_tilt(&v, &roll_q, &pitch_q);
+		err = imu_fixed_test_angle_err(Q16_TO_FLOAT(roll_q), atan2(yy, z) * (180.0 / M_PI));
+		if (err > tilt_err)
+			tilt_err = err;
+		err = imu_fixed_test_angle_err(Q16_TO_FLOAT(pitch_q), atan2(-x, sqrt(yy * yy + z * z)) * (180.0 / M_PI));
+		if (err > tilt_err)
+			tilt_err = err;
+	}
+
+	/* low pass on the same stream, fixed against float, in G */
+	imu_fixed_lowpass_init(&lp, IMU_FIXED_TEST_ALPHA);
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		imu_fixed_scale(raw[i], scale_q24, &v);
+		imu_fixed_lowpass(&lp, &v);
+		for (j = 0; j < 3; j++)
+			a[j] = raw[i][j] * accel_scale;
+		imu_float_lowpass(IMU_FIXED_TEST_ALPHA, &primed, y, a);
+		err = fabs(Q16_TO_FLOAT(v.x) - a[0]);
+		if (err > lp_err)
+			lp_err = err;
+	}
+
+	LOGI("max error : scale [%0.2f] LSB, sqrt [%0.2f] LSB, atan2 [%0.5f] digree, tilt [%0.5f] digree, low pass [%0.6f] G",
+			scale_err, sqrt_err, atan_err, tilt_err, lp_err);
+	if (scale_err > 1.0 || sqrt_err > 1.0 || atan_err > 0.002 || tilt_err > 0.005 || lp_err > 0.5 / IMU_FIXED_TEST_ALPHA / Q16_ONE) {
+		LOGE("fixed point error out of bounds");
+		ret = -1;
+	}
+
+	/* cost per sample */
+	imu_fixed_lowpass_init(&lp, IMU_FIXED_TEST_ALPHA);
+	start = mtime_now_us();
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		imu_fixed_scale(raw[i], scale_q24, &v);
+		imu_fixed_lowpass(&lp, &v);
+		imu_fixed_tilt(&v, &roll_q, &pitch_q);
+		__asm__ volatile("" : : "r"(roll_q), "r"(pitch_q));
+	}
+	t_fixed = mtime_now_us() - start;
+
+	primed = false;
+	start = mtime_now_us();
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		for (j = 0; j < 3; j++)
+			a[j] = raw[i][j] * accel_scale;
+		imu_float_lowpass(IMU_FIXED_TEST_ALPHA, &primed, y, a);
+		imu_float_tilt(a, &roll_f, &pitch_f);
+		__asm__ volatile("" : : "r"(roll_f), "r"(pitch_f));
+	}
+	t_float = mtime_now_us() - start;
+
+	start = mtime_now_us();
+	for (i = 0; i < IMU_FIXED_TEST_SAMPLES; i++) {
+		mpu9250_compute_axis_angle(raw[i][0] * accel_scale, raw[i][1] * accel_scale, raw[i][2] * accel_scale, &pitch_f, &roll_f);
+		__asm__ volatile("" : : "r"(roll_f), "r"(pitch_f));
+	}
+	t_libm = mtime_now_us() - start;
+
+	LOGI("per sample : fixed [%lld] ns, float [%lld] ns, mpu9250_compute_axis_angle [%lld] ns, imu_tilt_update is %s",
+			t_fixed * 1000 / IMU_FIXED_TEST_SAMPLES, t_float * 1000 / IMU_FIXED_TEST_SAMPLES,
+			t_libm * 1000 / IMU_FIXED_TEST_SAMPLES,
+#ifdef IMU_FIXED_POINT
+			"fixed"
+#else
+			"float"
+#endif
+			);
+
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
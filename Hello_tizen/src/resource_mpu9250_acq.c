@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        MPU9250 acquisition thread.
+ *        The thread is the only user of the SPI device while it runs and
+ *        puts timestamped samples straight into a single producer / single
+ *        consumer ring; consumers use them in place, batch by batch.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "mpu9250.h"
+#include "spsc_ring.h"
+#include "mtime.h"
+
+#define MPU9250_ACQ_FIFO_BATCH		(64)
+
+static struct {
+	pthread_t thread;
+	volatile bool running;
+	MPU9250_acq_config config;
+	spsc_ring_h ring;
+	MPU9250_acq_stats stats;				/* written by the thread only */
+} acq;
+
+static void mpu9250_acq_count(unsigned int *counter, unsigned int n)
+{
+	__atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static void mpu9250_acq_produced(unsigned int n)
+{
+	unsigned int fill;
+
+	mpu9250_acq_count(&acq.stats.produced, n);
+	fill = spsc_ring_count(acq.ring);
+	if (fill > acq.stats.high_water)
+		__atomic_store_n(&acq.stats.high_water, fill, __ATOMIC_RELAXED);
+}
+
+static void mpu9250_acq_timespec_add(struct timespec *ts, long long us)
+{
+	ts->tv_nsec += (us % 1000000) * 1000;
+	ts->tv_sec += us / 1000000 + ts->tv_nsec / 1000000000;
+	ts->tv_nsec %= 1000000000;
+}
+
+/* one burst read per period, on absolute deadlines */
+static void mpu9250_acq_poll(void)
+{
+	long long period_us = 1000LL * (1 + acq.config.smplrt_div);
+	MPU9250_sample *slot, scratch;
+	struct timespec next;
+	long long behind;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (acq.running) {
+		mpu9250_acq_timespec_add(&next, period_us);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		behind = mtime_now_us() - (next.tv_sec * 1000000LL + next.tv_nsec / 1000);
+		if (behind >= period_us) {
+			mpu9250_acq_count(&acq.stats.late, behind / period_us);
+			mpu9250_acq_timespec_add(&next, behind / period_us * period_us);
+		}
+
+		if (spsc_ring_reserve(acq.ring, (void **)&slot, 1) == 0) {
+			resource_mpu9250_read_sample(&scratch);		/* keep the pace, drop it */
+			mpu9250_acq_count(&acq.stats.overruns, 1);
+			continue;
+		}
+		if (resource_mpu9250_read_sample(slot) == false) {
+			mpu9250_acq_count(&acq.stats.read_errors, 1);
+			continue;
+		}
+		spsc_ring_commit(acq.ring, 1);
+		mpu9250_acq_produced(1);
+	}
+}
+
+/* drain the FIFO into the ring every fifo_wake_ms */
+static void mpu9250_acq_fifo(void)
+{
+	static MPU9250_sample scratch[MPU9250_ACQ_FIFO_BATCH];
+	MPU9250_sample *slot;
+	unsigned int space;
+	int n;
+
+	while (acq.running) {
+		usleep(acq.config.fifo_wake_ms * 1000);
+
+		do {
+			space = spsc_ring_reserve(acq.ring, (void **)&slot, MPU9250_ACQ_FIFO_BATCH);
+			if (space == 0) {
+				slot = scratch;
+				space = MPU9250_ACQ_FIFO_BATCH;
+			}
+			n = resource_mpu9250_fifo_read(slot, space);
+			if (n < 0) {
+				mpu9250_acq_count(&acq.stats.read_errors, 1);
+			} else if (slot == scratch) {
+				mpu9250_acq_count(&acq.stats.overruns, n);
+			} else if (n > 0) {
+				spsc_ring_commit(acq.ring, n);
+				mpu9250_acq_produced(n);
+			}
+		} while (n > 0 && (unsigned int)n == space);
+	}
+}
+
+static void *mpu9250_acq_thread(void *data)
+{
+	if (acq.config.use_fifo)
+		mpu9250_acq_fifo();
+	else
+		mpu9250_acq_poll();
+
+	return NULL;
+}
+
+/*
+ * Start sampling on a thread, measurement must be running.
+ * No other resource_mpu9250_* call may be made until
+ * resource_mpu9250_acq_stop.
+ */
+bool resource_mpu9250_acq_start(const MPU9250_acq_config *config)
+{
+	if (acq.running || config == NULL)
+		return false;
+	if (config->use_fifo && config->fifo_wake_ms == 0)
+		return false;
+
+	memset(&acq.stats, 0x0, sizeof(acq.stats));
+	acq.config = *config;
+	if (spsc_ring_create(sizeof(MPU9250_sample), config->ring_size, &acq.ring) == false) {
+		LOGE("ring of [%u] samples failed", config->ring_size);
+		return false;
+	}
+
+	if (config->use_fifo &&
+			resource_mpu9250_fifo_start(MPU9250_BIT_FIFO_EN_ACCEL | MPU9250_BIT_FIFO_EN_TEMP | MPU9250_BIT_FIFO_EN_GYRO, config->smplrt_div) == false) {
+		spsc_ring_destroy(acq.ring);
+		acq.ring = NULL;
+		return false;
+	}
+
+	acq.running = true;
+	if (pthread_create(&acq.thread, NULL, mpu9250_acq_thread, NULL) != 0) {
+		LOGE("pthread_create failed");
+		acq.running = false;
+		if (config->use_fifo)
+			resource_mpu9250_fifo_stop();
+		spsc_ring_destroy(acq.ring);
+		acq.ring = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void resource_mpu9250_acq_stop(void)
+{
+	if (!acq.running)
+		return;
+
+	acq.running = false;
+	pthread_join(acq.thread, NULL);
+	if (acq.config.use_fifo)
+		resource_mpu9250_fifo_stop();
+
+	spsc_ring_destroy(acq.ring);
+	acq.ring = NULL;
+}
+
+/**
+    @brief oldest samples waiting, used in place until released.
+           one consumer thread only.
+    @retval number of samples at *samples, may be fewer than waiting
+            when the ring wraps
+*/
+unsigned int resource_mpu9250_acq_peek(const MPU9250_sample **samples, unsigned int max)
+{
+	if (acq.ring == NULL)
+		return 0;
+
+	return spsc_ring_peek(acq.ring, (void **)samples, max);
+}
+
+void resource_mpu9250_acq_release(unsigned int n)
+{
+	if (acq.ring != NULL)
+		spsc_ring_release(acq.ring, n);
+}
+
+void resource_mpu9250_acq_get_stats(MPU9250_acq_stats *stats)
+{
+	if (stats == NULL)
+		return;
+
+	stats->produced = __atomic_load_n(&acq.stats.produced, __ATOMIC_RELAXED);
+	stats->overruns = __atomic_load_n(&acq.stats.overruns, __ATOMIC_RELAXED);
+	stats->read_errors = __atomic_load_n(&acq.stats.read_errors, __ATOMIC_RELAXED);
+	stats->late = __atomic_load_n(&acq.stats.late, __ATOMIC_RELAXED);
+	stats->high_water = __atomic_load_n(&acq.stats.high_water, __ATOMIC_RELAXED);
+}
+
+
+#define SPI_ACQ_TEST_RING_ITEMS		(4 * 1024 * 1024)
+#define SPI_ACQ_TEST_SEC			(5)
+
+static void *spi_acq_test_producer(void *data)
+{
+	spsc_ring_h ring = data;
+	MPU9250_sample *slot;
+	unsigned int i, n;
+
+	for (i = 0; i < SPI_ACQ_TEST_RING_ITEMS; ) {
+		n = spsc_ring_reserve(ring, (void **)&slot, 1);
+		if (n == 0) {
+			sched_yield();
+			continue;
+		}
+		slot->timestamp_us = i++;
+		spsc_ring_commit(ring, 1);
+	}
+
+	return NULL;
+}
+
+/* ring alone : producer thread against a batch consumer, no sensor */
+static int spi_acq_test_ring(void)
+{
+	const MPU9250_sample *batch;
+	spsc_ring_h ring;
+	pthread_t thread;
+	long long start, elapsed;
+	unsigned int i, n, received = 0, errors = 0;
+
+	if (spsc_ring_create(sizeof(MPU9250_sample), 1024, &ring) == false)
+		return -1;
+
+	start = mtime_now_us();
+	pthread_create(&thread, NULL, spi_acq_test_producer, ring);
+	while (received < SPI_ACQ_TEST_RING_ITEMS) {
+		n = spsc_ring_peek(ring, (void **)&batch, 256);
+		if (n == 0)
+			sched_yield();
+		for (i = 0; i < n; i++)
+			if (batch[i].timestamp_us != received + i)
+				errors++;
+		spsc_ring_release(ring, n);
+		received += n;
+	}
+	elapsed = mtime_now_us() - start;
+	pthread_join(thread, NULL);
+	spsc_ring_destroy(ring);
+
+	LOGI("ring : [%u] samples of [%u] bytes in [%lld] ms, [%lld] samples/s, [%u] out of order",
+			received, (unsigned int)sizeof(MPU9250_sample), elapsed / 1000, received * 1000000LL / elapsed, errors);
+	return errors == 0 ? 0 : -1;
+}
+
+/* sensor through the thread, the consumer pulls every 10ms */
+static int spi_acq_test_sensor(const char *name, const MPU9250_acq_config *config)
+{
+	const MPU9250_sample *batch;
+	MPU9250_acq_stats stats;
+	long long start, elapsed, last_us = 0;
+	unsigned int i, n, received = 0, batches = 0, backwards = 0;
+	float az = 0;
+
+	if (resource_mpu9250_acq_start(config) == false)
+		return -1;
+
+	start = mtime_now_us();
+	while ((elapsed = mtime_now_us() - start) < SPI_ACQ_TEST_SEC * 1000000LL) {
+		usleep(10000);
+		while ((n = resource_mpu9250_acq_peek(&batch, 256)) > 0) {
+			for (i = 0; i < n; i++) {
+				if (batch[i].timestamp_us <= last_us)
+					backwards++;
+				last_us = batch[i].timestamp_us;
+				az += batch[i].accel.z;
+			}
+			resource_mpu9250_acq_release(n);
+			received += n;
+			batches++;
+		}
+	}
+	resource_mpu9250_acq_stop();
+	resource_mpu9250_acq_get_stats(&stats);
+
+	LOGI("%s : [%lld] samples/s for [%lld] set, [%u] per batch, avg az [%0.2f]", name,
+			received * 1000000LL / elapsed, 1000LL / (1 + config->smplrt_div), batches ? received / batches : 0,
+			received ? az / received : 0);
+	LOGI("%s : [%u] overruns, [%u] late, [%u] read errors, high water [%u] of [%u], [%u] not increasing", name,
+			stats.overruns, stats.late, stats.read_errors, stats.high_water, config->ring_size, backwards);
+	return received > 0 && stats.overruns == 0 && backwards == 0 ? 0 : -1;
+}
+
+/*
+ * sustained samples per second with a concurrent consumer
+ */
+int  spi_acq_test_main(void)
+{
+	MPU9250_acq_config poll = { .smplrt_div = 0, .ring_size = 1024 };
+	MPU9250_acq_config fifo = { .smplrt_div = 0, .use_fifo = true, .fifo_wake_ms = 20, .ring_size = 1024 };
+	int ret;
+
+	LOGI("%s starting...\n", __func__);
+
+	ret = spi_acq_test_ring();
+
+	if (resource_mpu9250_spi_init() < 0 || resource_mpu9250_dev_init() == false ||
+			resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL_2000DPS, MPU9250_BIT_ACCEL_FS_SEL_16G, MPU9250_BIT_DLPF_CFG_184HZ, MPU9250_BIT_A_DLPFCFG_184HZ) == false) {
+		LOGI("%s MPU9250 init fail ...", __func__);
+		resource_mpu9250_spi_fini();
+		return -1;
+	}
+
+	if (spi_acq_test_sensor("poll", &poll) < 0)
+		ret = -1;
+	if (spi_acq_test_sensor("fifo", &fifo) < 0)
+		ret = -1;
+
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
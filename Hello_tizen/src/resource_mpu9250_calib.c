@@ -0,0 +1,778 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        MPU9250 calibration.
+ *        Samples are cut in windows of MPU9250_CALIB_WINDOW; a window
+ *        whose gyro & accel spread stays under the limits is stationary,
+ *        its means go into the gyro bias and the accel orientations.
+ *        The magnetometer fit keeps only the 9x9 normal equations of
+ *        x^T M x + 2 v^T x = 1, so any number of samples costs 1 KB.
+ *        Gyro & accel corrections end up in the chip's offset registers
+ *        (1/32.8 digree/s, 0.98 mG steps), the host pays nothing per sample.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <app_common.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "mpu9250.h"
+#include "mpu9250_calib.h"
+#include "mtime.h"
+
+#define MPU9250_CALIB_POSE_DIST			(0.1)	/* G, window means closer than this are one pose */
+#define MPU9250_CALIB_MAG_AXIS_RATIO	(16.0)	/* max / min ellipsoid eigenvalue */
+
+typedef struct{
+	double accel[3];
+	double weight;						/* windows */
+}mpu9250_calib_pose_s;
+
+struct _mpu9250_calib_s {
+	/* current window */
+	int n;
+	double gyro_sum[3], gyro_sq[3];
+	double accel_sum[3], accel_sq[3];
+	double temp_sum;
+
+	/* stationary windows */
+	double gyro_bias_sum[3];
+	double temp_sum_all;
+	mpu9250_calib_pose_s poses[MPU9250_CALIB_POSES];
+
+	/* magnetometer normal equations, samples scaled by mag_norm */
+	double mag_norm;
+	double mag_ata[9][9];
+	double mag_atb[9];
+
+	mpu9250_calib_stats_s stats;
+};
+
+bool mpu9250_calib_create(mpu9250_calib_h *calib)
+{
+	mpu9250_calib_h c;
+
+	if (calib == NULL)
+		return false;
+
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		return false;
+
+	*calib = c;
+	return true;
+}
+
+void mpu9250_calib_destroy(mpu9250_calib_h calib)
+{
+	free(calib);
+}
+
+static void mpu9250_calib_add_pose(mpu9250_calib_h c, const double accel[3])
+{
+	mpu9250_calib_pose_s *pose;
+	double d;
+	unsigned int i;
+	int j;
+
+	for (i = 0; i < c->stats.poses; i++) {
+		pose = &c->poses[i];
+		for (d = 0, j = 0; j < 3; j++)
+			d += (pose->accel[j] - accel[j]) * (pose->accel[j] - accel[j]);
+		if (d < MPU9250_CALIB_POSE_DIST * MPU9250_CALIB_POSE_DIST) {
+			for (j = 0; j < 3; j++)
+				pose->accel[j] = (pose->accel[j] * pose->weight + accel[j]) / (pose->weight + 1);
+			pose->weight++;
+			return;
+		}
+	}
+
+	if (c->stats.poses == MPU9250_CALIB_POSES)
+		return;
+
+	pose = &c->poses[c->stats.poses++];
+	memcpy(pose->accel, accel, sizeof(pose->accel));
+	pose->weight = 1;
+}
+
+static void mpu9250_calib_end_window(mpu9250_calib_h c)
+{
+	double mean_g[3], mean_a[3], var;
+	bool still = true;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		mean_g[i] = c->gyro_sum[i] / c->n;
+		var = c->gyro_sq[i] / c->n - mean_g[i] * mean_g[i];
+		if (var > MPU9250_CALIB_GYRO_STD_MAX * MPU9250_CALIB_GYRO_STD_MAX)
+			still = false;
+
+		mean_a[i] = c->accel_sum[i] / c->n;
+		var = c->accel_sq[i] / c->n - mean_a[i] * mean_a[i];
+		if (var > MPU9250_CALIB_ACCEL_STD_MAX * MPU9250_CALIB_ACCEL_STD_MAX)
+			still = false;
+	}
+
+	c->stats.windows++;
+	if (still) {
+		for (i = 0; i < 3; i++)
+			c->gyro_bias_sum[i] += mean_g[i];
+		c->temp_sum_all += c->temp_sum / c->n;
+		mpu9250_calib_add_pose(c, mean_a);
+		c->stats.stationary++;
+	}
+
+	c->n = 0;
+	memset(c->gyro_sum, 0x0, sizeof(c->gyro_sum));
+	memset(c->gyro_sq, 0x0, sizeof(c->gyro_sq));
+	memset(c->accel_sum, 0x0, sizeof(c->accel_sum));
+	memset(c->accel_sq, 0x0, sizeof(c->accel_sq));
+	c->temp_sum = 0;
+}
+
+/*
+ * driver samples in order, the device kept still for a few windows at a time
+ */
+void mpu9250_calib_feed(mpu9250_calib_h calib, const MPU9250_sample *samples, int num)
+{
+	const MPU9250_sample *s;
+	float g[3], a[3];
+	int i, j;
+
+	for (i = 0; i < num; i++) {
+		s = &samples[i];
+		g[0] = s->gyro.x; g[1] = s->gyro.y; g[2] = s->gyro.z;
+		a[0] = s->accel.x; a[1] = s->accel.y; a[2] = s->accel.z;
+		for (j = 0; j < 3; j++) {
+			calib->gyro_sum[j] += g[j];
+			calib->gyro_sq[j] += (double)g[j] * g[j];
+			calib->accel_sum[j] += a[j];
+			calib->accel_sq[j] += (double)a[j] * a[j];
+		}
+		calib->temp_sum += s->temp;
+
+		if (++calib->n == MPU9250_CALIB_WINDOW)
+			mpu9250_calib_end_window(calib);
+	}
+}
+
+void mpu9250_calib_feed_mag(mpu9250_calib_h calib, const MPU9250_magnetometer_val *mag)
+{
+	double u[3], d[9];
+	int i, j;
+
+	if (calib->mag_norm == 0) {
+		calib->mag_norm = sqrt((double)mag->x * mag->x + (double)mag->y * mag->y + (double)mag->z * mag->z);
+		if (calib->mag_norm == 0)
+			return;
+		calib->mag_norm = 1 / calib->mag_norm;
+	}
+
+	u[0] = mag->x * calib->mag_norm;
+	u[1] = mag->y * calib->mag_norm;
+	u[2] = mag->z * calib->mag_norm;
+
+	d[0] = u[0] * u[0];
+	d[1] = u[1] * u[1];
+	d[2] = u[2] * u[2];
+	d[3] = 2 * u[1] * u[2];
+	d[4] = 2 * u[0] * u[2];
+	d[5] = 2 * u[0] * u[1];
+	d[6] = 2 * u[0];
+	d[7] = 2 * u[1];
+	d[8] = 2 * u[2];
+
+	for (i = 0; i < 9; i++) {
+		for (j = i; j < 9; j++)
+			calib->mag_ata[i][j] += d[i] * d[j];
+		calib->mag_atb[i] += d[i];
+	}
+	calib->stats.mag_samples++;
+}
+
+void mpu9250_calib_get_stats(mpu9250_calib_h calib, mpu9250_calib_stats_s *stats)
+{
+	if (stats != NULL)
+		*stats = calib->stats;
+}
+
+/*
+ * a x = b for n x n row major a, x left in b; a is destroyed
+ */
+static bool mpu9250_calib_linsolve(double *a, double *b, int n)
+{
+	double scale = 0, f, t;
+	int i, j, k, p;
+
+	for (i = 0; i < n; i++)
+		if (fabs(a[i * n + i]) > scale)
+			scale = fabs(a[i * n + i]);
+	if (scale == 0)
+		return false;
+
+	for (k = 0; k < n; k++) {
+		for (p = k, i = k + 1; i < n; i++)
+			if (fabs(a[i * n + k]) > fabs(a[p * n + k]))
+				p = i;
+		if (fabs(a[p * n + k]) < 1e-12 * scale)
+			return false;
+		if (p != k) {
+			for (j = 0; j < n; j++) {
+				t = a[k * n + j]; a[k * n + j] = a[p * n + j]; a[p * n + j] = t;
+			}
+			t = b[k]; b[k] = b[p]; b[p] = t;
+		}
+		for (i = k + 1; i < n; i++) {
+			f = a[i * n + k] / a[k * n + k];
+			for (j = k; j < n; j++)
+				a[i * n + j] -= f * a[k * n + j];
+			b[i] -= f * b[k];
+		}
+	}
+
+	for (k = n - 1; k >= 0; k--) {
+		for (j = k + 1; j < n; j++)
+			b[k] -= a[k * n + j] * b[j];
+		b[k] /= a[k * n + k];
+	}
+
+	return true;
+}
+
+/* cyclic Jacobi, a = v diag(d) v^T for symmetric a */
+static void mpu9250_calib_eigen3(double a[3][3], double v[3][3], double d[3])
+{
+	double theta, t, c, s, x, y;
+	int sweep, p, q, k;
+
+	memset(v, 0x0, sizeof(double) * 9);
+	v[0][0] = v[1][1] = v[2][2] = 1;
+
+	for (sweep = 0; sweep < 50; sweep++) {
+		if (a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2] < 1e-30)
+			break;
+		for (p = 0; p < 2; p++) {
+			for (q = p + 1; q < 3; q++) {
+				if (a[p][q] == 0)
+					continue;
+				theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+				t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+				c = 1 / sqrt(t * t + 1);
+				s = t * c;
+				for (k = 0; k < 3; k++) {
+					x = a[k][p]; y = a[k][q];
+					a[k][p] = c * x - s * y;
+					a[k][q] = s * x + c * y;
+				}
+				for (k = 0; k < 3; k++) {
+					x = a[p][k]; y = a[q][k];
+					a[p][k] = c * x - s * y;
+					a[q][k] = s * x + c * y;
+				}
+				for (k = 0; k < 3; k++) {
+					x = v[k][p]; y = v[k][q];
+					v[k][p] = c * x - s * y;
+					v[k][q] = s * x + c * y;
+				}
+			}
+		}
+	}
+
+	for (k = 0; k < 3; k++)
+		d[k] = a[k][k];
+}
+
+/*
+ * |a - o|^2 = r^2 over the poses, linear in (o, r^2 - |o|^2)
+ */
+static bool mpu9250_calib_solve_accel(mpu9250_calib_h c, float offset[3])
+{
+	const mpu9250_calib_pose_s *pose, *best = NULL;
+	double ata[4][4] = {{0}}, atb[4] = {0}, row[4], rhs, r2;
+	unsigned int i;
+	int j, k, axis;
+
+	if (c->stats.poses == 0)
+		return false;
+
+	if (c->stats.poses >= 4) {
+		for (i = 0; i < c->stats.poses; i++) {
+			pose = &c->poses[i];
+			row[0] = 2 * pose->accel[0];
+			row[1] = 2 * pose->accel[1];
+			row[2] = 2 * pose->accel[2];
+			row[3] = 1;
+			rhs = pose->accel[0] * pose->accel[0] + pose->accel[1] * pose->accel[1] + pose->accel[2] * pose->accel[2];
+			for (j = 0; j < 4; j++) {
+				for (k = 0; k < 4; k++)
+					ata[j][k] += pose->weight * row[j] * row[k];
+				atb[j] += pose->weight * row[j] * rhs;
+			}
+		}
+		if (mpu9250_calib_linsolve(&ata[0][0], atb, 4)) {
+			r2 = atb[3] + atb[0] * atb[0] + atb[1] * atb[1] + atb[2] * atb[2];
+			if (r2 > 0.8 * 0.8 && r2 < 1.2 * 1.2) {
+				for (j = 0; j < 3; j++)
+					offset[j] = atb[j];
+				return true;
+			}
+		}
+		LOGE("accel sphere fit failed, poses do not span the sphere");
+	}
+
+	/* the pose seen longest lies on an axis, 1G along it */
+	for (i = 0; i < c->stats.poses; i++)
+		if (best == NULL || c->poses[i].weight > best->weight)
+			best = &c->poses[i];
+	for (axis = 0, j = 1; j < 3; j++)
+		if (fabs(best->accel[j]) > fabs(best->accel[axis]))
+			axis = j;
+	for (j = 0; j < 3; j++)
+		offset[j] = best->accel[j];
+	offset[axis] -= best->accel[axis] > 0 ? 1 : -1;
+
+	return true;
+}
+
+static bool mpu9250_calib_solve_mag(mpu9250_calib_h c, mpu9250_calib_data_s *data)
+{
+	double ata[9][9], p[9], m[3][3], mi[3][3], v[3][3], ev[3], ctr[3], k, det, s;
+	int i, j, l;
+
+	if (c->stats.mag_samples < MPU9250_CALIB_MAG_MIN)
+		return false;
+
+	for (i = 0; i < 9; i++) {
+		for (j = 0; j < 9; j++)
+			ata[i][j] = j >= i ? c->mag_ata[i][j] : c->mag_ata[j][i];
+		p[i] = c->mag_atb[i];
+	}
+	if (mpu9250_calib_linsolve(&ata[0][0], p, 9) == false)
+		return false;
+
+	m[0][0] = p[0]; m[1][1] = p[1]; m[2][2] = p[2];
+	m[1][2] = m[2][1] = p[3];
+	m[0][2] = m[2][0] = p[4];
+	m[0][1] = m[1][0] = p[5];
+
+	/* centre -M^-1 v, then (x - c)^T M (x - c) = 1 + c^T M c */
+	memcpy(mi, m, sizeof(mi));
+	for (i = 0; i < 3; i++)
+		ctr[i] = -p[6 + i];
+	if (mpu9250_calib_linsolve(&mi[0][0], ctr, 3) == false)
+		return false;
+
+	k = 1;
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			k += ctr[i] * m[i][j] * ctr[j];
+	if (k <= 0)
+		return false;
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			mi[i][j] = m[i][j] / k;
+
+	mpu9250_calib_eigen3(mi, v, ev);
+	for (i = 0; i < 3; i++)
+		if (ev[i] <= 0)
+			return false;
+	if (fmax(fmax(ev[0], ev[1]), ev[2]) > MPU9250_CALIB_MAG_AXIS_RATIO * fmin(fmin(ev[0], ev[1]), ev[2]))
+		return false;
+
+	/* sqrt(M) maps the ellipsoid to the unit sphere, s keeps its volume */
+	det = ev[0] * ev[1] * ev[2];
+	s = pow(det, -1.0 / 6);
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			double w = 0;
+			for (l = 0; l < 3; l++)
+				w += v[i][l] * sqrt(ev[l]) * v[j][l];
+			data->mag_matrix[i][j] = s * w;
+		}
+		data->mag_offset[i] = ctr[i] / c->mag_norm;
+	}
+	data->mag_radius = s / c->mag_norm;
+
+	return true;
+}
+
+/**
+    @brief work out what the collected samples allow.
+    @return mpu9250_calib_part_e set in data->valid
+*/
+unsigned int mpu9250_calib_solve(mpu9250_calib_h calib, mpu9250_calib_data_s *data)
+{
+	int i;
+
+	memset(data, 0x0, sizeof(*data));
+
+	if (calib->stats.stationary > 0) {
+		for (i = 0; i < 3; i++)
+			data->gyro_bias[i] = calib->gyro_bias_sum[i] / calib->stats.stationary;
+		data->temp = calib->temp_sum_all / calib->stats.stationary;
+		data->valid |= MPU9250_CALIB_GYRO;
+	}
+
+	if (mpu9250_calib_solve_accel(calib, data->accel_offset))
+		data->valid |= MPU9250_CALIB_ACCEL;
+
+	if (mpu9250_calib_solve_mag(calib, data))
+		data->valid |= MPU9250_CALIB_MAG;
+
+	return data->valid;
+}
+
+static bool mpu9250_calib_path(char *path, size_t size, const char *name, const char *suffix)
+{
+	char *dir = app_get_data_path();
+
+	if (dir == NULL) {
+		LOGE("app_get_data_path failed");
+		return false;
+	}
+	snprintf(path, size, "%s%s%s", dir, name, suffix);
+	free(dir);
+
+	return true;
+}
+
+/*
+ * name in app_get_data_path, replaced as a whole
+ */
+static bool mpu9250_calib_save_file(const char *name, const mpu9250_calib_data_s *data)
+{
+	char path[256], tmp[256];
+	FILE *fp;
+	int ok;
+
+	if (mpu9250_calib_path(path, sizeof(path), name, "") == false || mpu9250_calib_path(tmp, sizeof(tmp), name, ".tmp") == false)
+		return false;
+
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		LOGE("fopen %s failed", tmp);
+		return false;
+	}
+
+	fprintf(fp, "mpu9250_calib 1\n");
+	fprintf(fp, "valid %u\n", data->valid);
+	fprintf(fp, "temp %.9g\n", data->temp);
+	fprintf(fp, "gyro_bias %.9g %.9g %.9g\n", data->gyro_bias[0], data->gyro_bias[1], data->gyro_bias[2]);
+	fprintf(fp, "accel_offset %.9g %.9g %.9g\n", data->accel_offset[0], data->accel_offset[1], data->accel_offset[2]);
+	fprintf(fp, "mag_offset %.9g %.9g %.9g\n", data->mag_offset[0], data->mag_offset[1], data->mag_offset[2]);
+	fprintf(fp, "mag_matrix %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+			data->mag_matrix[0][0], data->mag_matrix[0][1], data->mag_matrix[0][2],
+			data->mag_matrix[1][0], data->mag_matrix[1][1], data->mag_matrix[1][2],
+			data->mag_matrix[2][0], data->mag_matrix[2][1], data->mag_matrix[2][2]);
+	fprintf(fp, "mag_radius %.9g\n", data->mag_radius);
+
+	ok = ferror(fp) == 0;
+	if (fclose(fp) != 0 || !ok || rename(tmp, path) != 0) {
+		LOGE("writing %s failed", path);
+		unlink(tmp);
+		return false;
+	}
+
+	return true;
+}
+
+static bool mpu9250_calib_load_file(const char *name, mpu9250_calib_data_s *data)
+{
+	char path[256];
+	FILE *fp;
+	int version, n;
+
+	if (mpu9250_calib_path(path, sizeof(path), name, "") == false)
+		return false;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+
+	memset(data, 0x0, sizeof(*data));
+	n = fscanf(fp, " mpu9250_calib %d", &version);
+	if (n == 1 && version == 1) {
+		n += fscanf(fp, " valid %u", &data->valid);
+		n += fscanf(fp, " temp %f", &data->temp);
+		n += fscanf(fp, " gyro_bias %f %f %f", &data->gyro_bias[0], &data->gyro_bias[1], &data->gyro_bias[2]);
+		n += fscanf(fp, " accel_offset %f %f %f", &data->accel_offset[0], &data->accel_offset[1], &data->accel_offset[2]);
+		n += fscanf(fp, " mag_offset %f %f %f", &data->mag_offset[0], &data->mag_offset[1], &data->mag_offset[2]);
+		n += fscanf(fp, " mag_matrix %f %f %f %f %f %f %f %f %f",
+				&data->mag_matrix[0][0], &data->mag_matrix[0][1], &data->mag_matrix[0][2],
+				&data->mag_matrix[1][0], &data->mag_matrix[1][1], &data->mag_matrix[1][2],
+				&data->mag_matrix[2][0], &data->mag_matrix[2][1], &data->mag_matrix[2][2]);
+		n += fscanf(fp, " mag_radius %f", &data->mag_radius);
+	}
+	fclose(fp);
+
+	if (n != 22) {
+		LOGE("%s is damaged", path);
+		memset(data, 0x0, sizeof(*data));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+    @brief write data to MPU9250_CALIB_FILE, replaced as a whole.
+*/
+bool mpu9250_calib_save(const mpu9250_calib_data_s *data)
+{
+	return mpu9250_calib_save_file(MPU9250_CALIB_FILE, data);
+}
+
+/**
+    @brief read MPU9250_CALIB_FILE, false when missing or damaged.
+*/
+bool mpu9250_calib_load(mpu9250_calib_data_s *data)
+{
+	return mpu9250_calib_load_file(MPU9250_CALIB_FILE, data);
+}
+
+bool mpu9250_calib_apply(const mpu9250_calib_data_s *data)
+{
+	if (resource_mpu9250_set_offsets(data->valid & MPU9250_CALIB_GYRO ? data->gyro_bias : NULL,
+			data->valid & MPU9250_CALIB_ACCEL ? data->accel_offset : NULL) == false)
+		return false;
+
+	if (data->valid & MPU9250_CALIB_MAG)
+		resource_mpu9250_set_mag_correction(data->mag_offset, (const float (*)[3])data->mag_matrix);
+	else
+		resource_mpu9250_set_mag_correction(NULL, NULL);
+
+	return true;
+}
+
+
+#define SPI_CALIB_TEST_POSE_SAMPLES	(500)
+#define SPI_CALIB_TEST_MAG_SAMPLES	(1000)
+#define SPI_CALIB_TEST_SEC			(2)
+#define SPI_CALIB_TEST_PERIOD_US	(5000)
+#define SPI_CALIB_TEST_FILE			"mpu9250_calib_test.txt"	/* made up values, kept away from MPU9250_CALIB_FILE */
+
+static double spi_calib_test_noise(unsigned int *seed, double std)
+{
+	double u1 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0), u2 = rand_r(seed) / (RAND_MAX + 1.0);
+
+	return std * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+/*
+ * known errors on synthetic data : 8 orientations, a moving stretch
+ * that must be left out, a magnetometer with hard & soft iron
+ */
+static int spi_calib_test_synthetic(void)
+{
+	static const float gyro_bias[3] = { 0.8f, -1.2f, 0.4f };
+	static const float accel_offset[3] = { 0.03f, -0.02f, 0.05f };
+	static const float hard[3] = { 40, -25, 60 };
+	static const float soft[3][3] = { { 1.1f, 0.05f, 0 }, { 0.05f, 0.9f, 0.03f }, { 0, 0.03f, 1.0f } };
+	static const float down[8][3] = {
+		{ 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 },
+		{ 0.577f, 0.577f, 0.577f }, { -0.707f, 0, 0.707f },
+	};
+	MPU9250_sample sample;
+	MPU9250_magnetometer_val mag;
+	mpu9250_calib_data_s data, loaded;
+	char path[256];
+	mpu9250_calib_stats_s stats;
+	mpu9250_calib_h calib;
+	double f[3], n, len, len_sum = 0, len_sq = 0, gyro_err = 0, accel_err = 0, mag_err = 0;
+	unsigned int seed = 1;
+	int p, i, j, ret = 0;
+
+	if (mpu9250_calib_create(&calib) == false)
+		return -1;
+
+	memset(&sample, 0x0, sizeof(sample));
+	sample.temp = 30;
+	for (p = 0; p < 8; p++) {
+		for (i = 0; i < SPI_CALIB_TEST_POSE_SAMPLES; i++) {
+			sample.gyro.x = gyro_bias[0] + spi_calib_test_noise(&seed, 0.05);
+			sample.gyro.y = gyro_bias[1] + spi_calib_test_noise(&seed, 0.05);
+			sample.gyro.z = gyro_bias[2] + spi_calib_test_noise(&seed, 0.05);
+			sample.accel.x = down[p][0] + accel_offset[0] + spi_calib_test_noise(&seed, 0.002);
+			sample.accel.y = down[p][1] + accel_offset[1] + spi_calib_test_noise(&seed, 0.002);
+			sample.accel.z = down[p][2] + accel_offset[2] + spi_calib_test_noise(&seed, 0.002);
+			mpu9250_calib_feed(calib, &sample, 1);
+		}
+		/* turned over to the next one */
+		for (i = 0; i < MPU9250_CALIB_WINDOW * 2; i++) {
+			sample.gyro.x = gyro_bias[0] + 30 * sin(i * 0.05);
+			sample.gyro.y = gyro_bias[1] + 20 * cos(i * 0.05);
+			sample.accel.x = sin(i * 0.03);
+			mpu9250_calib_feed(calib, &sample, 1);
+		}
+	}
+
+	for (i = 0; i < SPI_CALIB_TEST_MAG_SAMPLES; i++) {
+		do {
+			for (j = 0; j < 3; j++)
+				f[j] = 2.0 * rand_r(&seed) / RAND_MAX - 1;
+			n = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+		} while (n < 0.1 || n > 1);
+		for (j = 0; j < 3; j++)
+			f[j] *= 300 / n;
+		mag.x = soft[0][0] * f[0] + soft[0][1] * f[1] + soft[0][2] * f[2] + hard[0] + spi_calib_test_noise(&seed, 1);
+		mag.y = soft[1][0] * f[0] + soft[1][1] * f[1] + soft[1][2] * f[2] + hard[1] + spi_calib_test_noise(&seed, 1);
+		mag.z = soft[2][0] * f[0] + soft[2][1] * f[1] + soft[2][2] * f[2] + hard[2] + spi_calib_test_noise(&seed, 1);
+		mpu9250_calib_feed_mag(calib, &mag);
+	}
+
+	mpu9250_calib_get_stats(calib, &stats);
+	if (mpu9250_calib_solve(calib, &data) != (MPU9250_CALIB_GYRO | MPU9250_CALIB_ACCEL | MPU9250_CALIB_MAG)) {
+		LOGE("solve : valid [0x%x]", data.valid);
+		mpu9250_calib_destroy(calib);
+		return -1;
+	}
+
+	for (j = 0; j < 3; j++) {
+		gyro_err = fmax(gyro_err, fabs(data.gyro_bias[j] - gyro_bias[j]));
+		accel_err = fmax(accel_err, fabs(data.accel_offset[j] - accel_offset[j]));
+		mag_err = fmax(mag_err, fabs(data.mag_offset[j] - hard[j]));
+	}
+
+	/* corrected field strength should not depend on the direction */
+	seed = 2;
+	for (i = 0; i < SPI_CALIB_TEST_MAG_SAMPLES; i++) {
+		double m[3];
+
+		for (j = 0; j < 3; j++)
+			f[j] = spi_calib_test_noise(&seed, 1);
+		n = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+		for (j = 0; j < 3; j++)
+			f[j] *= 300 / n;
+		for (j = 0; j < 3; j++)
+			m[j] = soft[j][0] * f[0] + soft[j][1] * f[1] + soft[j][2] * f[2] + hard[j] - data.mag_offset[j];
+		for (len = 0, j = 0; j < 3; j++) {
+			double c = data.mag_matrix[j][0] * m[0] + data.mag_matrix[j][1] * m[1] + data.mag_matrix[j][2] * m[2];
+			len += c * c;
+		}
+		len = sqrt(len);
+		len_sum += len;
+		len_sq += len * len;
+	}
+	len = len_sum / SPI_CALIB_TEST_MAG_SAMPLES;
+	n = sqrt(len_sq / SPI_CALIB_TEST_MAG_SAMPLES - len * len) / len;
+
+	LOGI("synthetic : [%u] windows, [%u] stationary, [%u] poses, [%u] mag samples",
+			stats.windows, stats.stationary, stats.poses, stats.mag_samples);
+	LOGI("synthetic : gyro bias err [%0.4f] dps, accel offset err [%0.4f] G, hard iron err [%0.2f], field [%0.1f] spread [%0.3f] %%",
+			gyro_err, accel_err, mag_err, len, n * 100);
+	if (gyro_err > 0.01 || accel_err > 0.002 || mag_err > 2 || n > 0.01)
+		ret = -1;
+
+	if (mpu9250_calib_save_file(SPI_CALIB_TEST_FILE, &data) == false || mpu9250_calib_load_file(SPI_CALIB_TEST_FILE, &loaded) == false
+			|| memcmp(&data, &loaded, sizeof(data)) != 0) {
+		LOGE("save & load mismatch");
+		ret = -1;
+	}
+	if (mpu9250_calib_path(path, sizeof(path), SPI_CALIB_TEST_FILE, ""))
+		unlink(path);
+
+	mpu9250_calib_destroy(calib);
+	return ret;
+}
+
+static void spi_calib_test_mean(int num, float gyro[3], float *accel_norm)
+{
+	MPU9250_sample sample;
+	double g[3] = { 0 }, a = 0;
+	int i, n = 0;
+
+	for (i = 0; i < num; i++) {
+		if (resource_mpu9250_read_sample(&sample)) {
+			g[0] += sample.gyro.x;
+			g[1] += sample.gyro.y;
+			g[2] += sample.gyro.z;
+			a += sqrt(sample.accel.x * sample.accel.x + sample.accel.y * sample.accel.y + sample.accel.z * sample.accel.z);
+			n++;
+		}
+		usleep(SPI_CALIB_TEST_PERIOD_US);
+	}
+
+	for (i = 0; i < 3; i++)
+		gyro[i] = n ? g[i] / n : 0;
+	*accel_norm = n ? a / n : 0;
+}
+
+/*
+ * synthetic check of the fits, then the sensor lying still : gyro bias &
+ * level accel offset into the chip, residuals before & after
+ */
+int  spi_calib_test_main(void)
+{
+	MPU9250_sample sample;
+	mpu9250_calib_data_s data;
+	mpu9250_calib_h calib = NULL;
+	float g[3], a;
+	int i, ret;
+
+	LOGI("%s starting...\n", __func__);
+
+	ret = spi_calib_test_synthetic();
+
+	if (resource_mpu9250_spi_init() < 0 || resource_mpu9250_dev_init() == false
+			|| resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL_250DPS, MPU9250_BIT_ACCEL_FS_SEL_2G, MPU9250_BIT_DLPF_CFG_41HZ, MPU9250_BIT_A_DLPFCFG_41HZ) == false
+			|| mpu9250_calib_create(&calib) == false) {
+		LOGI("%s MPU9250 init fail ...", __func__);
+		goto error;
+	}
+
+	resource_mpu9250_set_offsets(NULL, NULL);
+	spi_calib_test_mean(200, g, &a);
+	LOGI("before : gyro [%0.3f %0.3f %0.3f] dps, |accel| [%0.4f] G", g[0], g[1], g[2], a);
+
+	for (i = 0; i < SPI_CALIB_TEST_SEC * 1000000 / SPI_CALIB_TEST_PERIOD_US; i++) {
+		if (resource_mpu9250_read_sample(&sample))
+			mpu9250_calib_feed(calib, &sample, 1);
+		usleep(SPI_CALIB_TEST_PERIOD_US);
+	}
+	if ((mpu9250_calib_solve(calib, &data) & MPU9250_CALIB_GYRO) == 0) {
+		LOGE("no stationary window, keep the sensor still");
+		goto error;
+	}
+	LOGI("bias [%0.3f %0.3f %0.3f] dps, accel offset [%0.4f %0.4f %0.4f] G at [%0.1f] C",
+			data.gyro_bias[0], data.gyro_bias[1], data.gyro_bias[2],
+			data.accel_offset[0], data.accel_offset[1], data.accel_offset[2], data.temp);
+
+	mpu9250_calib_apply(&data);
+	spi_calib_test_mean(200, g, &a);
+	LOGI("after : gyro [%0.3f %0.3f %0.3f] dps, |accel| [%0.4f] G", g[0], g[1], g[2], a);
+	for (i = 0; i < 3; i++)
+		if (fabsf(g[i]) > 0.1f)
+			ret = -1;
+	mpu9250_calib_save(&data);
+
+	mpu9250_calib_destroy(calib);
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+
+error:
+	LOGI("%s error exiting...\n", __func__);
+	mpu9250_calib_destroy(calib);
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	return -1;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Time base shared by the UART, VR3, modem & sensor code.
+ *        clock() counts cpu time and stops while blocked in I/O,
+ *        everything here runs on CLOCK_MONOTONIC instead.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "mtime.h"
+
+static bool mtime_virtual = false;
+static long long mtime_virtual_us;		/* read & written with __atomic, threads share it */
+static long long mtime_cached;			/* __atomic as well, 64 bit stores tear on 32 bit ARM */
+
+static long long mtime_real_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+long long mtime_now_us(void)
+{
+	if (__atomic_load_n(&mtime_virtual, __ATOMIC_ACQUIRE))
+		return __atomic_load_n(&mtime_virtual_us, __ATOMIC_ACQUIRE);
+
+	return mtime_real_us();
+}
+
+long long mtime_now_ms(void)
+{
+	return mtime_now_us() / 1000;
+}
+
+double mtime_now(void)
+{
+	return mtime_now_us() / 1e6;
+}
+
+long long mtime_update(void)
+{
+	long long now = mtime_now_us();
+
+	__atomic_store_n(&mtime_cached, now, __ATOMIC_RELEASE);
+	return now;
+}
+
+long long mtime_cached_us(void)
+{
+	return __atomic_load_n(&mtime_cached, __ATOMIC_ACQUIRE);
+}
+
+void mtime_sleep_us(long long us)
+{
+	if (us <= 0)
+		return;
+
+	if (mtime_is_virtual()) {
+		mtime_virtual_advance(us);
+		return;
+	}
+
+	usleep(us);
+}
+
+/*
+ * switch to the virtual clock, starting at start_us
+ */
+void mtime_virtual_start(long long start_us)
+{
+	__atomic_store_n(&mtime_virtual_us, start_us, __ATOMIC_RELEASE);
+	__atomic_store_n(&mtime_virtual, true, __ATOMIC_RELEASE);
+}
+
+void mtime_virtual_advance(long long us)
+{
+	__atomic_add_fetch(&mtime_virtual_us, us, __ATOMIC_ACQ_REL);
+}
+
+void mtime_virtual_stop(void)
+{
+	__atomic_store_n(&mtime_virtual, false, __ATOMIC_RELEASE);
+}
+
+bool mtime_is_virtual(void)
+{
+	return __atomic_load_n(&mtime_virtual, __ATOMIC_ACQUIRE);
+}
+
+
+#define MTIME_TEST_CALLS		(1000000)
+#define MTIME_TEST_TIMEOUT_MS	(5000)
+
+/*
+ * cost of reading the clock, and a long UART timeout on the virtual clock
+ */
+int  mtime_test_main(void)
+{
+	uart_port_h port = NULL;
+	long long start, prev, now, sum = 0;
+	long long real_start, virt_start;
+	double elapsed;
+	uint8_t ch;
+	int i, peer, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	prev = start = mtime_real_us();
+	for (i = 0; i < MTIME_TEST_CALLS; i++) {
+		now = mtime_now_us();
+		if (now < prev)
+			ret = -1;
+		prev = now;
+	}
+	elapsed = mtime_real_us() - start;
+	LOGI("mtime_now_us : [%.1f] ns/call, monotonic [%s]", elapsed * 1e3 / MTIME_TEST_CALLS, ret ? "no" : "yes");
+
+	mtime_update();
+	start = mtime_real_us();
+	for (i = 0; i < MTIME_TEST_CALLS; i++)
+		sum += mtime_cached_us();
+	elapsed = mtime_real_us() - start;
+	LOGI("mtime_cached_us : [%.1f] ns/call", elapsed * 1e3 / MTIME_TEST_CALLS);
+	if (sum != mtime_cached_us() * MTIME_TEST_CALLS)
+		ret = -1;
+
+	/* nobody writes on the pty, the read has to run into its timeout */
+	if (uart_port_open_pty(PERIPHERAL_UART_BAUD_RATE_9600, &port, &peer) == false) {
+		LOGI("%s error exiting...\n", __func__);
+		return -1;
+	}
+
+	real_start = mtime_real_us();
+	mtime_virtual_start(0);
+	virt_start = mtime_now_us();
+	i = uart_port_read_timeout(port, &ch, 1, MTIME_TEST_TIMEOUT_MS);
+	now = mtime_now_us();
+	mtime_virtual_stop();
+	LOGI("virtual clock : [%d] ms timeout, ret [%d], [%lld] ms virtual in [%lld] ms real", MTIME_TEST_TIMEOUT_MS, i,
+			(now - virt_start) / 1000, (mtime_real_us() - real_start) / 1000);
+	if (i != 0 || now - virt_start < MTIME_TEST_TIMEOUT_MS * 1000LL)
+		ret = -1;
+
+	uart_port_close(port);
+	close(peer);
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Serial device I/O driven by the Ecore main loop.
+ *        tty ports are watched with an fd handler, so the service only
+ *        wakes up when bytes arrive or the tx queue can drain.
+ *        peripheral-io does not expose its fd, those ports are polled
+ *        with a timer every REACTOR_POLL_INTERVAL.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <peripheral_io.h>
+#include <unistd.h>
+#include <Ecore.h>
+#include "hello.h"
+
+#include "reactor.h"
+
+#define REACTOR_RX_CHUNK			(256)
+
+struct _reactor_source_s {
+	uart_port_h port;
+	Ecore_Fd_Handler *fd_handler;
+	Ecore_Timer *poll_timer;
+	reactor_read_cb read_cb;
+	void *user_data;
+	uint8_t tx_buf[REACTOR_TX_BUF_SIZE];	/* bytes the port did not take yet */
+	uint32_t tx_len;
+	bool in_dispatch;
+	bool removed;							/* reactor_remove called from read_cb */
+};
+
+/*
+ * push queued bytes, stop watching for writable once empty
+ */
+static void reactor_drain_tx(reactor_source_h source)
+{
+	int n;
+
+	while (source->tx_len > 0) {
+		n = uart_port_write_some(source->port, source->tx_buf, source->tx_len);
+		if (n < 0) {
+			LOGE("tx failed, drop [%u] bytes", source->tx_len);
+			source->tx_len = 0;
+			break;
+		}
+		if (n == 0)
+			break;
+		memmove(source->tx_buf, source->tx_buf + n, source->tx_len - n);
+		source->tx_len -= n;
+	}
+
+	if (source->fd_handler != NULL) {
+		if (source->tx_len > 0)
+			ecore_main_fd_handler_active_set(source->fd_handler, ECORE_FD_READ | ECORE_FD_WRITE | ECORE_FD_ERROR);
+		else
+			ecore_main_fd_handler_active_set(source->fd_handler, ECORE_FD_READ | ECORE_FD_ERROR);
+	}
+}
+
+/*
+ * hand everything readable to the device parser
+ */
+static void reactor_drain_rx(reactor_source_h source)
+{
+	uint8_t buf[REACTOR_RX_CHUNK];
+	int n;
+
+	while ((n = uart_port_read(source->port, buf, sizeof(buf))) > 0) {
+		source->read_cb(source, buf, n, source->user_data);
+		if (source->removed)
+			return;
+	}
+
+	if (n < 0)
+		LOGE("rx failed, ret [%d]", n);
+}
+
+/*
+ * free a source removed from inside its own callback
+ */
+static void reactor_dispatch_end(reactor_source_h source)
+{
+	source->in_dispatch = false;
+	if (source->removed)
+		free(source);
+}
+
+static Eina_Bool reactor_fd_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	reactor_source_h source = data;
+
+	source->in_dispatch = true;
+
+	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_ERROR))
+		LOGE("fd error on port");
+
+	if (ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_READ))
+		reactor_drain_rx(source);
+
+	if (!source->removed && ecore_main_fd_handler_active_get(fd_handler, ECORE_FD_WRITE))
+		reactor_drain_tx(source);
+
+	reactor_dispatch_end(source);
+	return ECORE_CALLBACK_RENEW;
+}
+
+/*
+ * read ahead data is invisible to select, EINA_TRUE makes Ecore skip the
+ * wait and call reactor_fd_cb as readable, which drains it
+ */
+static Eina_Bool reactor_prep_cb(void *data, Ecore_Fd_Handler *fd_handler)
+{
+	reactor_source_h source = data;
+
+	return uart_port_rx_buffered(source->port);
+}
+
+static Eina_Bool reactor_poll_cb(void *data)
+{
+	reactor_source_h source = data;
+
+	source->in_dispatch = true;
+	reactor_drain_rx(source);
+	if (!source->removed && source->tx_len > 0)
+		reactor_drain_tx(source);
+	reactor_dispatch_end(source);
+
+	return ECORE_CALLBACK_RENEW;
+}
+
+/*
+ * deliver bytes received on port to read_cb from the main loop
+ */
+bool reactor_add_port(uart_port_h port, reactor_read_cb read_cb, void *user_data, reactor_source_h *source)
+{
+	reactor_source_h s;
+	int fd;
+
+	if (port == NULL || read_cb == NULL || source == NULL)
+		return false;
+
+	s = calloc(1, sizeof(*s));
+	if (s == NULL) {
+		LOGE("out of memory");
+		return false;
+	}
+
+	s->port = port;
+	s->read_cb = read_cb;
+	s->user_data = user_data;
+
+	fd = uart_port_get_fd(port);
+	if (fd >= 0) {
+		s->fd_handler = ecore_main_fd_handler_add(fd, ECORE_FD_READ | ECORE_FD_ERROR, reactor_fd_cb, s, reactor_prep_cb, s);
+		if (s->fd_handler == NULL) {
+			LOGE("ecore_main_fd_handler_add failed, fd [%d]", fd);
+			free(s);
+			return false;
+		}
+	} else {
+		s->poll_timer = ecore_timer_add(REACTOR_POLL_INTERVAL, reactor_poll_cb, s);
+		if (s->poll_timer == NULL) {
+			LOGE("ecore_timer_add failed");
+			free(s);
+			return false;
+		}
+	}
+
+	*source = s;
+	return true;
+}
+
+/*
+ * stop watching the port, queued tx bytes are dropped
+ * the port itself stays open, safe to call from read_cb
+ */
+void reactor_remove(reactor_source_h source)
+{
+	if (source == NULL || source->removed)
+		return;
+
+	if (source->fd_handler != NULL)
+		ecore_main_fd_handler_del(source->fd_handler);
+	if (source->poll_timer != NULL)
+		ecore_timer_del(source->poll_timer);
+
+	source->removed = true;
+	if (!source->in_dispatch)
+		free(source);
+}
+
+/*
+ * queue bytes for the port, written as far as possible right away
+ * all or nothing : return false without sending any byte if they do not
+ * fit the tx queue
+ */
+bool reactor_write(reactor_source_h source, const uint8_t *data, uint32_t length)
+{
+	int n = 0;
+
+	if (source == NULL || source->removed)
+		return false;
+
+	if (length > sizeof(source->tx_buf) - source->tx_len) {
+		LOGE("tx queue full, [%u] bytes pending", source->tx_len);
+		return false;
+	}
+
+	if (source->tx_len == 0) {
+		n = uart_port_write_some(source->port, data, length);
+		if (n < 0)
+			return false;
+		data += n;
+		length -= n;
+	}
+
+	if (length == 0)
+		return true;
+
+	memcpy(source->tx_buf + source->tx_len, data, length);
+	source->tx_len += length;
+	reactor_drain_tx(source);
+
+	return true;
+}
+
+uint32_t reactor_tx_pending(reactor_source_h source)
+{
+	if (source == NULL)
+		return 0;
+
+	return source->tx_len;
+}
+
+uart_port_h reactor_get_port(reactor_source_h source)
+{
+	if (source == NULL)
+		return NULL;
+
+	return source->port;
+}
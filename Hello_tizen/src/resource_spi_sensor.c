@@ -13,9 +13,12 @@
 #include <peripheral_io.h>
 #include <app_common.h>
 #include <math.h>
+#include <time.h>
+#include <Ecore.h>
 #include "hello_tizen.h"
 #include "mpu9250.h"
 #include "hello.h"
+#include "mtime.h"
 
 #define MODEL_NAME_KEY "http://tizen.org/system/model_name"
 #define MODEL_NAME_RPI3 "rpi3"
@@ -29,6 +32,7 @@ static unsigned int ref_count = 0;
 /* for MPU9250 SPI */
 #define	MPU9250_SPEED 1000000	// MAX 1MHz
 #define MPU9250_BPW 16
+#define MPU9250_BURST_MAX MPU9250_FIFO_SIZE	/* data bytes per burst read */
 
 #define retv_if(expr, val) do { \
 	if (expr) { \
@@ -41,14 +45,42 @@ static unsigned int ref_count = 0;
 static uint8_t magnetometer_calib[3];
 static float gyro_div;
 static float accel_div;
+static MPU9250_scale scale;     /* per LSB, set once at configuration */
+static int16_t accel_trim[3];   /* factory XA/YA/ZA_OFFSET, read after reset */
+
+/* magnetometer hard & soft iron, applied on the host */
+static struct {
+    bool valid;
+    float offset[3];
+    float matrix[3][3];
+} mag_corr;
 
 typedef enum {
     MPU9250_STAT_NONE = 0,
     MPU9250_STAT_IDLE,
     MPU9250_STAT_MAESUREING,
+    MPU9250_STAT_WOM,
 } MPU9250_STAT;
 
 static MPU9250_STAT stat = MPU9250_STAT_NONE;
+static MPU9250_BIT_DLPF_CFG dlpf;
+static MPU9250_spi_stats spi_stats;
+
+/* FIFO streaming */
+typedef struct {
+    bool running;
+    int frame_len;
+    int off_accel;          /* offsets in a frame, -1 : not in the FIFO */
+    int off_temp;
+    int off_gyro[3];
+    long long period_us;
+    long long next_us;      /* timestamp of the next frame, 0 : unknown */
+    uint8_t partial[MPU9250_SAMPLE_LEN];    /* bytes of a frame not read in full */
+    int partial_len;
+    MPU9250_fifo_stats stats;
+} MPU9250_fifo;
+
+static MPU9250_fifo fifo;
 
 #define PI (3.1415926535)
 
@@ -162,27 +194,135 @@ static int resource_mpu9250_read_byte(uint8_t addr, uint8_t *val)
 	tx[1] = addr;	/* build send frame. */
 
 	peripheral_spi_transfer(MPU9250_H, tx, rx, 2);
+	spi_stats.transfers++;
+	spi_stats.bytes += 2;
 
 	*val = rx[0] & 0xFF;
 
 	return 0;
 }
 
-static int resource_mpu9250_write_byte(uint8_t addr, uint8_t *val)
+static int resource_mpu9250_write_byte(uint8_t addr, uint8_t val)
 {
 	unsigned char rx[2] = {0,};
 	unsigned char tx[2] = {0,};
 
 	retv_if(MPU9250_H==NULL, -1);
-//	retv_if(val==NULL, -1);
 
 	tx[1] = addr;
 	tx[0] = val; 	/* build send frame. */
 
 	peripheral_spi_transfer(MPU9250_H, tx, rx, 2);
+	spi_stats.transfers++;
+	spi_stats.bytes += 2;
 
 	return 0;
 }
+
+/*
+ * Read len registers from addr on in one transfer, the chip auto-increments.
+ * Words are 16 bit and go out MSB first, so the bytes of each word are
+ * swapped in the buffers : the address is tx[1], byte n on the wire is
+ * rx[n ^ 1]. An even len is padded with one byte, which reads the next
+ * register; FIFO_R_W does not increment and would lose a byte to it.
+ */
+int resource_mpu9250_read_burst(uint8_t addr, uint8_t *vals, int len)
+{
+	unsigned char rx[MPU9250_BURST_MAX + 2] = {0,};
+	unsigned char tx[MPU9250_BURST_MAX + 2] = {0,};
+	int size = (len + 2) & ~1;
+	int ret;
+
+	retv_if(MPU9250_H==NULL, -1);
+	retv_if(vals==NULL, -1);
+	retv_if(len<=0 || len>MPU9250_BURST_MAX, -1);
+	retv_if(addr==MPU9250_REG_FIFO_R_W && (len & 1)==0, -1);
+
+	tx[1] = addr | 0x80;	/* read flag */
+
+	ret = peripheral_spi_transfer(MPU9250_H, tx, rx, size);
+	spi_stats.transfers++;
+	spi_stats.bytes += size;
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("peripheral_spi_transfer failed :%s ", get_error_message(ret));
+		return -1;
+	}
+
+	for (int i = 0; i < len; i++)
+		vals[i] = rx[(i + 1) ^ 1];
+
+	return 0;
+}
+
+/*
+ * Physical units per LSB for the current configuration,
+ * for batch conversion of raw samples.
+ */
+void resource_mpu9250_get_scale(MPU9250_scale *out)
+{
+	if (out != NULL)
+		*out = scale;
+}
+
+/*
+ * Have the chip remove gyro bias (digree/s) & accel offset (G) from its
+ * outputs, NULL for none. The FIFO and every read see corrected values.
+ * A reset (resource_mpu9250_dev_init) clears them.
+ */
+bool resource_mpu9250_set_offsets(const float gyro_bias[3], const float accel_offset[3])
+{
+    static const uint8_t gyro_reg[3] = { MPU9250_REG_XG_OFFSET_HL, MPU9250_REG_YG_OFFSET_HL, MPU9250_REG_ZG_OFFSET_HL };
+    static const uint8_t accel_reg[3] = { MPU9250_REG_XA_OFFSET_HL, MPU9250_REG_YA_OFFSET_HL, MPU9250_REG_ZA_OFFSET_HL };
+    long v;
+
+    if (stat == MPU9250_STAT_NONE) {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        v = gyro_bias ? -lroundf(gyro_bias[i] * MPU9250_GYRO_OFFSET_LSB) : 0;
+        v = v < INT16_MIN ? INT16_MIN : v > INT16_MAX ? INT16_MAX : v;
+        resource_mpu9250_write_byte(gyro_reg[i], (uint8_t)((uint16_t)v >> 8));
+        resource_mpu9250_write_byte(gyro_reg[i] + 1, (uint8_t)v);
+
+        v = accel_trim[i] >> 1;
+        if (accel_offset) {
+            v -= lroundf(accel_offset[i] * MPU9250_ACCEL_OFFSET_LSB);
+        }
+        v = v < -16384 ? -16384 : v > 16383 ? 16383 : v;
+        v = (v << 1) | (accel_trim[i] & 1);
+        resource_mpu9250_write_byte(accel_reg[i], (uint8_t)((uint16_t)v >> 8));
+        resource_mpu9250_write_byte(accel_reg[i] + 1, (uint8_t)v);
+    }
+
+    return true;
+}
+
+/*
+ * Magnetometer values become matrix * (m - offset), NULL offset clears it.
+ */
+void resource_mpu9250_set_mag_correction(const float offset[3], const float matrix[3][3])
+{
+    if (offset == NULL || matrix == NULL) {
+        mag_corr.valid = false;
+        return;
+    }
+
+    memcpy(mag_corr.offset, offset, sizeof(mag_corr.offset));
+    memcpy(mag_corr.matrix, matrix, sizeof(mag_corr.matrix));
+    mag_corr.valid = true;
+}
+
+void resource_mpu9250_get_spi_stats(MPU9250_spi_stats *stats)
+{
+	if (stats != NULL)
+		*stats = spi_stats;
+}
+
+void resource_mpu9250_reset_spi_stats(void)
+{
+	memset(&spi_stats, 0x0, sizeof(spi_stats));
+}
 /*
  * Initialize MPU9250 9axis sensor.
  * see: MPU-9250 Product Specification 7.5 SPI interface.
@@ -229,6 +369,15 @@ bool resource_mpu9250_dev_init(void)
 	        usleep(1000);
 	}
 
+	/* factory accel trims, resource_mpu9250_set_offsets adds to them */
+	uint8_t trim[MPU9250_REG_ZA_OFFSET_HL + 2 - MPU9250_REG_XA_OFFSET_HL];
+	if (resource_mpu9250_read_burst(MPU9250_REG_XA_OFFSET_HL, trim, sizeof(trim)) < 0) {
+	        return false;
+	}
+	accel_trim[0] = (int16_t)(((uint16_t)trim[0] << 8) | trim[1]);
+	accel_trim[1] = (int16_t)(((uint16_t)trim[3] << 8) | trim[4]);
+	accel_trim[2] = (int16_t)(((uint16_t)trim[6] << 8) | trim[7]);
+
 	/* AK8963(MPU9250 built in.) */
 	/* Reset */
 	resource_mpu9250_write_byte(MPU9250_REG_I2C_SLV0_ADDR, AK8963_I2C_ADDR);
@@ -244,6 +393,8 @@ bool resource_mpu9250_dev_init(void)
 	usleep(10000);  /* 10ms */
 	for (int i = 0; i < sizeof(magnetometer_calib); i++) {
 	        resource_mpu9250_read_byte(MPU9250_REG_EXT_SENS_DATA_00 + i, &magnetometer_calib[i]);
+	        /* sensitivity adjustment, ASA is unsigned */
+	        scale.mag[i] = (((float)magnetometer_calib[i] - 128) / 256) + 1;
 	}
 
 	/* 16bit periodical mode. (8Hz) */
@@ -334,6 +485,10 @@ bool resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL gyro_fs, MPU9250_BIT
         break;
     }
 
+    scale.gyro = 1.0f / gyro_div;
+    scale.accel = 1.0f / accel_div;
+
+    dlpf = dlpf_cfg;
     stat = MPU9250_STAT_MAESUREING; /* Update STATE. */
     return true;
 }
@@ -347,6 +502,8 @@ bool resource_mpu9250_stop_maesure(void)
         return false;
     }
 
+    resource_mpu9250_drdy_stop();
+    resource_mpu9250_fifo_stop();
     resource_mpu9250_write_byte(MPU9250_REG_PWR_MGMT_2, 0x3f);   /* Disable Accel & Gyro */
     usleep(1000);
 
@@ -354,6 +511,45 @@ bool resource_mpu9250_stop_maesure(void)
     return true;
 }
 
+static void mpu9250_decode_gyro(const uint8_t *vals, MPU9250_gyro_val *gyro_val)
+{
+    gyro_val->raw_x = ((uint16_t)vals[0] << 8) | vals[1];
+    gyro_val->raw_y = ((uint16_t)vals[2] << 8) | vals[3];
+    gyro_val->raw_z = ((uint16_t)vals[4] << 8) | vals[5];
+
+    gyro_val->x = (float)(int16_t)gyro_val->raw_x * scale.gyro;
+    gyro_val->y = (float)(int16_t)gyro_val->raw_y * scale.gyro;
+    gyro_val->z = (float)(int16_t)gyro_val->raw_z * scale.gyro;
+}
+
+static void mpu9250_decode_accel(const uint8_t *vals, MPU9250_accel_val *accel_val)
+{
+    accel_val->raw_x = ((uint16_t)vals[0] << 8) | vals[1];
+    accel_val->raw_y = ((uint16_t)vals[2] << 8) | vals[3];
+    accel_val->raw_z = ((uint16_t)vals[4] << 8) | vals[5];
+
+    accel_val->x = (float)(int16_t)accel_val->raw_x * scale.accel;
+    accel_val->y = (float)(int16_t)accel_val->raw_y * scale.accel;
+    accel_val->z = (float)(int16_t)accel_val->raw_z * scale.accel;
+}
+
+static float mpu9250_temperature_convert(uint16_t raw)
+{
+    float ft = (float)(int16_t)raw;
+
+    return ((ft - 21) / 333.87) + 21;
+}
+
+/* vals : MPU9250_SAMPLE_LEN bytes from ACCEL_XOUT_H on */
+static void mpu9250_decode_sample(const uint8_t *vals, MPU9250_sample *sample)
+{
+    mpu9250_decode_accel(&vals[MPU9250_REG_ACCEL_XOUT_HL - MPU9250_REG_ACCEL_XOUT_HL], &sample->accel);
+    sample->temperature.raw = ((uint16_t)vals[MPU9250_REG_TEMP_HL - MPU9250_REG_ACCEL_XOUT_HL] << 8)
+            | vals[MPU9250_REG_TEMP_HL - MPU9250_REG_ACCEL_XOUT_HL + 1];
+    sample->temp = mpu9250_temperature_convert(sample->temperature.raw);
+    mpu9250_decode_gyro(&vals[MPU9250_REG_GYRO_XOUT_HL - MPU9250_REG_ACCEL_XOUT_HL], &sample->gyro);
+}
+
 /*
  * Read Gyro.
  */
@@ -369,17 +565,11 @@ bool resource_mpu9250_read_gyro(MPU9250_gyro_val *gyro_val)
         return false;
     }
 
-    for (int i = 0; i < sizeof(vals); i++) {
-        resource_mpu9250_read_byte(MPU9250_REG_GYRO_XOUT_HL + i, &vals[i]);
+    if (resource_mpu9250_read_burst(MPU9250_REG_GYRO_XOUT_HL, vals, sizeof(vals)) < 0) {
+        return false;
     }
 
-    gyro_val->raw_x = ((uint16_t)vals[0] << 8) | vals[1];
-    gyro_val->raw_y = ((uint16_t)vals[2] << 8) | vals[3];
-    gyro_val->raw_z = ((uint16_t)vals[4] << 8) | vals[5];
-
-    gyro_val->x = (float)(int16_t)gyro_val->raw_x / gyro_div;
-    gyro_val->y = (float)(int16_t)gyro_val->raw_y / gyro_div;
-    gyro_val->z = (float)(int16_t)gyro_val->raw_z / gyro_div;
+    mpu9250_decode_gyro(vals, gyro_val);
 
     return true;
 }
@@ -399,17 +589,11 @@ bool resource_mpu9250_read_accel(MPU9250_accel_val *accel_val)
         return false;
     }
 
-    for (int i = 0; i < 6; i++) {
-        resource_mpu9250_read_byte(MPU9250_REG_ACCEL_XOUT_HL + i, &vals[i]);
+    if (resource_mpu9250_read_burst(MPU9250_REG_ACCEL_XOUT_HL, vals, sizeof(vals)) < 0) {
+        return false;
     }
 
-    accel_val->raw_x = ((uint16_t)vals[0] << 8) | vals[1];
-    accel_val->raw_y = ((uint16_t)vals[2] << 8) | vals[3];
-    accel_val->raw_z = ((uint16_t)vals[4] << 8) | vals[5];
-
-    accel_val->x = (float)(int16_t)accel_val->raw_x / accel_div;
-    accel_val->y = (float)(int16_t)accel_val->raw_y / accel_div;
-    accel_val->z = (float)(int16_t)accel_val->raw_z / accel_div;
+    mpu9250_decode_accel(vals, accel_val);
 
     return true;
 }
@@ -429,14 +613,551 @@ bool resource_mpu9250_read_temperature(MPU9250_temperature_val *temperature_val)
         return false;
     }
 
-    resource_mpu9250_read_byte(MPU9250_REG_TEMP_HL, &val[0]);
-    resource_mpu9250_read_byte(MPU9250_REG_TEMP_HL + 1, &val[1]);
+    if (resource_mpu9250_read_burst(MPU9250_REG_TEMP_HL, val, sizeof(val)) < 0) {
+        return false;
+    }
 
     temperature_val->raw = ((uint16_t)val[0] << 8) | val[1];
 
     return true;
 }
 
+/*
+ * Read Accel, chip temperature & Gyro in one SPI transfer.
+ * The registers come from the same sampling instant.
+ */
+bool resource_mpu9250_read_sample(MPU9250_sample *sample)
+{
+    uint8_t vals[MPU9250_SAMPLE_LEN];
+
+    if (stat != MPU9250_STAT_MAESUREING) {
+        return false;
+    }
+
+    if (sample == NULL) {
+        return false;
+    }
+
+    sample->timestamp_us = mtime_now_us();
+    if (resource_mpu9250_read_burst(MPU9250_REG_ACCEL_XOUT_HL, vals, sizeof(vals)) < 0) {
+        return false;
+    }
+
+    mpu9250_decode_sample(vals, sample);
+
+    return true;
+}
+
+/*
+ * Internal sample period for SMPLRT_DIV, which only works with
+ * DLPF_CFG 1 ~ 6 (1kHz internal rate).
+ */
+static long long mpu9250_sample_period_us(uint8_t smplrt_div)
+{
+    if (dlpf < MPU9250_BIT_DLPF_CFG_184HZ || dlpf > MPU9250_BIT_DLPF_CFG_5HZ) {
+        LOGE("sample rate divider needs DLPF_CFG 1 ~ 6, got %d", dlpf);
+        return -1;
+    }
+
+    return 1000LL * (1 + smplrt_div);
+}
+
+/*
+ * FIFO streaming.
+ * The chip writes one frame per sample period, the enabled sensors in
+ * register order. Frames are drained in bulk and get timestamps rebuilt
+ * from the sample period, anchored on the time FIFO_COUNT was read.
+ */
+static void mpu9250_fifo_reset(void)
+{
+    resource_mpu9250_write_byte(MPU9250_REG_USER_CTRL, MPU9250_BIT_USER_CTRL_I2C_MST_EN | MPU9250_BIT_USER_CTRL_FIFO_RST);
+    resource_mpu9250_write_byte(MPU9250_REG_USER_CTRL, MPU9250_BIT_USER_CTRL_I2C_MST_EN | MPU9250_BIT_USER_CTRL_FIFO_EN);
+    fifo.next_us = 0;
+    fifo.partial_len = 0;
+}
+
+static int mpu9250_fifo_layout(uint8_t fifo_en, uint8_t bit, int len, int *off)
+{
+    *off = (fifo_en & bit) ? fifo.frame_len : -1;
+    if (*off >= 0)
+        fifo.frame_len += len;
+    return *off;
+}
+
+/*
+ * Stream the sensors in fifo_en (MPU9250_BIT_FIFO_EN) through the FIFO
+ * at 1kHz / (1 + smplrt_div). Needs DLPF_CFG 1 ~ 6, SMPLRT_DIV has no
+ * effect otherwise.
+ */
+bool resource_mpu9250_fifo_start(uint8_t fifo_en, uint8_t smplrt_div)
+{
+    if (stat != MPU9250_STAT_MAESUREING || fifo.running) {
+        return false;
+    }
+
+    fifo_en &= MPU9250_BIT_FIFO_EN_MASK;
+    if (fifo_en == 0) {
+        return false;
+    }
+    if (mpu9250_sample_period_us(smplrt_div) < 0) {
+        return false;
+    }
+
+    memset(&fifo, 0x0, sizeof(fifo));
+    mpu9250_fifo_layout(fifo_en, MPU9250_BIT_FIFO_EN_ACCEL, 6, &fifo.off_accel);
+    mpu9250_fifo_layout(fifo_en, MPU9250_BIT_FIFO_EN_TEMP, 2, &fifo.off_temp);
+    mpu9250_fifo_layout(fifo_en, MPU9250_BIT_FIFO_EN_GYRO_X, 2, &fifo.off_gyro[0]);
+    mpu9250_fifo_layout(fifo_en, MPU9250_BIT_FIFO_EN_GYRO_Y, 2, &fifo.off_gyro[1]);
+    mpu9250_fifo_layout(fifo_en, MPU9250_BIT_FIFO_EN_GYRO_Z, 2, &fifo.off_gyro[2]);
+    fifo.period_us = mpu9250_sample_period_us(smplrt_div);
+
+    resource_mpu9250_write_byte(MPU9250_REG_SMPLRT_DIV, smplrt_div);
+    resource_mpu9250_write_byte(MPU9250_REG_FIFO_EN, fifo_en);
+    mpu9250_fifo_reset();
+
+    fifo.running = true;
+    return true;
+}
+
+bool resource_mpu9250_fifo_stop(void)
+{
+    if (!fifo.running) {
+        return false;
+    }
+
+    resource_mpu9250_write_byte(MPU9250_REG_FIFO_EN, 0x00);
+    resource_mpu9250_write_byte(MPU9250_REG_USER_CTRL, MPU9250_BIT_USER_CTRL_I2C_MST_EN);
+
+    fifo.running = false;
+    return true;
+}
+
+static void mpu9250_fifo_decode(const uint8_t *frame, MPU9250_sample *sample)
+{
+    uint8_t gyro[6] = {0,};
+    bool has_gyro = false;
+
+    memset(sample, 0x0, sizeof(*sample));
+
+    if (fifo.off_accel >= 0) {
+        mpu9250_decode_accel(&frame[fifo.off_accel], &sample->accel);
+    }
+    if (fifo.off_temp >= 0) {
+        sample->temperature.raw = ((uint16_t)frame[fifo.off_temp] << 8) | frame[fifo.off_temp + 1];
+        sample->temp = mpu9250_temperature_convert(sample->temperature.raw);
+    }
+    for (int i = 0; i < 3; i++) {
+        if (fifo.off_gyro[i] >= 0) {
+            gyro[i * 2] = frame[fifo.off_gyro[i]];
+            gyro[i * 2 + 1] = frame[fifo.off_gyro[i] + 1];
+            has_gyro = true;
+        }
+    }
+    if (has_gyro) {
+        mpu9250_decode_gyro(gyro, &sample->gyro);
+    }
+}
+
+/*
+ * Drain up to max whole frames, oldest first.
+ * Every byte clocked out of FIFO_R_W is popped, padding included, so
+ * FIFO reads keep an odd length and frames may end up split across
+ * two reads : the bytes of an incomplete frame wait in fifo.partial.
+ * A full FIFO has overwritten bytes of its oldest frame, so frame
+ * boundaries are lost : it is reset and the timestamps start over.
+ * @retval  number of samples, 0 when empty or resynced, -1 on error
+ */
+int resource_mpu9250_fifo_read(MPU9250_sample *samples, int max)
+{
+    uint8_t buf[MPU9250_SAMPLE_LEN + MPU9250_BURST_MAX];
+    uint8_t cnt[3];
+    long long now, first;
+    int count, total, n, want, len, off, done = 0;
+
+    if (!fifo.running || samples == NULL || max <= 0) {
+        return -1;
+    }
+
+    /*
+     * DMP_CFG_2, FIFO_COUNT_H & FIFO_COUNT_L : an odd length needs no padding
+     * byte, which would pop FIFO_R_W, and a frame landing meanwhile would lose
+     * its first byte
+     */
+    if (resource_mpu9250_read_burst(MPU9250_REG_FIFO_COUNT_HL - 1, cnt, sizeof(cnt)) < 0) {
+        return -1;
+    }
+    now = mtime_now_us();
+    count = ((cnt[1] & 0x1F) << 8) | cnt[2];
+
+    if (count + fifo.frame_len > MPU9250_FIFO_SIZE) {
+        fifo.stats.overflows++;
+        fifo.stats.frames_lost += count / fifo.frame_len;
+        mpu9250_fifo_reset();
+        return 0;
+    }
+    total = (fifo.partial_len + count) / fifo.frame_len;
+    if (total == 0) {
+        return 0;
+    }
+    n = total < max ? total : max;
+
+    /* the newest frame is half a period old on average */
+    first = now - fifo.period_us / 2 - (total - 1) * fifo.period_us;
+    if (fifo.next_us == 0 || llabs(first - fifo.next_us) > 4 * fifo.period_us) {
+        fifo.next_us = first;
+    } else {
+        fifo.next_us += (first - fifo.next_us) / 16;    /* follow the chip's clock */
+    }
+
+    while (done < n) {
+        want = (n - done) * fifo.frame_len - fifo.partial_len;
+        if (want > MPU9250_BURST_MAX - 1) {
+            want = MPU9250_BURST_MAX - 1;
+        }
+        if (want > 0 && (want & 1) == 0) {
+            want += want < count ? 1 : -1;
+        }
+
+        memcpy(buf, fifo.partial, fifo.partial_len);
+        if (want > 0 && resource_mpu9250_read_burst(MPU9250_REG_FIFO_R_W, &buf[fifo.partial_len], want) < 0) {
+            mpu9250_fifo_reset();
+            break;
+        }
+        count -= want;
+        len = fifo.partial_len + want;
+
+        for (off = 0; done < n && off + fifo.frame_len <= len; off += fifo.frame_len, done++) {
+            mpu9250_fifo_decode(&buf[off], &samples[done]);
+            samples[done].timestamp_us = fifo.next_us;
+            fifo.next_us += fifo.period_us;
+        }
+        fifo.partial_len = len - off;
+        memcpy(fifo.partial, &buf[off], fifo.partial_len);
+    }
+
+    fifo.stats.reads++;
+    fifo.stats.frames += done;
+    return done > 0 ? done : -1;
+}
+
+void resource_mpu9250_fifo_get_stats(MPU9250_fifo_stats *stats)
+{
+    if (stats != NULL) {
+        *stats = fifo.stats;
+    }
+}
+
+/*
+ * Data ready interrupt.
+ * The chip pulses INT once per sample; the callback of the GPIO, run
+ * from the main loop, reads INT_STATUS and the sample in one burst.
+ * A pulse is used rather than a latched level: a latch that is never
+ * read would hold the line high and stop the edges for good.
+ */
+static struct {
+    peripheral_gpio_h gpio;
+    MPU9250_drdy_cb cb;
+    void *user_data;
+    long long period_us;
+    long long last_us;
+    MPU9250_drdy_stats stats;
+} drdy;
+
+static void mpu9250_drdy_interrupted_cb(peripheral_gpio_h gpio, peripheral_error_e error, void *user_data)
+{
+    uint8_t vals[1 + MPU9250_SAMPLE_LEN];
+    MPU9250_sample sample;
+    long long now = mtime_now_us();
+    unsigned int interval, latency;
+
+    drdy.stats.interrupts++;
+
+    if (drdy.last_us != 0) {
+        interval = now - drdy.last_us;
+        if (drdy.stats.interrupts == 2 || interval < drdy.stats.interval_min_us)
+            drdy.stats.interval_min_us = interval;
+        if (interval > drdy.stats.interval_max_us)
+            drdy.stats.interval_max_us = interval;
+        /* a callback up to 3/4 of a period late is jitter, not a lost edge */
+        if (interval >= drdy.period_us * 7 / 4)
+            drdy.stats.missed += (interval + drdy.period_us / 4) / drdy.period_us - 1;
+    }
+    drdy.last_us = now;
+
+    if (error != PERIPHERAL_ERROR_NONE || drdy.cb == NULL)
+        return;
+
+    /* INT_STATUS is right in front of ACCEL_XOUT_H */
+    if (resource_mpu9250_read_burst(MPU9250_REG_INT_STATUS, vals, sizeof(vals)) < 0)
+        return;
+    if ((vals[0] & MPU9250_BIT_INT_RAW_RDY) == 0) {
+        drdy.stats.spurious++;
+        return;
+    }
+
+    sample.timestamp_us = now;
+    mpu9250_decode_sample(&vals[1], &sample);
+
+    latency = mtime_now_us() - now;
+    if (drdy.stats.samples == 0 || latency < drdy.stats.latency_min_us)
+        drdy.stats.latency_min_us = latency;
+    if (latency > drdy.stats.latency_max_us)
+        drdy.stats.latency_max_us = latency;
+    drdy.stats.latency_sum_us += latency;
+    drdy.stats.samples++;
+
+    drdy.cb(&sample, drdy.user_data);
+}
+
+/*
+ * Call cb with every sample at 1kHz / (1 + smplrt_div), paced by the
+ * chip through its INT pin on gpio_pin. Needs the Ecore main loop.
+ */
+bool resource_mpu9250_drdy_start(int gpio_pin, uint8_t smplrt_div, MPU9250_drdy_cb cb, void *user_data)
+{
+    long long period_us;
+    int ret;
+
+    if (stat != MPU9250_STAT_MAESUREING || drdy.gpio != NULL || cb == NULL) {
+        return false;
+    }
+    if ((period_us = mpu9250_sample_period_us(smplrt_div)) < 0) {
+        return false;
+    }
+
+    ret = peripheral_gpio_open(gpio_pin, &drdy.gpio);
+    if (ret != PERIPHERAL_ERROR_NONE) {
+        LOGE("peripheral_gpio_open failed :%s ", get_error_message(ret));
+        drdy.gpio = NULL;
+        return false;
+    }
+    ret = peripheral_gpio_set_direction(drdy.gpio, PERIPHERAL_GPIO_DIRECTION_IN);
+    if (ret == PERIPHERAL_ERROR_NONE)
+        ret = peripheral_gpio_set_edge_mode(drdy.gpio, PERIPHERAL_GPIO_EDGE_RISING);
+    if (ret != PERIPHERAL_ERROR_NONE) {
+        LOGE("INT gpio setup failed :%s ", get_error_message(ret));
+        goto error;
+    }
+
+    memset(&drdy.stats, 0x0, sizeof(drdy.stats));
+    drdy.cb = cb;
+    drdy.user_data = user_data;
+    drdy.period_us = period_us;
+    drdy.last_us = 0;
+
+    ret = peripheral_gpio_set_interrupted_cb(drdy.gpio, mpu9250_drdy_interrupted_cb, NULL);
+    if (ret != PERIPHERAL_ERROR_NONE) {
+        LOGE("peripheral_gpio_set_interrupted_cb failed :%s ", get_error_message(ret));
+        goto error;
+    }
+
+    resource_mpu9250_write_byte(MPU9250_REG_SMPLRT_DIV, smplrt_div);
+    resource_mpu9250_write_byte(MPU9250_REG_INT_PIN_CFG, MPU9250_BIT_INT_PIN_CFG_INT_ANYRD_2CLEAR);
+    resource_mpu9250_write_byte(MPU9250_REG_INT_ENABLE, MPU9250_BIT_INT_RAW_RDY);
+
+    return true;
+
+error:
+    peripheral_gpio_close(drdy.gpio);
+    drdy.gpio = NULL;
+    return false;
+}
+
+bool resource_mpu9250_drdy_stop(void)
+{
+    if (drdy.gpio == NULL) {
+        return false;
+    }
+
+    resource_mpu9250_write_byte(MPU9250_REG_INT_ENABLE, 0x00);
+    resource_mpu9250_write_byte(MPU9250_REG_INT_PIN_CFG, MPU9250_BIT_INT_PIN_CFG_LATCH_INT_EN | MPU9250_BIT_INT_PIN_CFG_INT_ANYRD_2CLEAR);
+
+    peripheral_gpio_unset_interrupted_cb(drdy.gpio);
+    peripheral_gpio_close(drdy.gpio);
+    drdy.gpio = NULL;
+    drdy.cb = NULL;
+    return true;
+}
+
+void resource_mpu9250_drdy_get_stats(MPU9250_drdy_stats *stats)
+{
+    if (stats != NULL) {
+        *stats = drdy.stats;
+    }
+}
+
+/* wake-on-motion */
+static struct {
+    peripheral_gpio_h gpio;
+    MPU9250_wom_cb cb;
+    void *user_data;
+    long long holdoff_us;
+    long long event_us;     /* interrupt of the last event, 0 : none */
+    Ecore_Job *job;         /* delivers the event out of the gpio callback */
+    MPU9250_wom_stats stats;
+} wom;
+
+static void mpu9250_ak8963_write(uint8_t reg, uint8_t val)
+{
+    resource_mpu9250_write_byte(MPU9250_REG_I2C_SLV0_ADDR, AK8963_I2C_ADDR);
+    resource_mpu9250_write_byte(MPU9250_REG_I2C_SLV0_REG, reg);
+    resource_mpu9250_write_byte(MPU9250_REG_I2C_SLV0_DO, val);
+    resource_mpu9250_write_byte(MPU9250_REG_I2C_SLV0_CTRL, 0x81);
+    usleep(10000);  /* 10ms */
+}
+
+static void mpu9250_wom_job_cb(void *data)
+{
+    unsigned int latency = mtime_now_us() - wom.event_us;
+
+    wom.job = NULL;
+    if (latency > wom.stats.latency_max_us)
+        wom.stats.latency_max_us = latency;
+
+    wom.cb(wom.event_us, wom.user_data);
+}
+
+static void mpu9250_wom_interrupted_cb(peripheral_gpio_h gpio, peripheral_error_e error, void *user_data)
+{
+    long long now = mtime_now_us();
+    uint8_t status;
+
+    wom.stats.interrupts++;
+
+    if (error != PERIPHERAL_ERROR_NONE || wom.cb == NULL)
+        return;
+
+    if (resource_mpu9250_read_burst(MPU9250_REG_INT_STATUS, &status, 1) < 0)
+        return;
+    if ((status & MPU9250_BIT_INT_WOM) == 0) {
+        wom.stats.spurious++;
+        return;
+    }
+
+    /* the chip keeps interrupting while the motion lasts */
+    if (wom.job != NULL || (wom.event_us != 0 && now - wom.event_us < wom.holdoff_us)) {
+        wom.stats.suppressed++;
+        return;
+    }
+    wom.event_us = now;
+    wom.stats.events++;
+
+    /* cb may stop wake-on-motion & open the INT gpio for drdy */
+    wom.job = ecore_job_add(mpu9250_wom_job_cb, NULL);
+}
+
+/*
+ * Sleep until motion : gyro & magnetometer off, accel sampled at
+ * config->lp_odr in cycle mode, INT raised when an axis changes by more
+ * than config->threshold_mg between samples. cb runs from the main loop,
+ * outside the gpio callback, and may stop this to start measuring.
+ * From the idle state (dev_init or stop_maesure).
+ */
+bool resource_mpu9250_wom_start(int gpio_pin, const MPU9250_wom_config *config, MPU9250_wom_cb cb, void *user_data)
+{
+    unsigned int thr;
+    int ret;
+
+    if (stat != MPU9250_STAT_IDLE || wom.gpio != NULL || config == NULL || cb == NULL) {
+        return false;
+    }
+    if (config->lp_odr > MPU9250_BIT_LP_ACCEL_ODR_500HZ) {
+        return false;
+    }
+    thr = (config->threshold_mg + 2) / 4;
+    thr = thr < 1 ? 1 : thr > 0xff ? 0xff : thr;
+
+    ret = peripheral_gpio_open(gpio_pin, &wom.gpio);
+    if (ret != PERIPHERAL_ERROR_NONE) {
+        LOGE("peripheral_gpio_open failed :%s ", get_error_message(ret));
+        wom.gpio = NULL;
+        return false;
+    }
+    ret = peripheral_gpio_set_direction(wom.gpio, PERIPHERAL_GPIO_DIRECTION_IN);
+    if (ret == PERIPHERAL_ERROR_NONE)
+        ret = peripheral_gpio_set_edge_mode(wom.gpio, PERIPHERAL_GPIO_EDGE_RISING);
+    if (ret == PERIPHERAL_ERROR_NONE)
+        ret = peripheral_gpio_set_interrupted_cb(wom.gpio, mpu9250_wom_interrupted_cb, NULL);
+    if (ret != PERIPHERAL_ERROR_NONE) {
+        LOGE("INT gpio setup failed :%s ", get_error_message(ret));
+        peripheral_gpio_close(wom.gpio);
+        wom.gpio = NULL;
+        return false;
+    }
+
+    memset(&wom.stats, 0x0, sizeof(wom.stats));
+    wom.cb = cb;
+    wom.user_data = user_data;
+    wom.holdoff_us = config->holdoff_ms * 1000LL;
+    wom.event_us = 0;
+
+    /* see: MPU-9250 Product Specification 7.6, wake-on-motion interrupt */
+    mpu9250_ak8963_write(AK8963_REG_CNTL1, 0x00);   /* power down */
+
+    uint8_t wom_conf[][2] = {
+        {MPU9250_REG_PWR_MGMT_1,      MPU9250_BIT_PWR_MGMT_1_CLKSEL_AUTO},
+        {MPU9250_REG_PWR_MGMT_2,      0x07},                          /* accel on, gyro off */
+        {MPU9250_REG_ACCEL_CONFIG2,   0x08 | MPU9250_BIT_A_DLPFCFG_184HZ},
+        {MPU9250_REG_INT_PIN_CFG,     MPU9250_BIT_INT_PIN_CFG_INT_ANYRD_2CLEAR},
+        {MPU9250_REG_INT_ENABLE,      MPU9250_BIT_INT_WOM},
+        {MPU9250_REG_MOT_DETECT_CTRL, MPU9250_BIT_MOT_DETECT_CTRL_ACCEL_INTEL_EN | MPU9250_BIT_MOT_DETECT_CTRL_ACCEL_INTEL_MODE},
+        {MPU9250_REG_WOM_THR,         (uint8_t)thr},
+        {MPU9250_REG_LP_ACCEL_ODR,    config->lp_odr},
+        {MPU9250_REG_PWR_MGMT_1,      MPU9250_BIT_PWR_MGMT_1_CYCLE | MPU9250_BIT_PWR_MGMT_1_CLKSEL_AUTO},
+        {0xff,                        0xff}
+    };
+    for (int i = 0; wom_conf[i][0] != 0xff; i++) {
+        resource_mpu9250_write_byte(wom_conf[i][0], wom_conf[i][1]);
+        usleep(1000);
+    }
+
+    stat = MPU9250_STAT_WOM;   /* Update STATE. */
+    return true;
+}
+
+/*
+ * Back to the idle state, ready for start_maesure.
+ */
+bool resource_mpu9250_wom_stop(void)
+{
+    if (stat != MPU9250_STAT_WOM) {
+        return false;
+    }
+
+    uint8_t idle_conf[][2] = {
+        {MPU9250_REG_PWR_MGMT_1,      MPU9250_BIT_PWR_MGMT_1_CLKSEL_AUTO},   /* out of cycle mode */
+        {MPU9250_REG_INT_ENABLE,      0x00},
+        {MPU9250_REG_MOT_DETECT_CTRL, 0x00},
+        {MPU9250_REG_PWR_MGMT_2,      0x3f},                                 /* Disable Accel & Gyro */
+        {MPU9250_REG_INT_PIN_CFG,     MPU9250_BIT_INT_PIN_CFG_LATCH_INT_EN | MPU9250_BIT_INT_PIN_CFG_INT_ANYRD_2CLEAR},
+        {0xff,                        0xff}
+    };
+    for (int i = 0; idle_conf[i][0] != 0xff; i++) {
+        resource_mpu9250_write_byte(idle_conf[i][0], idle_conf[i][1]);
+        usleep(1000);
+    }
+    mpu9250_ak8963_write(AK8963_REG_CNTL1, 0x12);   /* 16bit periodical mode. (8Hz) */
+
+    if (wom.job != NULL) {
+        ecore_job_del(wom.job);
+        wom.job = NULL;
+    }
+    peripheral_gpio_unset_interrupted_cb(wom.gpio);
+    peripheral_gpio_close(wom.gpio);
+    wom.gpio = NULL;
+    wom.cb = NULL;
+
+    stat = MPU9250_STAT_IDLE;   /* Update STATE. */
+    return true;
+}
+
+void resource_mpu9250_wom_get_stats(MPU9250_wom_stats *stats)
+{
+    if (stats != NULL) {
+        *stats = wom.stats;
+    }
+}
+
 /*
  * Read Magnetometer.
  */
@@ -472,9 +1193,20 @@ bool resource_mpu9250_read_magnetometer(MPU9250_magnetometer_val *magnetometer_v
     magnetometer_val->raw_y = ((uint16_t)vals[4] << 8) | vals[3];
     magnetometer_val->raw_z = ((uint16_t)vals[6] << 8) | vals[5];
     /* Real data */
-    magnetometer_val->x = (int16_t)magnetometer_val->raw_x * ((((float)(int8_t)magnetometer_calib[0] - 128) / 256) + 1);
-    magnetometer_val->y = (int16_t)magnetometer_val->raw_y * ((((float)(int8_t)magnetometer_calib[1] - 128) / 256) + 1);
-    magnetometer_val->z = (int16_t)magnetometer_val->raw_z * ((((float)(int8_t)magnetometer_calib[2] - 128) / 256) + 1);
+    magnetometer_val->x = (int16_t)magnetometer_val->raw_x * scale.mag[0];
+    magnetometer_val->y = (int16_t)magnetometer_val->raw_y * scale.mag[1];
+    magnetometer_val->z = (int16_t)magnetometer_val->raw_z * scale.mag[2];
+
+    if (mag_corr.valid) {
+        float m[3] = {
+            magnetometer_val->x - mag_corr.offset[0],
+            magnetometer_val->y - mag_corr.offset[1],
+            magnetometer_val->z - mag_corr.offset[2],
+        };
+        magnetometer_val->x = mag_corr.matrix[0][0] * m[0] + mag_corr.matrix[0][1] * m[1] + mag_corr.matrix[0][2] * m[2];
+        magnetometer_val->y = mag_corr.matrix[1][0] * m[0] + mag_corr.matrix[1][1] * m[1] + mag_corr.matrix[1][2] * m[2];
+        magnetometer_val->z = mag_corr.matrix[2][0] * m[0] + mag_corr.matrix[2][1] * m[1] + mag_corr.matrix[2][2] * m[2];
+    }
 
     return true;
 }
@@ -563,7 +1295,6 @@ bool mpu9250_accel_read(uint16_t *rx, uint16_t *ry, uint16_t *rz, float *x, floa
  */
 bool mpu9250_temperature_read(uint16_t *rt, float *t)
 {
-    float ft;
     MPU9250_temperature_val temp;
     temp.raw = 0;
 
@@ -573,8 +1304,7 @@ bool mpu9250_temperature_read(uint16_t *rt, float *t)
         }
 
         if (t != NULL) {
-            ft = (float)(int16_t)temp.raw;
-            *t = ((ft - 21) / 333.87) + 21;
+            *t = mpu9250_temperature_convert(temp.raw);
         }
         return true;
     }
@@ -751,3 +1481,434 @@ error:
 	resource_mpu9250_spi_fini();
 	return -1;
 }
+
+
+#define SPI_BURST_TEST_SAMPLES	(2000)
+
+static void spi_burst_test_report(const char *name, long long elapsed_us)
+{
+	MPU9250_spi_stats stats;
+
+	resource_mpu9250_get_spi_stats(&stats);
+	LOGI("%-14s: [%u] transfers/sample, [%llu] bytes/sample, [%lld] us/sample, max [%lld] samples/s", name,
+			stats.transfers / SPI_BURST_TEST_SAMPLES, stats.bytes / SPI_BURST_TEST_SAMPLES,
+			elapsed_us / SPI_BURST_TEST_SAMPLES, elapsed_us > 0 ? SPI_BURST_TEST_SAMPLES * 1000000LL / elapsed_us : 0);
+}
+
+/*
+ * SPI transfers per accel/temp/gyro sample and the sample rate they allow:
+ * one register per transfer, one burst per sensor, one burst per sample
+ */
+int  spi_burst_test_main(void)
+{
+	MPU9250_sample sample;
+	MPU9250_accel_val accel;
+	MPU9250_gyro_val gyro;
+	MPU9250_temperature_val temp;
+	uint8_t vals[MPU9250_SAMPLE_LEN];
+	long long start;
+	int i, j, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (resource_mpu9250_spi_init() < 0 || resource_mpu9250_dev_init() == false) {
+		LOGI("%s MPU9250 init fail ...", __func__);
+		goto error;
+	}
+	if (resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL_2000DPS, MPU9250_BIT_ACCEL_FS_SEL_16G, MPU9250_BIT_DLPF_CFG_250HZ, MPU9250_BIT_A_DLPFCFG_460HZ) == false) {
+		LOGI("%s MPU9250 start measure fail ...", __func__);
+		goto error;
+	}
+
+	resource_mpu9250_reset_spi_stats();
+	start = mtime_now_us();
+	for (i = 0; i < SPI_BURST_TEST_SAMPLES; i++)
+		for (j = 0; j < MPU9250_SAMPLE_LEN; j++)
+			resource_mpu9250_read_byte(MPU9250_REG_ACCEL_XOUT_HL + j, &vals[j]);
+	spi_burst_test_report("per register", mtime_now_us() - start);
+
+	resource_mpu9250_reset_spi_stats();
+	start = mtime_now_us();
+	for (i = 0; i < SPI_BURST_TEST_SAMPLES; i++) {
+		if (!resource_mpu9250_read_accel(&accel) || !resource_mpu9250_read_temperature(&temp)
+				|| !resource_mpu9250_read_gyro(&gyro))
+			ret = -1;
+	}
+	spi_burst_test_report("per sensor", mtime_now_us() - start);
+
+	resource_mpu9250_reset_spi_stats();
+	start = mtime_now_us();
+	for (i = 0; i < SPI_BURST_TEST_SAMPLES; i++) {
+		if (!resource_mpu9250_read_sample(&sample))
+			ret = -1;
+	}
+	spi_burst_test_report("one burst", mtime_now_us() - start);
+
+	LOGI("last sample {ax:%0.2f,ay:%0.2f,az:%0.2f} {gx:%0.1f,gy:%0.1f,gz:%0.1f} {t:%0.1f}",
+			sample.accel.x, sample.accel.y, sample.accel.z, sample.gyro.x, sample.gyro.y, sample.gyro.z, sample.temp);
+
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+
+error:
+	LOGI("%s error exiting...\n", __func__);
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	return -1;
+}
+
+
+#define SPI_FIFO_TEST_SEC		(5)
+#define SPI_FIFO_TEST_WAKE_MS	(20)	/* accel & gyro at 1kHz fill the FIFO in 42ms */
+
+/*
+ * 1kHz accel & gyro capture through the FIFO, the host wakes every
+ * SPI_FIFO_TEST_WAKE_MS; then one late wake-up to show the resync
+ */
+int  spi_fifo_test_main(void)
+{
+	static MPU9250_sample samples[64];
+	MPU9250_fifo_stats stats;
+	MPU9250_spi_stats spi;
+	long long start, elapsed, last_us = 0, gap, gap_max = 0;
+	unsigned int wakeups = 0, total = 0, backwards = 0, overflows;
+	int i, n, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (resource_mpu9250_spi_init() < 0 || resource_mpu9250_dev_init() == false) {
+		LOGI("%s MPU9250 init fail ...", __func__);
+		goto error;
+	}
+	if (resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL_2000DPS, MPU9250_BIT_ACCEL_FS_SEL_16G, MPU9250_BIT_DLPF_CFG_184HZ, MPU9250_BIT_A_DLPFCFG_184HZ) == false
+			|| resource_mpu9250_fifo_start(MPU9250_BIT_FIFO_EN_ACCEL | MPU9250_BIT_FIFO_EN_GYRO, 0) == false) {
+		LOGI("%s MPU9250 start measure fail ...", __func__);
+		goto error;
+	}
+
+	resource_mpu9250_reset_spi_stats();
+	start = mtime_now_us();
+	while ((elapsed = mtime_now_us() - start) < SPI_FIFO_TEST_SEC * 1000000LL) {
+		usleep(SPI_FIFO_TEST_WAKE_MS * 1000);
+		wakeups++;
+		do {
+			n = resource_mpu9250_fifo_read(samples, sizeof(samples) / sizeof(samples[0]));
+			for (i = 0; i < n; i++) {
+				gap = samples[i].timestamp_us - last_us;
+				if (last_us != 0 && gap <= 0)
+					backwards++;
+				if (last_us != 0 && gap > gap_max)
+					gap_max = gap;
+				last_us = samples[i].timestamp_us;
+			}
+			total += n > 0 ? n : 0;
+		} while (n == sizeof(samples) / sizeof(samples[0]));
+	}
+	resource_mpu9250_get_spi_stats(&spi);
+	resource_mpu9250_fifo_get_stats(&stats);
+
+	LOGI("fifo : [%u] samples in [%lld] ms, [%lld] samples/s, [%lld] wake-ups/s, [%lld] transfers/s",
+			total, elapsed / 1000, total * 1000000LL / elapsed, wakeups * 1000000LL / elapsed, spi.transfers * 1000000LL / elapsed);
+	LOGI("fifo : timestamps max gap [%lld] us, [%u] not increasing, last one [%lld] us before now",
+			gap_max, backwards, mtime_now_us() - last_us);
+	LOGI("fifo : [%u] overflows, polling at 1kHz would take 1000 wake-ups/s", stats.overflows);
+	if (stats.overflows > 0 || backwards > 0 || total < SPI_FIFO_TEST_SEC * 1000 * 9 / 10)
+		ret = -1;
+
+	/* too late, the FIFO has overflowed */
+	overflows = stats.overflows;
+	usleep(100000);
+	resource_mpu9250_fifo_read(samples, sizeof(samples) / sizeof(samples[0]));
+	usleep(SPI_FIFO_TEST_WAKE_MS * 1000);
+	n = resource_mpu9250_fifo_read(samples, sizeof(samples) / sizeof(samples[0]));
+	resource_mpu9250_fifo_get_stats(&stats);
+	LOGI("late read : [%u] overflows, [%u] frames lost, [%d] samples after the resync", stats.overflows, stats.frames_lost, n);
+	if (stats.overflows != overflows + 1 || n <= 0)
+		ret = -1;
+
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+
+error:
+	LOGI("%s error exiting...\n", __func__);
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	return -1;
+}
+
+
+#define SPI_DRDY_TEST_SEC		(5)
+#define SPI_DRDY_TEST_DIV		(4)		/* 200Hz */
+
+static void spi_drdy_test_cb(const MPU9250_sample *sample, void *user_data)
+{
+	unsigned int *received = user_data;
+
+	(*received)++;
+}
+
+static Eina_Bool spi_drdy_test_done(void *data)
+{
+	ecore_main_loop_quit();
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static long long spi_drdy_test_cpu_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/*
+ * samples paced by the chip's data ready interrupt : rate, read latency,
+ * interrupt interval spread and the CPU time spent per sample
+ */
+int  spi_drdy_test_main(void)
+{
+	MPU9250_drdy_stats stats;
+	unsigned int received = 0;
+	long long start, cpu, elapsed;
+	int ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	if (resource_mpu9250_spi_init() < 0 || resource_mpu9250_dev_init() == false) {
+		LOGI("%s MPU9250 init fail ...", __func__);
+		goto error;
+	}
+	if (resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL_2000DPS, MPU9250_BIT_ACCEL_FS_SEL_16G, MPU9250_BIT_DLPF_CFG_92HZ, MPU9250_BIT_A_DLPFCFG_92HZ) == false
+			|| resource_mpu9250_drdy_start(MPU9250_INT_GPIO, SPI_DRDY_TEST_DIV, spi_drdy_test_cb, &received) == false) {
+		LOGI("%s MPU9250 start measure fail ...", __func__);
+		goto error;
+	}
+
+	start = mtime_now_us();
+	cpu = spi_drdy_test_cpu_us();
+	ecore_timer_add(SPI_DRDY_TEST_SEC, spi_drdy_test_done, NULL);
+	ecore_main_loop_begin();
+	cpu = spi_drdy_test_cpu_us() - cpu;
+	elapsed = mtime_now_us() - start;
+	resource_mpu9250_drdy_stop();
+
+	resource_mpu9250_drdy_get_stats(&stats);
+	LOGI("drdy : [%u] samples, [%lld] samples/s for [%d] expected", received,
+			received * 1000000LL / elapsed, 1000 / (1 + SPI_DRDY_TEST_DIV));
+	if (stats.samples > 0)
+		LOGI("drdy : read latency min [%u] us, avg [%llu] us, max [%u] us", stats.latency_min_us,
+				stats.latency_sum_us / stats.samples, stats.latency_max_us);
+	LOGI("drdy : interval min [%u] us, max [%u] us, [%u] missed, [%u] spurious",
+			stats.interval_min_us, stats.interval_max_us, stats.missed, stats.spurious);
+	if (received > 0)
+		LOGI("drdy : cpu [%lld] us/sample, [%lld.%lld] %% of a core", cpu / received, cpu * 100 / elapsed, cpu * 1000 / elapsed % 10);
+	if (received < SPI_DRDY_TEST_SEC * 1000 / (1 + SPI_DRDY_TEST_DIV) * 9 / 10)
+		ret = -1;
+
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+
+error:
+	LOGI("%s error exiting...\n", __func__);
+	resource_mpu9250_stop_maesure();
+	resource_mpu9250_spi_fini();
+	return -1;
+}
+
+
+#define SPI_WOM_TEST_EVENTS			(3)
+#define SPI_WOM_TEST_TIMEOUT_SEC	(60)
+#define SPI_WOM_TEST_CAPTURE_SEC	(1)
+#define SPI_WOM_TEST_DIV			(4)		/* 200Hz capture */
+
+typedef struct {
+    MPU9250_wom_config config;
+    bool armed;
+    int events;
+    long long wake_us;              /* interrupt of the current event */
+    long long wake_latency_max_us;  /* interrupt until the first full rate sample */
+    unsigned int captured;          /* samples of the current event */
+    unsigned int captured_min;
+    long long armed_at_us;
+    long long armed_cpu_us;
+    unsigned int armed_transfers;
+    long long asleep_us;            /* totals while waiting for motion */
+    long long asleep_cpu_us;
+    unsigned int asleep_transfers;
+    MPU9250_wom_stats wom;          /* summed over the armed periods */
+    int modem_ok;
+    int modem_failed;
+    bool failed;
+} spi_wom_test_s;
+
+static void spi_wom_test_disarm(spi_wom_test_s *test)
+{
+    MPU9250_wom_stats stats;
+
+    resource_mpu9250_wom_get_stats(&stats);
+    resource_mpu9250_wom_stop();
+    test->armed = false;
+
+    test->wom.interrupts += stats.interrupts;
+    test->wom.events += stats.events;
+    test->wom.suppressed += stats.suppressed;
+    test->wom.spurious += stats.spurious;
+    if (stats.latency_max_us > test->wom.latency_max_us)
+        test->wom.latency_max_us = stats.latency_max_us;
+}
+
+static void spi_wom_test_arm(spi_wom_test_s *test);
+
+static void spi_wom_test_sample_cb(const MPU9250_sample *sample, void *user_data)
+{
+    spi_wom_test_s *test = user_data;
+
+    if (test->captured++ == 0 && sample->timestamp_us - test->wake_us > test->wake_latency_max_us)
+        test->wake_latency_max_us = sample->timestamp_us - test->wake_us;
+}
+
+static void spi_wom_test_modem_cb(int result, const char *response, void *user_data)
+{
+    spi_wom_test_s *test = user_data;
+
+    if (result == 0)
+        test->modem_ok++;
+    else
+        test->modem_failed++;
+}
+
+static Eina_Bool spi_wom_test_capture_done(void *data)
+{
+    spi_wom_test_s *test = data;
+
+    resource_mpu9250_drdy_stop();
+    resource_mpu9250_stop_maesure();
+    if (test->events == 1 || test->captured < test->captured_min)
+        test->captured_min = test->captured;
+    LOGI("event [%d] : [%u] samples captured", test->events, test->captured);
+
+    if (test->events == SPI_WOM_TEST_EVENTS)
+        ecore_main_loop_quit();
+    else
+        spi_wom_test_arm(test);
+
+    return ECORE_CALLBACK_CANCEL;
+}
+
+/* motion : full rate capture for a while and the modem woken for the uplink */
+static void spi_wom_test_motion_cb(long long timestamp_us, void *user_data)
+{
+    spi_wom_test_s *test = user_data;
+    MPU9250_spi_stats spi;
+
+    resource_mpu9250_get_spi_stats(&spi);
+    test->asleep_us += mtime_now_us() - test->armed_at_us;
+    test->asleep_cpu_us += spi_drdy_test_cpu_us() - test->armed_cpu_us;
+    test->asleep_transfers += spi.transfers - test->armed_transfers;
+
+    spi_wom_test_disarm(test);
+    test->events++;
+    test->wake_us = timestamp_us;
+    test->captured = 0;
+
+    if (resource_mpu9250_start_maesure(MPU9250_BIT_GYRO_FS_SEL_2000DPS, MPU9250_BIT_ACCEL_FS_SEL_16G, MPU9250_BIT_DLPF_CFG_92HZ, MPU9250_BIT_A_DLPFCFG_92HZ) == false
+            || resource_mpu9250_drdy_start(MPU9250_INT_GPIO, SPI_WOM_TEST_DIV, spi_wom_test_sample_cb, test) == false) {
+        LOGE("full rate capture failed");
+        test->failed = true;
+        ecore_main_loop_quit();
+        return;
+    }
+    if (mdm_command_async("AT\r", "OK", 1.0, spi_wom_test_modem_cb, test) == false)
+        test->modem_failed++;
+
+    ecore_timer_add(SPI_WOM_TEST_CAPTURE_SEC, spi_wom_test_capture_done, test);
+}
+
+static void spi_wom_test_arm(spi_wom_test_s *test)
+{
+    MPU9250_spi_stats spi;
+
+    if (resource_mpu9250_wom_start(MPU9250_INT_GPIO, &test->config, spi_wom_test_motion_cb, test) == false) {
+        LOGE("wake-on-motion start failed");
+        test->failed = true;
+        ecore_main_loop_quit();
+        return;
+    }
+
+    resource_mpu9250_get_spi_stats(&spi);
+    test->armed = true;
+    test->armed_at_us = mtime_now_us();
+    test->armed_cpu_us = spi_drdy_test_cpu_us();
+    test->armed_transfers = spi.transfers;
+    LOGI("waiting for motion ...");
+}
+
+static Eina_Bool spi_wom_test_timeout(void *data)
+{
+    LOGE("timed out, move the sensor");
+    ecore_main_loop_quit();
+    return ECORE_CALLBACK_CANCEL;
+}
+
+/*
+ * sleep until motion, SPI_WOM_TEST_EVENTS times : wake latency, samples
+ * captured after each wake, and what waiting cost against drdy capture
+ */
+int  spi_wom_test_main(void)
+{
+    spi_wom_test_s test;
+    Ecore_Timer *timer;
+    int ret = 0;
+
+    LOGI("%s starting...\n", __func__);
+
+    memset(&test, 0x0, sizeof(test));
+    test.config.threshold_mg = 40;
+    test.config.lp_odr = MPU9250_BIT_LP_ACCEL_ODR_31_25HZ;
+    test.config.holdoff_ms = 500;
+
+    if (resource_mpu9250_spi_init() < 0 || resource_mpu9250_dev_init() == false) {
+        LOGI("%s MPU9250 init fail ...", __func__);
+        goto error;
+    }
+
+    resource_mpu9250_reset_spi_stats();
+    spi_wom_test_arm(&test);
+    timer = ecore_timer_add(SPI_WOM_TEST_TIMEOUT_SEC, spi_wom_test_timeout, NULL);
+    ecore_main_loop_begin();
+    if (test.events == SPI_WOM_TEST_EVENTS)
+        ecore_timer_del(timer);
+
+    if (test.armed)
+        spi_wom_test_disarm(&test);
+    resource_mpu9250_drdy_stop();
+    resource_mpu9250_stop_maesure();
+    mdm_async_stop();
+
+    LOGI("wom : [%d] events, [%u] interrupts, [%u] suppressed, [%u] spurious, event delivery max [%u] us",
+            test.events, test.wom.interrupts, test.wom.suppressed, test.wom.spurious, test.wom.latency_max_us);
+    LOGI("wom : interrupt to first full rate sample max [%lld] us, fewest samples per capture [%u], modem [%d] ok [%d] failed",
+            test.wake_latency_max_us, test.captured_min, test.modem_ok, test.modem_failed);
+    if (test.asleep_us > 0)
+        LOGI("asleep [%lld] ms : cpu [%lld.%lld] %% of a core, [%lld] transfers/s; capturing : [%d] transfers/s",
+                test.asleep_us / 1000, test.asleep_cpu_us * 100 / test.asleep_us, test.asleep_cpu_us * 1000 / test.asleep_us % 10,
+                test.asleep_transfers * 1000000LL / test.asleep_us, 1000 / (1 + SPI_WOM_TEST_DIV));
+    if (test.failed || test.events < SPI_WOM_TEST_EVENTS
+            || test.captured_min < SPI_WOM_TEST_CAPTURE_SEC * 1000 / (1 + SPI_WOM_TEST_DIV) * 9 / 10)
+        ret = -1;
+
+    resource_mpu9250_spi_fini();
+    LOGI("%s exiting...\n", __func__);
+    return ret;
+
+error:
+    LOGI("%s error exiting...\n", __func__);
+    resource_mpu9250_spi_fini();
+    return -1;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Single producer / single consumer ring.
+ *        head is only written by the producer, tail only by the consumer;
+ *        each side publishes its index with a release store after touching
+ *        the elements and reads the other one with an acquire load.
+ *        Indexes run freely, capacity is a power of 2.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "hello.h"
+#include "spsc_ring.h"
+
+#define SPSC_RING_CACHE_LINE		(64)
+
+struct _spsc_ring_s {
+	unsigned int head;						/* producer */
+	unsigned int tail_cache;				/* producer's last view of tail */
+	char pad0[SPSC_RING_CACHE_LINE - 2 * sizeof(unsigned int)];
+	unsigned int tail;						/* consumer */
+	unsigned int head_cache;				/* consumer's last view of head */
+	char pad1[SPSC_RING_CACHE_LINE - 2 * sizeof(unsigned int)];
+	unsigned int mask;
+	unsigned int elem_size;
+	uint8_t *elems;
+};
+
+bool spsc_ring_create(unsigned int elem_size, unsigned int capacity, spsc_ring_h *ring)
+{
+	spsc_ring_h r;
+
+	if (ring == NULL || elem_size == 0 || capacity < 2 || (capacity & (capacity - 1)) != 0)
+		return false;
+
+	if (posix_memalign((void **)&r, SPSC_RING_CACHE_LINE, sizeof(*r)) != 0)
+		return false;
+	memset(r, 0x0, sizeof(*r));
+
+	r->elems = calloc(capacity, elem_size);
+	if (r->elems == NULL) {
+		free(r);
+		return false;
+	}
+	r->mask = capacity - 1;
+	r->elem_size = elem_size;
+
+	*ring = r;
+	return true;
+}
+
+void spsc_ring_destroy(spsc_ring_h ring)
+{
+	if (ring == NULL)
+		return;
+
+	free(ring->elems);
+	free(ring);
+}
+
+/**
+    @brief free elements from head on, up to the end of the buffer.
+    @retval number of elements at *elems, 0 when full
+*/
+unsigned int spsc_ring_reserve(spsc_ring_h ring, void **elems, unsigned int max)
+{
+	unsigned int head = ring->head;
+	unsigned int run = ring->mask + 1 - (head & ring->mask);
+	unsigned int space = ring->mask + 1 - (head - ring->tail_cache);
+
+	if (space < max) {
+		ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		space = ring->mask + 1 - (head - ring->tail_cache);
+	}
+	if (max > space)
+		max = space;
+	if (max > run)
+		max = run;
+
+	*elems = &ring->elems[(head & ring->mask) * ring->elem_size];
+	return max;
+}
+
+void spsc_ring_commit(spsc_ring_h ring, unsigned int n)
+{
+	__atomic_store_n(&ring->head, ring->head + n, __ATOMIC_RELEASE);
+}
+
+/**
+    @brief elements from tail on, up to the end of the buffer.
+    @retval number of elements at *elems, 0 when empty
+*/
+unsigned int spsc_ring_peek(spsc_ring_h ring, void **elems, unsigned int max)
+{
+	unsigned int tail = ring->tail;
+	unsigned int run = ring->mask + 1 - (tail & ring->mask);
+	unsigned int avail = ring->head_cache - tail;
+
+	if (avail < max) {
+		ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		avail = ring->head_cache - tail;
+	}
+	if (max > avail)
+		max = avail;
+	if (max > run)
+		max = run;
+
+	*elems = &ring->elems[(tail & ring->mask) * ring->elem_size];
+	return max;
+}
+
+void spsc_ring_release(spsc_ring_h ring, unsigned int n)
+{
+	__atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+}
+
+/* from either side, a snapshot */
+unsigned int spsc_ring_count(spsc_ring_h ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+unsigned int spsc_ring_capacity(spsc_ring_h ring)
+{
+	return ring->mask + 1;
+}
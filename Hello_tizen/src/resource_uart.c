@@ -0,0 +1,825 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _GNU_SOURCE					/* posix_openpt, ptsname */
+#include <stdio.h>
+#include <stdlib.h>
+#include <peripheral_io.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include "hello.h"
+
+#include "uart.h"
+#include "mtime.h"
+
+#define MAX_TRY_COUNT			10
+#define UART_POLL_STEP_US		(1000)	/* peripheral-io has no readiness wait, step of the virtual clock */
+#define UART_GATHER_COPY_MAX	(64)	/* copy is cheaper than writev below this */
+
+struct _uart_port_s {
+	uart_port_config_s config;
+	char *dev_path;							/* own copy of config.dev_path */
+	peripheral_uart_h handle;				/* peripheral-io port */
+	int fd;									/* tty node, -1 on peripheral-io port */
+	uart_stats_s stats;
+	struct serial_icounter_struct icount_base;
+	uint8_t tx_buf[UART_TX_BUF_SIZE];		/* gather buffer for peripheral-io writes */
+	uint8_t rx_buf[UART_RX_BUF_SIZE];		/* tty read ahead */
+	uint32_t rx_head;
+	uint32_t rx_tail;
+};
+
+static speed_t uart_tty_speed(peripheral_uart_baud_rate_e baud)
+{
+	switch (baud) {
+	case PERIPHERAL_UART_BAUD_RATE_2400:
+		return B2400;
+	case PERIPHERAL_UART_BAUD_RATE_4800:
+		return B4800;
+	case PERIPHERAL_UART_BAUD_RATE_9600:
+		return B9600;
+	case PERIPHERAL_UART_BAUD_RATE_19200:
+		return B19200;
+	case PERIPHERAL_UART_BAUD_RATE_38400:
+		return B38400;
+	case PERIPHERAL_UART_BAUD_RATE_57600:
+		return B57600;
+	case PERIPHERAL_UART_BAUD_RATE_230400:
+		return B230400;
+	case PERIPHERAL_UART_BAUD_RATE_115200:
+	default:
+		return B115200;
+	}
+}
+
+/*
+ * 8N1 raw mode with current baud rate & flow control on the tty node
+ */
+static bool uart_tty_configure(uart_port_h port)
+{
+	struct termios tio;
+
+	if (tcgetattr(port->fd, &tio) < 0) {
+		LOGE("tcgetattr failed, errno [%d]", errno);
+		return false;
+	}
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CRTSCTS | CSTOPB | PARENB);
+	tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+	if (port->config.flow == UART_FLOW_CONTROL_RTSCTS)
+		tio.c_cflag |= CRTSCTS;
+	else if (port->config.flow == UART_FLOW_CONTROL_XONXOFF)
+		tio.c_iflag |= IXON | IXOFF;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, uart_tty_speed(port->config.baud_rate));
+	cfsetospeed(&tio, uart_tty_speed(port->config.baud_rate));
+
+	if (tcsetattr(port->fd, TCSANOW, &tio) < 0) {
+		LOGE("tcsetattr failed, errno [%d]", errno);
+		return false;
+	}
+
+	return true;
+}
+
+static peripheral_error_e uart_set_flow(uart_port_h port)
+{
+	peripheral_uart_software_flow_control_e sw = PERIPHERAL_UART_SOFTWARE_FLOW_CONTROL_NONE;
+	peripheral_uart_hardware_flow_control_e hw = PERIPHERAL_UART_HARDWARE_FLOW_CONTROL_NONE;
+
+	if (port->fd >= 0)
+		return uart_tty_configure(port) ? PERIPHERAL_ERROR_NONE : PERIPHERAL_ERROR_IO_ERROR;
+
+	if (port->config.flow == UART_FLOW_CONTROL_RTSCTS)
+		hw = PERIPHERAL_UART_HARDWARE_FLOW_CONTROL_AUTO_RTSCTS;
+	else if (port->config.flow == UART_FLOW_CONTROL_XONXOFF)
+		sw = PERIPHERAL_UART_SOFTWARE_FLOW_CONTROL_XONXOFF;
+
+	return peripheral_uart_set_flow_control(port->handle, sw, hw);
+}
+
+/*
+ * kernel line error counters, only reachable through a tty fd
+ */
+static bool uart_get_icount(uart_port_h port, struct serial_icounter_struct *icount)
+{
+	if (port->fd < 0)
+		return false;
+
+	return ioctl(port->fd, TIOCGICOUNT, icount) == 0;
+}
+
+static bool uart_tty_open(uart_port_h port)
+{
+	// Opens the tty device node, 8N1 raw
+	port->fd = open(port->dev_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (port->fd < 0) {
+		LOGE("UART device [%s] open Failed, errno [%d]", port->dev_path, errno);
+		return false;
+	}
+
+	if (uart_tty_configure(port) == false) {
+		close(port->fd);
+		port->fd = -1;
+		return false;
+	}
+
+	if (uart_get_icount(port, &port->icount_base) == false)
+		memset(&port->icount_base, 0x0, sizeof(port->icount_base));
+
+	return true;
+}
+
+static bool uart_peripheral_open(uart_port_h port)
+{
+	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+
+	// Opens the UART slave device
+	ret = peripheral_uart_open(port->config.port, &port->handle);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("UART port [%d] open Failed, ret [%d]", port->config.port, ret);
+		return false;
+	}
+	// Sets baud rate of the UART slave device.
+	ret = peripheral_uart_set_baud_rate(port->handle, port->config.baud_rate);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("uart_set_baud_rate set Failed, ret [%d]", ret);
+		goto error_after_open;
+	}
+	// Sets byte size of the UART slave device.
+	ret = peripheral_uart_set_byte_size(port->handle, PERIPHERAL_UART_BYTE_SIZE_8BIT);	// 8 data bits
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("byte_size set Failed, ret [%d]", ret);
+		goto error_after_open;
+	}
+	// Sets parity bit of the UART slave device.
+	ret = peripheral_uart_set_parity(port->handle, PERIPHERAL_UART_PARITY_NONE);	// No parity is used
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("parity set Failed, ret [%d]", ret);
+		goto error_after_open;
+	}
+	// Sets stop bits of the UART slave device
+	ret = peripheral_uart_set_stop_bits (port->handle, PERIPHERAL_UART_STOP_BITS_1BIT);	// One stop bit
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("stop_bits set Failed, ret [%d]", ret);
+		goto error_after_open;
+	}
+	// Sets flow control of the UART slave device.
+	ret = uart_set_flow(port);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("flow control set Failed, ret [%d]", ret);
+		goto error_after_open;
+	}
+
+	return true;
+
+error_after_open:
+	peripheral_uart_close(port->handle);
+	port->handle = NULL;
+	return false;
+}
+
+/*
+ * open a UART port with its own configuration and buffers
+ */
+bool uart_port_open(const uart_port_config_s *config, uart_port_h *port)
+{
+	uart_port_h p;
+
+	if (config == NULL || port == NULL)
+		return false;
+
+	LOGI("----- uart_port_open [%d:%s] -----", config->port, config->dev_path ? config->dev_path : "-");
+
+	p = calloc(1, sizeof(*p));
+	if (p == NULL) {
+		LOGE("out of memory");
+		return false;
+	}
+
+	p->config = *config;
+	p->fd = -1;
+
+	if (config->dev_path != NULL) {
+		p->dev_path = strdup(config->dev_path);
+		p->config.dev_path = p->dev_path;
+		if (p->dev_path == NULL || uart_tty_open(p) == false) {
+			free(p->dev_path);
+			free(p);
+			return false;
+		}
+	} else if (uart_peripheral_open(p) == false) {
+		free(p);
+		return false;
+	}
+
+	*port = p;
+	return true;
+}
+
+/*
+ * close UART handle and clear UART resources
+ */
+void uart_port_close(uart_port_h port)
+{
+	if (port == NULL)
+		return;
+
+	LOGI("----- uart_port_close [%d:%s] -----", port->config.port, port->dev_path ? port->dev_path : "-");
+
+	if (port->fd >= 0)
+		close(port->fd);
+	else
+		// Closes the UART slave device
+		peripheral_uart_close(port->handle);
+
+	free(port->dev_path);
+	free(port);
+}
+
+bool uart_port_set_baud_rate(uart_port_h port, peripheral_uart_baud_rate_e baud_rate)
+{
+	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+
+	if (port == NULL)
+		return false;
+
+	port->config.baud_rate = baud_rate;
+	if (port->fd >= 0)
+		return uart_tty_configure(port);
+
+	ret = peripheral_uart_set_baud_rate(port->handle, baud_rate);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("uart_set_baud_rate set Failed, ret [%d]", ret);
+		return false;
+	}
+
+	return true;
+}
+
+peripheral_uart_baud_rate_e uart_port_get_baud_rate(uart_port_h port)
+{
+	if (port == NULL)
+		return PERIPHERAL_UART_BAUD_RATE_0;
+
+	return port->config.baud_rate;
+}
+
+/*
+ * select flow control: RTS/CTS, XON/XOFF or none
+ */
+bool uart_port_set_flow_control(uart_port_h port, uart_flow_control_e flow)
+{
+	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+
+	if (port == NULL)
+		return false;
+
+	port->config.flow = flow;
+	ret = uart_set_flow(port);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("flow control set Failed, ret [%d]", ret);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * To write data to a slave device
+ */
+bool uart_port_write(uart_port_h port, const uint8_t *data, uint32_t length)
+{
+	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+	ssize_t n;
+
+	if (port == NULL)
+		return false;
+
+	if (port->fd >= 0) {
+		while (length > 0) {
+			n = write(port->fd, data, length);
+			if (n < 0) {
+				if (errno == EAGAIN || errno == EINTR) {
+					usleep(1000);	/* tx full or flow stopped */
+					continue;
+				}
+				LOGE("UART write failed, errno [%d]", errno);
+				port->stats.tx_errors++;
+				return false;
+			}
+			port->stats.tx_bytes += n;
+			data += n;
+			length -= n;
+		}
+		return true;
+	}
+
+	ret = peripheral_uart_write(port->handle, (uint8_t *)data, length);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		LOGE("UART write failed, ret [%d]", ret);
+		port->stats.tx_errors++;
+		return false;
+	}
+	port->stats.tx_bytes += length;
+
+	return true;
+}
+
+/*
+ * write what the port accepts now, without waiting
+ * return number of bytes written, or negative peripheral_error_e
+ */
+int uart_port_write_some(uart_port_h port, const uint8_t *data, uint32_t length)
+{
+	ssize_t n;
+
+	if (port == NULL)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	if (port->fd < 0) {
+		/* peripheral-io has no partial write */
+		if (uart_port_write(port, data, length) == false)
+			return PERIPHERAL_ERROR_IO_ERROR;
+		return (int)length;
+	}
+
+	n = write(port->fd, data, length);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		LOGE("UART write failed, errno [%d]", errno);
+		port->stats.tx_errors++;
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+	port->stats.tx_bytes += n;
+
+	return n;
+}
+
+/*
+ * wait until the tty takes more bytes, tx full or flow stopped
+ */
+static bool uart_wait_writable(uart_port_h port)
+{
+	struct pollfd pfd;
+
+	pfd.fd = port->fd;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+		LOGE("poll failed, errno [%d]", errno);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * write header, payload & trailer pieces as one transfer
+ * tty ports hand larger sets to writev() without copying, the tty layer
+ * costs more per piece than copying a few bytes, so short frames are
+ * gathered in the port tx buffer and written at once
+ * peripheral-io takes a single buffer, sets over the tx buffer go piece by piece
+ */
+bool uart_port_writev(uart_port_h port, const struct iovec *iov, int iovcnt)
+{
+	struct iovec vec[UART_IOV_MAX];
+	uint32_t total = 0;
+	ssize_t n;
+	int i, first = 0;
+
+	if (port == NULL || iov == NULL || iovcnt <= 0 || iovcnt > UART_IOV_MAX)
+		return false;
+
+	for (i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+
+	if (port->fd < 0 || total <= UART_GATHER_COPY_MAX) {
+		if (total > sizeof(port->tx_buf)) {
+			for (i = 0; i < iovcnt; i++)
+				if (uart_port_write(port, iov[i].iov_base, iov[i].iov_len) == false)
+					return false;
+			return true;
+		}
+		total = 0;
+		for (i = 0; i < iovcnt; i++) {
+			memcpy(port->tx_buf + total, iov[i].iov_base, iov[i].iov_len);
+			total += iov[i].iov_len;
+		}
+		return uart_port_write(port, port->tx_buf, total);
+	}
+
+	memcpy(vec, iov, iovcnt * sizeof(*iov));
+	while (first < iovcnt) {
+		n = writev(port->fd, &vec[first], iovcnt - first);
+		if (n < 0) {
+			if ((errno == EAGAIN || errno == EINTR) && uart_wait_writable(port))
+				continue;
+			LOGE("UART writev failed, errno [%d]", errno);
+			port->stats.tx_errors++;
+			return false;
+		}
+		port->stats.tx_bytes += n;
+		/* skip what went out, a piece may be left half written */
+		while (first < iovcnt && (size_t)n >= vec[first].iov_len) {
+			n -= vec[first].iov_len;
+			first++;
+		}
+		if (first < iovcnt) {
+			vec[first].iov_base = (uint8_t *)vec[first].iov_base + n;
+			vec[first].iov_len -= n;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * read what is available, up to length bytes, without waiting
+ * return number of bytes read, or negative peripheral_error_e
+ */
+int uart_port_read(uart_port_h port, uint8_t *data, uint32_t length)
+{
+	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+	uint32_t count = 0;
+	ssize_t n;
+
+	if (port == NULL)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	if (port->fd >= 0) {
+		while (count < length) {
+			if (port->rx_head == port->rx_tail) {
+				n = read(port->fd, port->rx_buf, sizeof(port->rx_buf));
+				if (n <= 0) {
+					if (n < 0 && errno != EAGAIN && errno != EINTR) {
+						port->stats.rx_errors++;
+						if (count == 0)
+							return PERIPHERAL_ERROR_IO_ERROR;
+					}
+					break;
+				}
+				port->stats.rx_bytes += n;
+				port->rx_head = n;
+				port->rx_tail = 0;
+			}
+			n = port->rx_head - port->rx_tail;
+			if (n > length - count)
+				n = length - count;
+			memcpy(data + count, port->rx_buf + port->rx_tail, n);
+			port->rx_tail += n;
+			count += n;
+		}
+		return count;
+	}
+
+	/* peripheral_uart_read does not report short reads, go byte by byte */
+	while (count < length) {
+		ret = peripheral_uart_read(port->handle, data + count, 1);
+		if (ret != PERIPHERAL_ERROR_NONE) {
+			if (ret != PERIPHERAL_ERROR_TRY_AGAIN) {
+				port->stats.rx_errors++;
+				if (count == 0)
+					return ret;
+			}
+			break;
+		}
+		port->stats.rx_bytes++;
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * read one byte, same return codes as peripheral_uart_read
+ */
+peripheral_error_e uart_port_read_byte(uart_port_h port, uint8_t *data)
+{
+	int ret = uart_port_read(port, data, 1);
+
+	if (ret == 1)
+		return PERIPHERAL_ERROR_NONE;
+	if (ret == 0)
+		return PERIPHERAL_ERROR_TRY_AGAIN;
+	return ret;
+}
+
+/*
+ * wait until the port has data or timeout_us passed, timeout_us < 0 waits forever
+ * return 1 if readable, 0 on timeout, or negative peripheral_error_e
+ */
+static int uart_wait_readable(uart_port_h port, long long timeout_us)
+{
+	struct pollfd pfd;
+	int ret;
+
+	if (port->rx_head != port->rx_tail)
+		return 1;
+
+	pfd.fd = port->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	if (port->fd < 0 || mtime_is_virtual()) {
+		/* caller reads right after, sleep one step at most */
+		if (timeout_us == 0)
+			return 0;
+		/* on the virtual clock only look at the tty, time passes in steps */
+		if (port->fd >= 0 && poll(&pfd, 1, 0) > 0)
+			return 1;
+		mtime_sleep_us((timeout_us > 0 && timeout_us < UART_POLL_STEP_US) ? timeout_us : UART_POLL_STEP_US);
+		return 1;
+	}
+
+	/* round up, poll() would return early on a sub-ms remainder */
+	ret = poll(&pfd, 1, timeout_us < 0 ? -1 : (int)((timeout_us + 999) / 1000));
+	if (ret < 0) {
+		if (errno == EINTR)
+			return 1;
+		LOGE("poll failed, errno [%d]", errno);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+	if (ret > 0 && (pfd.revents & (POLLERR | POLLNVAL))) {
+		LOGE("UART port error, revents [0x%x]", pfd.revents);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	return ret;
+}
+
+/*
+ * read up to length bytes, return as soon as all arrived or timeout_ms passed
+ * timeout_ms < 0 waits forever, 0 takes only what is already there
+ * return number of bytes read (short on timeout), or negative peripheral_error_e
+ */
+int uart_port_read_timeout(uart_port_h port, uint8_t *data, uint32_t length, int timeout_ms)
+{
+	long long deadline = 0;
+	long long remain = -1;
+	uint32_t count = 0;
+	int ret;
+
+	if (port == NULL)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	if (timeout_ms >= 0)
+		deadline = mtime_now_us() + (long long)timeout_ms * 1000;
+
+	while (count < length) {
+		ret = uart_port_read(port, data + count, length - count);
+		if (ret < 0)
+			return count > 0 ? (int)count : ret;
+		count += ret;
+		if (count == length)
+			break;
+
+		if (timeout_ms >= 0) {
+			remain = deadline - mtime_now_us();
+			if (remain <= 0)
+				break;
+		}
+		ret = uart_wait_readable(port, remain);
+		if (ret < 0)
+			return count > 0 ? (int)count : ret;
+	}
+
+	return count;
+}
+
+/*
+ * To read data from a slave device
+ * blocking mode waits until length bytes arrived, otherwise takes what is there
+ */
+bool uart_port_read_data(uart_port_h port, uint8_t *data, uint32_t length, bool blocking_mode)
+{
+	int ret;
+
+	ret = uart_port_read_timeout(port, data, length, blocking_mode ? -1 : 0);
+	if (ret < 0) {
+		LOGE("UART read failed, , ret [%d]", ret);
+		return false;
+	}
+	if ((uint32_t)ret != length) {
+		LOGE("No data to receive");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * drop everything already received
+ */
+void uart_port_flush(uart_port_h port)
+{
+	uint8_t buf[64];
+
+	if (port == NULL)
+		return;
+
+	if (port->fd >= 0)
+		tcflush(port->fd, TCIFLUSH);
+
+	port->rx_head = port->rx_tail = 0;
+	while (uart_port_read(port, buf, sizeof(buf)) > 0)
+		;
+}
+
+/*
+ * tty fd to wait on, -1 on a peripheral-io port
+ */
+int uart_port_get_fd(uart_port_h port)
+{
+	if (port == NULL)
+		return -1;
+
+	return port->fd;
+}
+
+/*
+ * bytes already read ahead from the tty, poll() on the fd will not see them
+ */
+bool uart_port_rx_buffered(uart_port_h port)
+{
+	if (port == NULL)
+		return false;
+
+	return port->rx_head != port->rx_tail;
+}
+
+/*
+ * byte & error counters, overrun / framing come from the kernel tty layer
+ * and stay 0 on a peripheral-io port, which does not expose them
+ */
+void uart_port_get_stats(uart_port_h port, uart_stats_s *stats)
+{
+	struct serial_icounter_struct icount;
+
+	if (port == NULL || stats == NULL)
+		return;
+
+	*stats = port->stats;
+	if (uart_get_icount(port, &icount)) {
+		stats->overrun += (icount.overrun - port->icount_base.overrun) + (icount.buf_overrun - port->icount_base.buf_overrun);
+		stats->framing += (icount.frame - port->icount_base.frame) + (icount.parity - port->icount_base.parity);
+	}
+}
+
+void uart_port_reset_stats(uart_port_h port)
+{
+	if (port == NULL)
+		return;
+
+	memset(&port->stats, 0x0, sizeof(port->stats));
+	if (uart_get_icount(port, &port->icount_base) == false)
+		memset(&port->icount_base, 0x0, sizeof(port->icount_base));
+}
+
+
+/*
+ * open a UART port on a new pty, peer gets the other end
+ * used to run device code against a software peer
+ */
+bool uart_port_open_pty(peripheral_uart_baud_rate_e baud_rate, uart_port_h *port, int *peer)
+{
+	uart_port_config_s config = { .port = -1, .baud_rate = baud_rate, .flow = UART_FLOW_CONTROL_NONE };
+	int master;
+
+	if (port == NULL || peer == NULL)
+		return false;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+		LOGE("pty open failed, errno [%d]", errno);
+		if (master >= 0)
+			close(master);
+		return false;
+	}
+
+	config.dev_path = ptsname(master);
+	if (uart_port_open(&config, port) == false) {
+		close(master);
+		return false;
+	}
+
+	*peer = master;
+	return true;
+}
+
+#define UART_LATENCY_TEST_COUNT		(200)
+#define UART_LATENCY_TIMEOUT_MS		(1000)
+
+typedef struct{
+	int master;
+	volatile long long sent_us;
+}uart_latency_peer_s;
+
+/*
+ * pty peer, sends one byte at a random point of every 2..10 ms
+ */
+static void *uart_latency_peer(void *data)
+{
+	uart_latency_peer_s *peer = data;
+	uint8_t ch = 0x55;
+	int i;
+
+	for (i = 0; i < UART_LATENCY_TEST_COUNT; i++) {
+		usleep(2000 + rand() % 8000);
+		peer->sent_us = mtime_now_us();
+		if (write(peer->master, &ch, 1) != 1)
+			break;
+		while (peer->sent_us != 0)
+			usleep(100);
+	}
+
+	return NULL;
+}
+
+/*
+ * measure first byte delay of uart_port_read_timeout against a pty peer
+ */
+int  uart_latency_test_main(void)
+{
+	uart_latency_peer_s peer = { .master = -1 };
+	uart_port_h port = NULL;
+	pthread_t thread;
+	long long delay, min = -1, max = 0, sum = 0;
+	uint8_t ch;
+	int i, ret, count = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	peer.sent_us = 0;
+	if (uart_port_open_pty(PERIPHERAL_UART_BAUD_RATE_115200, &port, &peer.master) == false)
+		goto error;
+
+	if (pthread_create(&thread, NULL, uart_latency_peer, &peer) != 0) {
+		LOGE("pthread_create failed");
+		goto error;
+	}
+
+	for (i = 0; i < UART_LATENCY_TEST_COUNT; i++) {
+		ret = uart_port_read_timeout(port, &ch, 1, UART_LATENCY_TIMEOUT_MS);
+		if (ret != 1) {
+			LOGE("no byte within [%d] ms, ret [%d]", UART_LATENCY_TIMEOUT_MS, ret);
+			break;
+		}
+		delay = mtime_now_us() - peer.sent_us;
+		peer.sent_us = 0;
+		if (min < 0 || delay < min)
+			min = delay;
+		if (delay > max)
+			max = delay;
+		sum += delay;
+		count++;
+	}
+	if (i < UART_LATENCY_TEST_COUNT)
+		pthread_cancel(thread);
+	pthread_join(thread, NULL);
+
+	if (count > 0)
+		LOGI("first byte delay [%d] samples : min [%lld] us, avg [%lld] us, max [%lld] us", count, min, sum / count, max);
+
+	/* nothing sent, must come back after the timeout with 0 */
+	delay = mtime_now_us();
+	ret = uart_port_read_timeout(port, &ch, 1, 50);
+	LOGI("idle read ret [%d] after [%lld] us (timeout 50000 us)", ret, mtime_now_us() - delay);
+
+	uart_port_close(port);
+	close(peer.master);
+	LOGI("%s exiting...\n", __func__);
+	return count == UART_LATENCY_TEST_COUNT ? 0 : -1;
+
+error:
+	LOGI("%s error exiting...\n", __func__);
+	if (port != NULL)
+		uart_port_close(port);
+	if (peer.master >= 0)
+		close(peer.master);
+	return -1;
+}
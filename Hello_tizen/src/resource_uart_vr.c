@@ -21,16 +21,19 @@
 #include <system_info.h>
 #include <unistd.h>
 #include <app_common.h>
+#include "hello_tizen.h"
 #include "hello.h"
 #include <Ecore.h>
 
-#include "vr3.h"
+#include "uart.h"
+#include "reactor.h"
+#include "mtime.h"
 
 
 
-#define UART_PORT_ANCHOR3		1	// RPI3 : UART0, ANCHOR3 : UART1
-#define MAX_TRY_COUNT			10
 #define MAX_FRAME_LEN			32
+#define MDM_DEFAULT_BAUD_RATE	PERIPHERAL_UART_BAUD_RATE_115200	// BG96 factory AT+IPR
+#define MDM_RESPONSE_LEN		512
 
 int incoming_byte = 0;          // for incoming serial data
 char frame_buf[MAX_FRAME_LEN];  // for save protocol data
@@ -38,146 +41,104 @@ int frame_len = MAX_FRAME_LEN;  // length of frame
 int byte_position = 0;          // next byte position in frame_buf
 unsigned int calc_checksum = 0; // to save calculated checksum value
 
-static bool initialized = false;
-static peripheral_uart_h g_uart_h;
 static peripheral_gpio_h g_gpio_h;
 
+/* modem UART port, attached by the application or opened on first use */
+static uart_port_h g_mdm_port = NULL;
+static bool g_mdm_port_owned = false;
+
+/* non-blocking AT command in flight, fed from the main loop */
+static reactor_source_h g_mdm_source = NULL;
+static struct {
+	bool busy;
+	char filter[32];
+	mdm_response_cb cb;
+	void *user_data;
+	Ecore_Timer *timer;
+	char line[128];
+	size_t line_len;
+	char response[MDM_RESPONSE_LEN];
+	size_t response_len;
+} g_mdm_cmd;
+
+/*
+ * BG96 AT+IPR candidates, fastest first.
+ * peripheral-io stops at 230400, so 460800/921600 can not be set on the host side.
+ */
+static const struct {
+	peripheral_uart_baud_rate_e baud;
+	int bps;
+} mdm_baud_table[] = {
+	{PERIPHERAL_UART_BAUD_RATE_230400, 230400},
+	{PERIPHERAL_UART_BAUD_RATE_115200, 115200},
+};
+
 int pwrPin = 17;
 int statPin = 27;
 
 /*
- * open UART port and set UART handle resource
- * set BAUD rate, byte size, parity bit, stop bit, flow control
- * Default baud rate：9600bps Check bit：None Stop bit：1 bit
+ * drive the BG96 through an already opened UART port
+ * the port stays owned by the caller
  */
-bool resource_serial_init(void)
+void mdm_attach(uart_port_h port)
 {
-	if (initialized) return true;
-
-	LOGI("----- resource_serial_init -----");
-	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
-
-	// Opens the UART slave device
-	ret = peripheral_uart_open(UART_PORT_ANCHOR3, &g_uart_h);
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		LOGE("UART port [%d] open Failed, ret [%d]", UART_PORT_ANCHOR3, ret);
-		return false;
-	}
-	// Sets baud rate of the UART slave device.
-	ret = peripheral_uart_set_baud_rate(g_uart_h, PERIPHERAL_UART_BAUD_RATE_115200);	// The number of signal in one second is 9600
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		LOGE("uart_set_baud_rate set Failed, ret [%d]", ret);
-		return false;
-	}
-	// Sets byte size of the UART slave device.
-	ret = peripheral_uart_set_byte_size(g_uart_h, PERIPHERAL_UART_BYTE_SIZE_8BIT);	// 8 data bits
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		LOGE("byte_size set Failed, ret [%d]", ret);
-		return false;
-	}
-	// Sets parity bit of the UART slave device.
-	ret = peripheral_uart_set_parity(g_uart_h, PERIPHERAL_UART_PARITY_NONE);	// No parity is used
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		LOGE("parity set Failed, ret [%d]", ret);
-		return false;
-	}
-	// Sets stop bits of the UART slave device
-	ret = peripheral_uart_set_stop_bits (g_uart_h, PERIPHERAL_UART_STOP_BITS_1BIT);	// One stop bit
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		LOGE("stop_bits set Failed, ret [%d]", ret);
-		return false;
-	}
-	// Sets flow control of the UART slave device.
-	// No software flow control & No hardware flow control
-	ret = peripheral_uart_set_flow_control (g_uart_h, PERIPHERAL_UART_SOFTWARE_FLOW_CONTROL_NONE, PERIPHERAL_UART_HARDWARE_FLOW_CONTROL_NONE);
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		LOGE("flow control set Failed, ret [%d]", ret);
-		return false;
-	}
+	mdm_async_stop();
+	if (g_mdm_port_owned)
+		uart_port_close(g_mdm_port);
 
-	initialized = true;
-	return true;
+	g_mdm_port = port;
+	g_mdm_port_owned = false;
 }
 
 /*
- * To write data to a slave device
+ * close the modem UART port if the driver opened it
  */
-bool resource_write_data(uint8_t *data, uint32_t length)
+void mdm_fini(void)
 {
-	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
-	/* IMPLEMENT HERE
-	 * write length byte data to UART
-	 * API : peripheral_uart_write
-	 * 	Args : g_uart_h, data & length
-	 * 	return : ret
-	 */
-	ret = peripheral_uart_write(g_uart_h, data, length);
-
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		LOGE("UART write failed, ret [%d]", ret);
-		return false;
-	}
+	mdm_async_stop();
+	if (g_mdm_port_owned)
+		uart_port_close(g_mdm_port);
 
-	LOGE("OK!! UART write, ret [%d]", ret);
-
-	return true;
+	g_mdm_port = NULL;
+	g_mdm_port_owned = false;
 }
 
 /*
- * To read data from a slave device
+ * get the modem UART port, default ANCHOR3 UART1 if none attached
  */
-bool resource_read_data(uint8_t *data, uint32_t length, bool blocking_mode)
+static bool mdm_port_get(void)
 {
-	int try_again = 0;
-	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
-	if (g_uart_h == NULL)
+	uart_port_config_s config = {
+		.port = UART_PORT_ANCHOR3,
+		.dev_path = NULL,
+		.baud_rate = MDM_DEFAULT_BAUD_RATE,
+		.flow = UART_FLOW_CONTROL_NONE,
+	};
+
+	if (g_mdm_port != NULL)
+		return true;
+
+	if (uart_port_open(&config, &g_mdm_port) == false) {
+		g_mdm_port = NULL;
 		return false;
-
-	while (1) {
-		// read length byte from UART
-		ret = peripheral_uart_read(g_uart_h, data, length);
-		if (ret == PERIPHERAL_ERROR_NONE)
-			return true;
-
-		// if data is not ready, try again
-		if (ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			// if blocking mode, read again
-			if (blocking_mode == true) {
-				usleep(100 * 1000);
-				LOGI(".");
-				continue;
-			} else {
-				// if non-blocking mode, retry MAX_TRY_COUNT
-				if (try_again >= MAX_TRY_COUNT) {
-					LOGE("No data to receive");
-					return false;
-				} else {
-					try_again++;
-				}
-			}
-		} else {
-			// if return value is not (PERIPHERAL_ERROR_NONE or PERIPHERAL_ERROR_TRY_AGAIN)
-			// return with false
-			LOGE("UART read failed, , ret [%d]", ret);
-			return false;
-		}
 	}
 
+	g_mdm_port_owned = true;
 	return true;
 }
 
 /*
- * close UART handle and clear UART resources
+ * modem port for the blocking mdm_* calls, refused while the reactor
+ * owns it for mdm_command_async
  */
-void resource_serial_fini(void)
+static bool mdm_open(void)
 {
-	LOGI("----- resource_serial_fini -----");
-	if(initialized) {
-		// Closes the UART slave device
-		peripheral_uart_close(g_uart_h);
-		initialized = false;
-		g_uart_h = NULL;
+	if (g_mdm_source != NULL) {
+		LOGE("modem port in async mode, call mdm_async_stop first");
+		return false;
 	}
+
+	return mdm_port_get();
 }
 
 int mdm_isPowerON(void)
@@ -337,35 +298,72 @@ int mdm_powerON(void)
 
 	peripheral_gpio_close(g_gpio_h);
 
+	/* AT+IPR is not stored with AT&W, the modem boots at its default rate */
+	if (g_mdm_port != NULL)
+		uart_port_set_baud_rate(g_mdm_port, MDM_DEFAULT_BAUD_RATE);
 }
 
-static void uart_buffer_flush(void)
+/*
+ * wait for a line containing filter (or ERROR) on the opened port
+ * return 0 if found, 1 on ERROR or timeout
+ */
+static int mdm_waitResponse(const char *filter, double Timeout)
 {
-	bool ret = true;
 	char buffer[128];
-	int idx=0;
-	char ch;
+	uint8_t ch = 0;
+	size_t idx = 0;
+	double cTime = mtime_now();
+	peripheral_error_e _ret = PERIPHERAL_ERROR_NONE;
 
-	LOGE("uart buffer flush...");
-	ret = resource_serial_init();
-	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
-		return;
-	}
+	memset(buffer, 0x0, sizeof(buffer));
 
-	while(true)
-	{
-		ret = peripheral_uart_read(g_uart_h, &ch, 1);
-		if (ret == PERIPHERAL_ERROR_NONE)
+	do{
+		_ret = uart_port_read_byte(g_mdm_port, &ch);
+		if (_ret == PERIPHERAL_ERROR_NONE)
 		{
-			LOGE("buffer Flush...");
+			if(ch != '\r' && ch != '\n'){
+				if(idx < sizeof(buffer) - 1)
+					buffer[idx++] = ch;
+			}
+			else if(idx > 0){
+				if(strstr(buffer, filter) != NULL)
+					return 0;
+				if(strstr(buffer, "ERROR") != NULL)
+					return 1;
+				idx = 0;
+				memset(buffer, 0x0, sizeof(buffer));
+			}
+			continue;
 		}
 		// if data is not ready, try again
-		if (ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			break;
+		if (_ret == PERIPHERAL_ERROR_TRY_AGAIN) {
+			mtime_sleep_us(10 * 1000);
+			continue;
 		}
+		LOGE("UART read failed, ret [%d]", _ret);
+		return 1;
+	}while( Timeout >= (mtime_now() - cTime) );
+
+	return 1;
+}
+
+/*
+ * check the modem answers "AT" at current host baud rate
+ */
+static int mdm_probe(void)
+{
+	const char *cmd = "AT\r";
+
+	for(int i=0; i<3; i++)
+	{
+		uart_port_flush(g_mdm_port);
+		if (uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd)) == false)
+			continue;
+		if (mdm_waitResponse("OK", 0.5) == 0)
+			return 0;
 	}
-//	resource_serial_fini();
+
+	return 1;
 }
 
 int mdm_socketRecv(char *recvMsg, int length)
@@ -382,25 +380,25 @@ int mdm_socketRecv(char *recvMsg, int length)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return 1;
 	}
 
 	float Timeout = 10.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 	int found = 1;
 	char *checkFilter = NULL;
 
 	usleep(3000 * 1000);
 	const char *cmd = "AT+QIRD=0\r";
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return 1;
 	}
 
@@ -412,7 +410,7 @@ int mdm_socketRecv(char *recvMsg, int length)
 
 	/* Check Network Registred */
 	do{
-		ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r'){
@@ -433,8 +431,8 @@ int mdm_socketRecv(char *recvMsg, int length)
 				}
 			}
 		}
-		usleep(100 * 1000);
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && found);
+		mtime_sleep_us(100 * 1000);
+	}while( (Timeout>= (mtime_now() - cTime) ) && found);
 
 	if(found == 0)
 	{
@@ -461,7 +459,6 @@ int mdm_socketRecv(char *recvMsg, int length)
 		}
 	}
 
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return found;
@@ -481,9 +478,9 @@ int mdm_socketSend(char *sendMsg, int length)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return 1;
 	}
 
@@ -493,21 +490,21 @@ int mdm_socketSend(char *sendMsg, int length)
 	sprintf(cmd, "AT+QISEND=0,%d\r",length);
 	LOGE("Socket Send : %s",cmd);
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return 1;
 	}
 
 	float Timeout = 10.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 	char *checkFilter = NULL;
 	int found = 1;
 
 	do{
-		ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch == '>')
@@ -515,17 +512,17 @@ int mdm_socketSend(char *sendMsg, int length)
 		}
 		// if data is not ready, try again
 		if (ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			usleep(100 * 1000);
+			mtime_sleep_us(100 * 1000);
 			LOGI(".");
 			continue;
 		}
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && found);
+	}while( (Timeout>= (mtime_now() - cTime) ) && found);
 
 	LOGE("send : %s, %d",sendMsg, length);
 
-	ret = resource_write_data(sendMsg, length);
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)sendMsg, length);
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return 1;
 	}
 
@@ -535,7 +532,7 @@ int mdm_socketSend(char *sendMsg, int length)
 	memset(buffer, 0x0, sizeof(buffer));
 
 	do{
-		ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r' && ch != '\n'){
@@ -553,10 +550,9 @@ int mdm_socketSend(char *sendMsg, int length)
 				}
 			}
 		}
-		usleep(100 * 1000);
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && found);
+		mtime_sleep_us(100 * 1000);
+	}while( (Timeout>= (mtime_now() - cTime) ) && found);
 
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return found;
@@ -577,9 +573,9 @@ int mdm_socketOpen(char *IP, int port, bool isTCP)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return found;
 	}
 
@@ -589,16 +585,16 @@ int mdm_socketOpen(char *IP, int port, bool isTCP)
 	sprintf(cmd,"AT+QIOPEN=1,0,\"%s\",\"%s\",%d,0,0\r",isTCP?"TCP":"UDP",IP,port);
 	LOGE("Open : %s",cmd);
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return found;
 	}
 
 	float Timeout = 10.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 
 	char filter[] = "+QIOPEN:";
 	char *checkFilter = NULL;
@@ -606,7 +602,7 @@ int mdm_socketOpen(char *IP, int port, bool isTCP)
 	peripheral_error_e _ret = PERIPHERAL_ERROR_NONE;
 
 	do{
-		_ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		_ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (_ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r'){
@@ -629,11 +625,11 @@ int mdm_socketOpen(char *IP, int port, bool isTCP)
 		}
 		// if data is not ready, try again
 		if (_ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			usleep(100 * 1000);
+			mtime_sleep_us(100 * 1000);
 			LOGI(".");
 			continue;
 		}
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && checkFilter == NULL);
+	}while( (Timeout>= (mtime_now() - cTime) ) && checkFilter == NULL);
 
 #if 0
 	for(int i=0; i<idx; i++)
@@ -641,7 +637,6 @@ int mdm_socketOpen(char *IP, int port, bool isTCP)
 		LOGE("uart read buffer[%d] = %c", i, buffer[i]);
 	}
 #endif
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return found;
@@ -661,9 +656,9 @@ void mdm_socketClose(void)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return;
 	}
 
@@ -671,16 +666,16 @@ void mdm_socketClose(void)
 	const char *cmd = "AT+QICLOSE=0,3\r";
 
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return;
 	}
 
 	float Timeout = 13.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 
 	char filter[] = "OK";
 	char *checkFilter = NULL;
@@ -688,7 +683,7 @@ void mdm_socketClose(void)
 	peripheral_error_e _ret = PERIPHERAL_ERROR_NONE;
 
 	do{
-		_ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		_ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (_ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r'){
@@ -709,11 +704,11 @@ void mdm_socketClose(void)
 		}
 		// if data is not ready, try again
 		if (_ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			usleep(100 * 1000);
+			mtime_sleep_us(100 * 1000);
 			LOGI(".");
 			continue;
 		}
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && checkFilter == NULL);
+	}while( (Timeout>= (mtime_now() - cTime) ) && checkFilter == NULL);
 
 #if 1
 	for(int i=0; i<idx; i++)
@@ -721,7 +716,6 @@ void mdm_socketClose(void)
 		LOGE("uart read buffer[%d] = %c", i, buffer[i]);
 	}
 #endif
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return;
@@ -741,24 +735,24 @@ int mdm_getIMEI(char *imei, int length)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return 1;
 	}
 
 	const char *cmd = "AT+CGSN\r";
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return 1;
 	}
 
 	float Timeout = 3.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 
 	char filter2[] = "OK";
 	int found = 1;
@@ -766,7 +760,7 @@ int mdm_getIMEI(char *imei, int length)
 
 	/* Check Network Registred */
 	do{
-		ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r' && ch != '\n'){
@@ -787,10 +781,9 @@ int mdm_getIMEI(char *imei, int length)
 				}
 			}
 		}
-		usleep(100 * 1000);
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && found);
+		mtime_sleep_us(100 * 1000);
+	}while( (Timeout>= (mtime_now() - cTime) ) && found);
 
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return found;
@@ -810,24 +803,24 @@ int  mdm_IsRegistred(void)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return 1;
 	}
 
 	const char *cmd = "AT+CEREG?\r";
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return 1;
 	}
 
 	float Timeout = 3.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 
 	char filter2[] = "+CEREG:";
 	int found = 1;
@@ -836,7 +829,7 @@ int  mdm_IsRegistred(void)
 
 	/* Check Network Registred */
 	do{
-		ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r'){
@@ -862,10 +855,9 @@ int  mdm_IsRegistred(void)
 				}
 			}
 		}
-		usleep(100 * 1000);
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && found);
+		mtime_sleep_us(100 * 1000);
+	}while( (Timeout>= (mtime_now() - cTime) ) && found);
 
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return found;
@@ -886,27 +878,32 @@ int mdm_init(void)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return found;
 	}
 
+	/* modem may have been reset behind us, back at its default rate */
+	if (uart_port_get_baud_rate(g_mdm_port) != MDM_DEFAULT_BAUD_RATE && mdm_probe() != 0) {
+		LOGE("No answer at negotiated baud rate, fall back to default");
+		uart_port_set_baud_rate(g_mdm_port, MDM_DEFAULT_BAUD_RATE);
+	}
 
 //	const char *cmd = "AT\r";
 	const char *cmd = "ATE0\r";
 
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return found;
 	}
 
 	float Timeout = 3.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 
 	char filter[] = "OK";
 	char *checkFilter = NULL;
@@ -914,7 +911,7 @@ int mdm_init(void)
 	peripheral_error_e _ret = PERIPHERAL_ERROR_NONE;
 
 	do{
-		_ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		_ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (_ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r'){
@@ -937,11 +934,11 @@ int mdm_init(void)
 		}
 		// if data is not ready, try again
 		if (_ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			usleep(100 * 1000);
+			mtime_sleep_us(100 * 1000);
 			LOGI(".");
 			continue;
 		}
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && checkFilter == NULL);
+	}while( (Timeout>= (mtime_now() - cTime) ) && checkFilter == NULL);
 
 #if 0
 	for(int i=0; i<idx; i++)
@@ -949,7 +946,6 @@ int mdm_init(void)
 		LOGE("uart read buffer[%d] = %c", i, buffer[i]);
 	}
 #endif
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return found;
@@ -972,9 +968,9 @@ int mdm_pdpAct(bool _enable)
 		mdm_powerON();
 	}
 
-	ret = resource_serial_init();
+	ret = mdm_open();
 	if (ret == false) {
-		LOGE("Failed to resource_serial_init");
+		LOGE("Failed to open modem UART port");
 		return found;
 	}
 
@@ -984,16 +980,16 @@ int mdm_pdpAct(bool _enable)
 		strcpy(cmd, "AT+QIDEACT=1\r");
 
 
-	ret = resource_write_data(cmd, strlen(cmd));
+	ret = uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd));
 	if (ret == false) {
-		LOGE("Failed to resource_serial_write");
+		LOGE("Failed to write modem UART");
 		return found;
 	}
 
 	float Timeout = 3.0;
 	static double cTime;
 
-	cTime = ecore_time_get();
+	cTime = mtime_now();
 
 	char filter[] = "OK";
 	char *checkFilter = NULL;
@@ -1001,7 +997,7 @@ int mdm_pdpAct(bool _enable)
 	peripheral_error_e _ret = PERIPHERAL_ERROR_NONE;
 
 	do{
-		_ret = peripheral_uart_read(g_uart_h, &ch, 1);
+		_ret = uart_port_read_byte(g_mdm_port, &ch);
 		if (_ret == PERIPHERAL_ERROR_NONE)
 		{
 			if(ch != '\r'){
@@ -1024,11 +1020,11 @@ int mdm_pdpAct(bool _enable)
 		}
 		// if data is not ready, try again
 		if (_ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			usleep(100 * 1000);
+			mtime_sleep_us(100 * 1000);
 			LOGI(".");
 			continue;
 		}
-	}while( (Timeout>= (ecore_time_get() - cTime) ) && checkFilter == NULL);
+	}while( (Timeout>= (mtime_now() - cTime) ) && checkFilter == NULL);
 
 #if 0
 	for(int i=0; i<idx; i++)
@@ -1036,8 +1032,250 @@ int mdm_pdpAct(bool _enable)
 		LOGE("uart read buffer[%d] = %c", i, buffer[i]);
 	}
 #endif
-	resource_serial_fini();
 	LOGI("MDM Test Finished...");
 
 	return found;
 }
+
+/*
+ * negotiate the fastest baud rate both the BG96 and the host support
+ * return 0 if the link runs at a verified rate, 1 if the modem does not answer
+ */
+int mdm_setBaudRate(void)
+{
+	bool ret = true;
+	char cmd[32];
+	peripheral_uart_baud_rate_e old_baud;
+
+	if(!mdm_isPowerON()){
+		mdm_powerOFF();
+		mdm_powerON();
+	}
+
+	ret = mdm_open();
+	if (ret == false) {
+		LOGE("Failed to open modem UART port");
+		return 1;
+	}
+
+	/* find the rate the modem is running at now */
+	if (mdm_probe() != 0) {
+		uart_port_set_baud_rate(g_mdm_port, MDM_DEFAULT_BAUD_RATE);
+		if (mdm_probe() != 0) {
+			LOGE("BG96 not responding");
+			return 1;
+		}
+	}
+
+	for(size_t i=0; i<sizeof(mdm_baud_table)/sizeof(mdm_baud_table[0]); i++)
+	{
+		if (mdm_baud_table[i].baud == uart_port_get_baud_rate(g_mdm_port))
+			break;
+
+		old_baud = uart_port_get_baud_rate(g_mdm_port);
+
+		/* modem answers OK at the old rate, then switches */
+		sprintf(cmd, "AT+IPR=%d\r", mdm_baud_table[i].bps);
+		LOGE("Baud rate : %s", cmd);
+		if (uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd)) == false)
+			continue;
+		if (mdm_waitResponse("OK", 1.0) != 0)
+			continue;
+
+		mtime_sleep_us(100 * 1000);
+		if (uart_port_set_baud_rate(g_mdm_port, mdm_baud_table[i].baud) && mdm_probe() == 0) {
+			LOGE("BG96 running at %d bps", mdm_baud_table[i].bps);
+			break;
+		}
+
+		/* verify failed, go back to the old rate and try the next one */
+		LOGE("No answer at %d bps, roll back", mdm_baud_table[i].bps);
+		uart_port_set_baud_rate(g_mdm_port, old_baud);
+		if (mdm_probe() != 0) {
+			uart_port_set_baud_rate(g_mdm_port, MDM_DEFAULT_BAUD_RATE);
+			if (mdm_probe() != 0) {
+				LOGE("BG96 lost after baud rate change");
+				return 1;
+			}
+		}
+	}
+
+	LOGI("MDM Test Finished...");
+
+	return 0;
+}
+
+/*
+ * match BG96 flow control (AT+IFC) and the host port
+ * return 0 on success, 1 if the modem refused it (port left without flow control)
+ */
+int mdm_setFlowControl(uart_flow_control_e flow)
+{
+	bool ret = true;
+	const char *cmd;
+
+	if(!mdm_isPowerON()){
+		mdm_powerOFF();
+		mdm_powerON();
+	}
+
+	ret = mdm_open();
+	if (ret == false) {
+		LOGE("Failed to open modem UART port");
+		return 1;
+	}
+
+	if (flow == UART_FLOW_CONTROL_RTSCTS)
+		cmd = "AT+IFC=2,2\r";
+	else if (flow == UART_FLOW_CONTROL_XONXOFF)
+		cmd = "AT+IFC=1,1\r";
+	else
+		cmd = "AT+IFC=0,0\r";
+
+	uart_port_flush(g_mdm_port);
+	LOGE("Flow control : %s", cmd);
+
+	/* modem answers with the old setting, then switches */
+	if (uart_port_write(g_mdm_port, (const uint8_t *)cmd, strlen(cmd)) == false || mdm_waitResponse("OK", 1.0) != 0) {
+		LOGE("BG96 refused flow control [%d]", flow);
+		uart_port_set_flow_control(g_mdm_port, UART_FLOW_CONTROL_NONE);
+		return 1;
+	}
+
+	ret = uart_port_set_flow_control(g_mdm_port, flow);
+
+	LOGI("MDM Test Finished...");
+
+	return ret ? 0 : 1;
+}
+
+static void mdm_async_done(int result)
+{
+	mdm_response_cb cb = g_mdm_cmd.cb;
+	void *user_data = g_mdm_cmd.user_data;
+
+	if (g_mdm_cmd.timer != NULL) {
+		ecore_timer_del(g_mdm_cmd.timer);
+		g_mdm_cmd.timer = NULL;
+	}
+	g_mdm_cmd.busy = false;
+
+	if (cb != NULL)
+		cb(result, g_mdm_cmd.response, user_data);
+}
+
+static Eina_Bool mdm_async_timeout_cb(void *data)
+{
+	LOGE("AT command timeout");
+	g_mdm_cmd.timer = NULL;
+	mdm_async_done(1);
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/*
+ * line parser, runs from the main loop for every chunk received
+ */
+static void mdm_async_read_cb(reactor_source_h source, const uint8_t *data, int len, void *user_data)
+{
+	char ch;
+
+	for (int i = 0; i < len; i++)
+	{
+		ch = data[i];
+		if (ch != '\r' && ch != '\n') {
+			if (g_mdm_cmd.line_len < sizeof(g_mdm_cmd.line) - 1)
+				g_mdm_cmd.line[g_mdm_cmd.line_len++] = ch;
+			continue;
+		}
+		if (g_mdm_cmd.line_len == 0)
+			continue;
+
+		g_mdm_cmd.line[g_mdm_cmd.line_len] = '\0';
+		g_mdm_cmd.line_len = 0;
+
+		if (!g_mdm_cmd.busy) {
+			/* unsolicited result code */
+			LOGI("URC : %s", g_mdm_cmd.line);
+			continue;
+		}
+
+		g_mdm_cmd.response_len += snprintf(g_mdm_cmd.response + g_mdm_cmd.response_len,
+				sizeof(g_mdm_cmd.response) - g_mdm_cmd.response_len, "%s\n", g_mdm_cmd.line);
+		if (g_mdm_cmd.response_len >= sizeof(g_mdm_cmd.response))
+			g_mdm_cmd.response_len = sizeof(g_mdm_cmd.response) - 1;
+
+		if (strstr(g_mdm_cmd.line, g_mdm_cmd.filter) != NULL)
+			mdm_async_done(0);
+		else if (strstr(g_mdm_cmd.line, "ERROR") != NULL)
+			mdm_async_done(1);
+	}
+}
+
+/*
+ * send an AT command without blocking the main loop
+ * cb is called once from the main loop with 0 when a line containing filter
+ * arrives, 1 on ERROR or timeout, and the response lines received until then.
+ * blocking mdm_* calls fail until mdm_async_stop().
+ * return false if another command is still in flight or cmd could not be
+ * queued, no byte of cmd is sent then
+ */
+bool mdm_command_async(const char *cmd, const char *filter, double timeout, mdm_response_cb cb, void *user_data)
+{
+	if (g_mdm_cmd.busy) {
+		LOGE("AT command in flight");
+		return false;
+	}
+
+	if (mdm_port_get() == false) {
+		LOGE("Failed to open modem UART port");
+		return false;
+	}
+
+	if (g_mdm_source == NULL &&
+			reactor_add_port(g_mdm_port, mdm_async_read_cb, NULL, &g_mdm_source) == false) {
+		g_mdm_source = NULL;
+		return false;
+	}
+
+	snprintf(g_mdm_cmd.filter, sizeof(g_mdm_cmd.filter), "%s", filter);
+	g_mdm_cmd.cb = cb;
+	g_mdm_cmd.user_data = user_data;
+	g_mdm_cmd.response[0] = '\0';
+	g_mdm_cmd.response_len = 0;
+
+	/* before the write, a command without its timeout is never sent */
+	g_mdm_cmd.timer = ecore_timer_add(timeout, mdm_async_timeout_cb, NULL);
+	if (g_mdm_cmd.timer == NULL) {
+		LOGE("ecore_timer_add failed");
+		return false;
+	}
+
+	if (reactor_write(g_mdm_source, (const uint8_t *)cmd, strlen(cmd)) == false) {
+		LOGE("Failed to write modem UART");
+		ecore_timer_del(g_mdm_cmd.timer);
+		g_mdm_cmd.timer = NULL;
+		return false;
+	}
+
+	g_mdm_cmd.busy = true;
+
+	return true;
+}
+
+/*
+ * give the modem port back to the blocking mdm_* calls
+ * a command in flight is dropped without callback
+ */
+void mdm_async_stop(void)
+{
+	if (g_mdm_cmd.timer != NULL) {
+		ecore_timer_del(g_mdm_cmd.timer);
+		g_mdm_cmd.timer = NULL;
+	}
+	g_mdm_cmd.busy = false;
+	g_mdm_cmd.line_len = 0;
+
+	reactor_remove(g_mdm_source);
+	g_mdm_source = NULL;
+}
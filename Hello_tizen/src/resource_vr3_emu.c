@@ -0,0 +1,799 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Software VR3 module on a pseudo terminal.
+ *        The driver opens a context on vr_emu_get_port() as on the real
+ *        UART. The module answers on its own thread, plays scripted
+ *        recognitions and can add link timing and line noise, so the
+ *        voice path is measured without the hardware.
+ *        The link is full duplex: host bytes keep arriving, timestamped
+ *        on a model of the line, while the module works or answers.
+ ******************************************************************************
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "vr3.h"
+#include "vr3_emu.h"
+#include "mtime.h"
+
+#define VR_EMU_BYTE_US(br)		(10000000 / (br))	/* 10 bits per byte */
+#define VR_EMU_IDLE_MS			(10)				/* poll step while nothing is scripted */
+#define VR_EMU_GROUPS			(8)
+#define VR_EMU_RXQ				(64)				/* chunks received ahead of the module */
+
+/* FRAME_CMD_SET_BR codes as the module knows them */
+static const struct{
+	uint8_t code;
+	unsigned long br;
+	peripheral_uart_baud_rate_e host;
+}vr_emu_baud[] = {
+	{ 0, 9600,  PERIPHERAL_UART_BAUD_RATE_9600 },
+	{ 1, 2400,  PERIPHERAL_UART_BAUD_RATE_2400 },
+	{ 2, 4800,  PERIPHERAL_UART_BAUD_RATE_4800 },
+	{ 3, 9600,  PERIPHERAL_UART_BAUD_RATE_9600 },
+	{ 4, 19200, PERIPHERAL_UART_BAUD_RATE_19200 },
+	{ 5, 38400, PERIPHERAL_UART_BAUD_RATE_38400 },
+};
+
+#define VR_EMU_BAUD_NUM			(int)(sizeof(vr_emu_baud) / sizeof(vr_emu_baud[0]))
+
+/* host bytes, fully on the module side at done_us */
+typedef struct{
+	uint8_t data[64];
+	int len;
+	long long done_us;
+}vr_emu_chunk_s;
+
+struct _vr_emu_s {
+	vr_emu_config_s config;
+	uart_port_h port;					/* host side, used by the driver */
+	int peer;							/* module side */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	volatile bool running;
+	vr_parser_s parser;
+	vr_emu_chunk_s rxq[VR_EMU_RXQ];
+	int rxq_head;
+	int rxq_num;
+	long long line_us;					/* host to module line busy until */
+	unsigned int seed;
+	unsigned int frame_count;
+
+	int baud;							/* vr_emu_baud entry in use */
+	int baud_pending;					/* FRAME_CMD_SET_BR, taken at restart */
+	uint8_t group_ctrl;
+
+	bool trained[VR_EMU_RECORDS];
+	uint8_t sig_len[VR_EMU_RECORDS];
+	uint8_t sig[VR_EMU_RECORDS][VR_SIG_MAX];
+
+	uint8_t loaded[VR_RECOGNIZER_SLOTS];
+	int loaded_num;
+	uint8_t group_mode;					/* FF: none, 0x8n: user, 0x0n: system */
+	uint8_t user_group[VR_EMU_GROUPS][VR_RECOGNIZER_SLOTS];
+
+	vr_emu_event_s script[VR_EMU_SCRIPT_MAX];
+	int script_num;
+	int script_pos;
+	long long script_next_us;
+
+	vr_emu_stats_s stats;
+};
+
+/* host port at another rate, the module only sees garbage */
+static bool vr_emu_mismatch(vr_emu_h emu)
+{
+	return uart_port_get_baud_rate(emu->port) != vr_emu_baud[emu->baud].host;
+}
+
+/* take what the host wrote so far, stamped with when the line delivers it */
+static void vr_emu_drain(vr_emu_h emu)
+{
+	vr_emu_chunk_s *c;
+	long long now;
+
+	while (emu->rxq_num < VR_EMU_RXQ) {
+		c = &emu->rxq[(emu->rxq_head + emu->rxq_num) % VR_EMU_RXQ];
+		c->len = read(emu->peer, c->data, sizeof(c->data));
+		if (c->len <= 0)
+			return;
+		if (vr_emu_mismatch(emu))
+			continue;
+
+		now = mtime_now_us();
+		if (emu->config.link_delay) {
+			if (emu->line_us < now)
+				emu->line_us = now;
+			emu->line_us += c->len * VR_EMU_BYTE_US(vr_emu_baud[emu->baud].br);
+			c->done_us = emu->line_us;
+		} else {
+			c->done_us = now;
+		}
+		emu->rxq_num++;
+	}
+}
+
+/* module busy for us, the host may keep sending meanwhile */
+static void vr_emu_sleep(vr_emu_h emu, long long us)
+{
+	struct pollfd pfd = { .fd = emu->peer, .events = POLLIN };
+	struct timespec ts;
+	long long end = mtime_now_us() + us;
+	long long left;
+
+	while ((left = end - mtime_now_us()) > 0) {
+		ts.tv_sec = left / 1000000;
+		ts.tv_nsec = (left % 1000000) * 1000;
+		if (ppoll(&pfd, 1, &ts, NULL) > 0)
+			vr_emu_drain(emu);
+	}
+}
+
+static void vr_emu_link_delay(vr_emu_h emu, int len)
+{
+	if (emu->config.link_delay)
+		vr_emu_sleep(emu, len * VR_EMU_BYTE_US(vr_emu_baud[emu->baud].br));
+}
+
+static void vr_emu_noise(vr_emu_h emu)
+{
+	uint8_t noise[256];
+	int len, i;
+
+	len = 1 + rand_r(&emu->seed) % (emu->config.noise_max ? emu->config.noise_max : 1);
+	if (len > (int)sizeof(noise))
+		len = sizeof(noise);
+	for (i = 0; i < len; i++)
+		noise[i] = (rand_r(&emu->seed) % 4 == 0) ? FRAME_HEAD : rand_r(&emu->seed) & 0xFF;
+
+	vr_emu_link_delay(emu, len);
+	if (write(emu->peer, noise, len) == len)
+		emu->stats.noise_bytes += len;
+}
+
+static void vr_emu_write(vr_emu_h emu, uint8_t *out, int len)
+{
+	if (vr_emu_mismatch(emu))
+		return;
+
+	if (emu->config.noise_every && ++emu->frame_count % emu->config.noise_every == 0)
+		vr_emu_noise(emu);
+
+	vr_emu_link_delay(emu, len);
+	if (write(emu->peer, out, len) != len) {
+		LOGE("emulator write failed");
+		return;
+	}
+	emu->stats.frames++;
+	emu->stats.bytes += len;
+}
+
+/* FRAME_HEAD | len | cmd | data | FRAME_END, out[3] on is data */
+static void vr_emu_reply(vr_emu_h emu, uint8_t *out, uint8_t cmd, int data_len)
+{
+	out[0] = FRAME_HEAD;
+	out[1] = data_len + 2;
+	out[2] = cmd;
+	out[3 + data_len] = FRAME_END;
+	vr_emu_write(emu, out, data_len + 4);
+}
+
+static uint8_t vr_emu_train_status(vr_emu_h emu, int rec)
+{
+	return rec < VR_EMU_RECORDS ? emu->trained[rec] : 0xFF;
+}
+
+static void vr_emu_prompt(vr_emu_h emu, uint8_t rec, const char *text)
+{
+	uint8_t out[VR_FRAME_MAX];
+	int n = strlen(text);
+
+	out[3] = rec;
+	memcpy(&out[4], text, n);
+	vr_emu_reply(emu, out, FRAME_CMD_PROMPT, 1 + n);
+}
+
+/* the user says the word twice */
+static uint8_t vr_emu_train_one(vr_emu_h emu, uint8_t rec)
+{
+	if (rec >= VR_EMU_RECORDS)
+		return 0xFF;
+
+	vr_emu_prompt(emu, rec, "Speak now");
+	vr_emu_sleep(emu, emu->config.train_prompt_ms * 1000LL);
+	vr_emu_prompt(emu, rec, "Speak again");
+	vr_emu_sleep(emu, emu->config.train_prompt_ms * 1000LL);
+	vr_emu_prompt(emu, rec, "Success");
+	emu->trained[rec] = true;
+
+	return 0x00;
+}
+
+static void vr_emu_bsr(vr_emu_h emu, uint8_t *out)
+{
+	int i;
+
+	out[3] = emu->loaded_num;
+	for (i = 0; i < VR_RECOGNIZER_SLOTS; i++)
+		out[4 + i] = i < emu->loaded_num ? emu->loaded[i] : 0xFF;
+	out[11] = emu->loaded_num;
+	out[12] = (1 << emu->loaded_num) - 1;
+	out[13] = emu->group_mode;
+	vr_emu_reply(emu, out, FRAME_CMD_CHECK_BSR, 11);
+}
+
+static void vr_emu_load_group(vr_emu_h emu, const uint8_t *records, uint8_t mode)
+{
+	int i;
+
+	emu->loaded_num = 0;
+	for (i = 0; i < VR_RECOGNIZER_SLOTS; i++)
+		if (records[i] < VR_EMU_RECORDS && emu->trained[records[i]])
+			emu->loaded[emu->loaded_num++] = records[i];
+	emu->group_mode = mode;
+}
+
+static void vr_emu_group(vr_emu_h emu, const uint8_t *frame, int len, uint8_t *out)
+{
+	uint8_t records[VR_RECOGNIZER_SLOTS];
+	uint8_t grp = frame[4];
+	int i;
+
+	if (len < 6 || grp >= VR_EMU_GROUPS) {
+		out[3] = FRAME_CMD_GROUP;
+		vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+		return;
+	}
+
+	switch (frame[3]) {
+	case FRAME_CMD_GROUP_SET:
+		emu->group_ctrl = grp;
+		out[3] = 0x00;
+		vr_emu_reply(emu, out, FRAME_CMD_GROUP, 1);
+		break;
+
+	case FRAME_CMD_GROUP_SUGRP:
+		memset(emu->user_group[grp], 0xFF, VR_RECOGNIZER_SLOTS);
+		for (i = 0; i < len - 6 && i < VR_RECOGNIZER_SLOTS; i++)
+			emu->user_group[grp][i] = frame[5 + i];
+		out[3] = 0x00;
+		vr_emu_reply(emu, out, FRAME_CMD_GROUP, 1);
+		break;
+
+	case FRAME_CMD_GROUP_LSGRP:
+		for (i = 0; i < VR_RECOGNIZER_SLOTS; i++)
+			records[i] = grp * VR_RECOGNIZER_SLOTS + i;
+		vr_emu_load_group(emu, records, grp);
+		vr_emu_bsr(emu, out);
+		break;
+
+	case FRAME_CMD_GROUP_LUGRP:
+		vr_emu_load_group(emu, emu->user_group[grp], 0x80 | grp);
+		vr_emu_bsr(emu, out);
+		break;
+
+	case FRAME_CMD_GROUP_CUGRP:
+		out[3] = FRAME_CMD_GROUP_CUGRP;
+		out[4] = grp;
+		memcpy(&out[5], emu->user_group[grp], VR_RECOGNIZER_SLOTS);
+		vr_emu_reply(emu, out, FRAME_CMD_GROUP, 2 + VR_RECOGNIZER_SLOTS);
+		break;
+
+	default:
+		out[3] = FRAME_CMD_GROUP;
+		vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+		break;
+	}
+}
+
+static void vr_emu_command(const uint8_t *frame, int len, void *user_data)
+{
+	vr_emu_h emu = user_data;
+	uint8_t out[VR_FRAME_MAX];
+	int i, j, n, rec, data_len = len - 4;
+
+	emu->stats.requests++;
+	vr_emu_sleep(emu, emu->config.cmd_delay_us);
+
+	switch (frame[2]) {
+	case FRAME_CMD_CHECK_SYSTEM:
+		out[3] = 0x00;
+		out[4] = vr_emu_baud[emu->baud].code;
+		out[5] = 0x00;
+		out[6] = 0x00;
+		out[7] = 0x00;
+		out[8] = emu->group_ctrl;
+		vr_emu_reply(emu, out, FRAME_CMD_CHECK_SYSTEM, 6);
+		break;
+
+	case FRAME_CMD_SET_BR:
+		for (i = 0; i < VR_EMU_BAUD_NUM && vr_emu_baud[i].code != frame[3]; i++)
+			;
+		if (data_len != 1 || i == VR_EMU_BAUD_NUM) {
+			out[3] = frame[2];
+			vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+			break;
+		}
+		emu->baud_pending = i;
+		out[3] = 0x00;
+		vr_emu_reply(emu, out, FRAME_CMD_SET_BR, 1);
+		break;
+
+	case FRAME_CMD_CHECK_BSR:
+		vr_emu_bsr(emu, out);
+		break;
+
+	case FRAME_CMD_CHECK_TRAIN:
+		if (data_len == 1 && frame[3] == 0xFF) {
+			for (i = 0; i < VR_TRAIN_ALL_PKTS; i++) {
+				for (n = 0, j = 0; j < 5; j++) {
+					rec = i * 5 + j;
+					out[4 + j * 2] = rec;
+					out[5 + j * 2] = vr_emu_train_status(emu, rec);
+					n += out[5 + j * 2] == 0x01;
+				}
+				out[3] = n;
+				vr_emu_reply(emu, out, FRAME_CMD_CHECK_TRAIN, 11);
+			}
+			break;
+		}
+		if (data_len > VR_TRAIN_BATCH_MAX) {
+			/* record & result pairs would not fit the answer */
+			out[3] = frame[2];
+			vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+			break;
+		}
+		for (i = 0, n = 0; i < data_len; i++) {
+			out[4 + i * 2] = frame[3 + i];
+			out[5 + i * 2] = vr_emu_train_status(emu, frame[3 + i]);
+			n += out[5 + i * 2] == 0x01;
+		}
+		out[3] = n;
+		vr_emu_reply(emu, out, FRAME_CMD_CHECK_TRAIN, 1 + i * 2);
+		break;
+
+	case FRAME_CMD_CHECK_SIG:
+		rec = frame[3];
+		n = (rec < VR_EMU_RECORDS && emu->trained[rec]) ? emu->sig_len[rec] : 0;
+		out[3] = rec;
+		out[4] = n;
+		memcpy(&out[5], emu->sig[rec < VR_EMU_RECORDS ? rec : 0], n);
+		vr_emu_reply(emu, out, FRAME_CMD_CHECK_SIG, 2 + n);
+		break;
+
+	case FRAME_CMD_SET_SIG:
+		rec = frame[3];
+		n = data_len - 1;
+		if (n < 0 || rec >= VR_EMU_RECORDS || n > VR_SIG_MAX) {
+			out[3] = frame[2];
+			vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+			break;
+		}
+		memcpy(emu->sig[rec], &frame[4], n);
+		emu->sig_len[rec] = n;
+		out[3] = 0x00;
+		vr_emu_reply(emu, out, FRAME_CMD_SET_SIG, 1);
+		break;
+
+	case FRAME_CMD_TRAIN:
+		if (data_len > VR_TRAIN_BATCH_MAX) {
+			out[3] = frame[2];
+			vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+			break;
+		}
+		for (i = 0, n = 0; i < data_len; i++) {
+			out[4 + i * 2] = frame[3 + i];
+			out[5 + i * 2] = vr_emu_train_one(emu, frame[3 + i]);
+			n += out[5 + i * 2] == 0x00;
+		}
+		out[3] = n;
+		vr_emu_reply(emu, out, FRAME_CMD_TRAIN, 1 + i * 2);
+		break;
+
+	case FRAME_CMD_SIG_TRAIN:
+		rec = frame[3];
+		n = data_len - 1;
+		if (n < 0) {
+			out[3] = frame[2];
+			vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+			break;
+		}
+		out[4] = rec;
+		out[5] = vr_emu_train_one(emu, rec);
+		if (out[5] == 0x00 && n <= VR_SIG_MAX) {
+			memcpy(emu->sig[rec], &frame[4], n);
+			emu->sig_len[rec] = n;
+		}
+		out[3] = out[5] == 0x00;
+		memcpy(&out[6], &frame[4], n);
+		vr_emu_reply(emu, out, FRAME_CMD_SIG_TRAIN, 3 + n);
+		break;
+
+	case FRAME_CMD_CLEAR:
+		emu->loaded_num = 0;
+		emu->group_mode = 0xFF;
+		vr_emu_reply(emu, out, FRAME_CMD_CLEAR, 0);
+		break;
+
+	case FRAME_CMD_LOAD:
+		if (data_len > VR_TRAIN_BATCH_MAX) {
+			out[3] = frame[2];
+			vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+			break;
+		}
+		for (i = 0, n = 0; i < data_len; i++) {
+			rec = frame[3 + i];
+			out[4 + i * 2] = rec;
+			for (j = 0; j < emu->loaded_num && emu->loaded[j] != rec; j++)
+				;
+			if (rec >= VR_EMU_RECORDS)
+				out[5 + i * 2] = 0xFF;
+			else if (!emu->trained[rec])
+				out[5 + i * 2] = 0xFE;
+			else if (j < emu->loaded_num)
+				out[5 + i * 2] = 0xFC;
+			else if (emu->loaded_num == VR_RECOGNIZER_SLOTS)
+				out[5 + i * 2] = 0xFD;
+			else {
+				emu->loaded[emu->loaded_num++] = rec;
+				out[5 + i * 2] = 0x00;
+				n++;
+			}
+		}
+		emu->group_mode = 0xFF;
+		out[3] = n;
+		vr_emu_reply(emu, out, FRAME_CMD_LOAD, 1 + i * 2);
+		break;
+
+	case FRAME_CMD_GROUP:
+		vr_emu_group(emu, frame, len, out);
+		break;
+
+	default:
+		out[3] = frame[2];
+		vr_emu_reply(emu, out, FRAME_CMD_ERROR, 1);
+		break;
+	}
+}
+
+/*
+ * FRAME_HEAD | len | FRAME_CMD_VR | 00 | group | record | index | sig len | sig | FRAME_END
+ */
+static void vr_emu_recognize(vr_emu_h emu, uint8_t rec)
+{
+	uint8_t out[VR_FRAME_MAX];
+	int i;
+
+	for (i = 0; i < emu->loaded_num && emu->loaded[i] != rec; i++)
+		;
+	if (i == emu->loaded_num) {
+		emu->stats.events_missed++;
+		return;
+	}
+
+	out[3] = 0x00;
+	out[4] = emu->group_mode;
+	out[5] = rec;
+	out[6] = i;
+	out[7] = emu->sig_len[rec];
+	memcpy(&out[8], emu->sig[rec], emu->sig_len[rec]);
+	vr_emu_reply(emu, out, FRAME_CMD_VR, 5 + emu->sig_len[rec]);
+	emu->stats.events++;
+}
+
+/* ms to the next scripted recognition, fire it when due */
+static int vr_emu_script_step(vr_emu_h emu)
+{
+	long long now;
+
+	if (emu->script_pos == emu->script_num)
+		return VR_EMU_IDLE_MS;
+
+	now = mtime_now_us();
+	if (now < emu->script_next_us)
+		return (emu->script_next_us - now + 999) / 1000;
+
+	vr_emu_recognize(emu, emu->script[emu->script_pos].record);
+	if (++emu->script_pos < emu->script_num)
+		emu->script_next_us = now + emu->script[emu->script_pos].delay_ms * 1000LL;
+
+	return 0;
+}
+
+static void *vr_emu_thread(void *data)
+{
+	vr_emu_h emu = data;
+	struct pollfd pfd = { .fd = emu->peer, .events = POLLIN };
+	vr_emu_chunk_s c;
+	long long wait;
+	int idle;
+
+	pthread_mutex_lock(&emu->lock);
+	while (emu->running) {
+		idle = vr_emu_script_step(emu);
+		vr_emu_drain(emu);
+		if (emu->rxq_num == 0) {
+			pthread_mutex_unlock(&emu->lock);
+			poll(&pfd, 1, idle < VR_EMU_IDLE_MS ? idle : VR_EMU_IDLE_MS);
+			pthread_mutex_lock(&emu->lock);
+			continue;
+		}
+
+		/* a frame is not complete before its last byte is through the line */
+		wait = emu->rxq[emu->rxq_head].done_us - mtime_now_us();
+		if (wait > 0)
+			vr_emu_sleep(emu, wait);
+
+		/* commands drain the line while they run, the slot is reused */
+		c = emu->rxq[emu->rxq_head];
+		emu->rxq_head = (emu->rxq_head + 1) % VR_EMU_RXQ;
+		emu->rxq_num--;
+		vr_parser_feed(&emu->parser, c.data, c.len);
+	}
+	pthread_mutex_unlock(&emu->lock);
+
+	return NULL;
+}
+
+/**
+    @brief start the module, the driver talks to vr_emu_get_port().
+    @param config --> timing & noise, NULL for a fast clean link.
+*/
+bool vr_emu_start(const vr_emu_config_s *config, vr_emu_h *emu)
+{
+	vr_emu_h e;
+	int rec;
+
+	if (emu == NULL)
+		return false;
+
+	e = calloc(1, sizeof(*e));
+	if (e == NULL) {
+		LOGE("out of memory");
+		return false;
+	}
+
+	if (config != NULL)
+		e->config = *config;
+	e->seed = 1;
+	e->baud = e->baud_pending = 3;		/* 9600 */
+	e->group_mode = 0xFF;
+	memset(e->user_group, 0xFF, sizeof(e->user_group));
+	for (rec = 0; rec < VR_EMU_RECORDS; rec += 2) {
+		e->trained[rec] = true;
+		e->sig_len[rec] = sprintf((char *)e->sig[rec], "rec%d", rec);
+	}
+
+	if (uart_port_open_pty(vr_emu_baud[e->baud].host, &e->port, &e->peer) == false) {
+		free(e);
+		return false;
+	}
+	fcntl(e->peer, F_SETFL, O_NONBLOCK);
+
+	vr_parser_init(&e->parser, vr_emu_command, e);
+	pthread_mutex_init(&e->lock, NULL);
+	e->running = true;
+	if (pthread_create(&e->thread, NULL, vr_emu_thread, e) != 0) {
+		LOGE("pthread_create failed");
+		pthread_mutex_destroy(&e->lock);
+		uart_port_close(e->port);
+		close(e->peer);
+		free(e);
+		return false;
+	}
+
+	*emu = e;
+	return true;
+}
+
+void vr_emu_stop(vr_emu_h emu)
+{
+	if (emu == NULL)
+		return;
+
+	emu->running = false;
+	pthread_join(emu->thread, NULL);
+	pthread_mutex_destroy(&emu->lock);
+	uart_port_close(emu->port);
+	close(emu->peer);
+	free(emu);
+}
+
+/**
+    @brief host side of the pty, owned by the emulator.
+*/
+uart_port_h vr_emu_get_port(vr_emu_h emu)
+{
+	return emu->port;
+}
+
+/**
+    @brief power cycle, a FRAME_CMD_SET_BR rate takes effect and the recognizer is empty.
+*/
+void vr_emu_restart(vr_emu_h emu)
+{
+	pthread_mutex_lock(&emu->lock);
+	emu->baud = emu->baud_pending;
+	emu->loaded_num = 0;
+	emu->group_mode = 0xFF;
+	emu->rxq_num = 0;
+	vr_parser_reset(&emu->parser);
+	pthread_mutex_unlock(&emu->lock);
+}
+
+/**
+    @brief recognize the scripted records, a record not in the recognizer
+           is not heard. replaces a script still playing.
+*/
+bool vr_emu_play(vr_emu_h emu, const vr_emu_event_s *script, int num)
+{
+	if (num < 0 || num > VR_EMU_SCRIPT_MAX)
+		return false;
+
+	pthread_mutex_lock(&emu->lock);
+	memcpy(emu->script, script, num * sizeof(*script));
+	emu->script_num = num;
+	emu->script_pos = 0;
+	emu->script_next_us = mtime_now_us() + (num ? script[0].delay_ms * 1000LL : 0);
+	pthread_mutex_unlock(&emu->lock);
+
+	return true;
+}
+
+bool vr_emu_playing(vr_emu_h emu)
+{
+	bool playing;
+
+	pthread_mutex_lock(&emu->lock);
+	playing = emu->script_pos < emu->script_num;
+	pthread_mutex_unlock(&emu->lock);
+
+	return playing;
+}
+
+void vr_emu_get_stats(vr_emu_h emu, vr_emu_stats_s *stats)
+{
+	if (stats == NULL)
+		return;
+
+	pthread_mutex_lock(&emu->lock);
+	*stats = emu->stats;
+	pthread_mutex_unlock(&emu->lock);
+}
+
+
+#define VR_EMU_TEST_LATENCY		(500)
+#define VR_EMU_TEST_SWEEPS		(50)
+#define VR_EMU_TEST_EVENTS		(300)
+
+/* CHECK_SYSTEM round trips, min / avg / max us */
+static int vr_emu_test_latency(vr3_h vr, int count, long long *min, long long *avg, long long *max)
+{
+	uint8_t buf[VR_FRAME_MAX];
+	long long start, t, sum = 0;
+	int i;
+
+	*min = -1;
+	*max = 0;
+	for (i = 0; i < count; i++) {
+		start = mtime_now_us();
+		if (handle_VR_checkSystemSettings(vr, buf) <= 0)
+			return -1;
+		t = mtime_now_us() - start;
+		sum += t;
+		if (*min < 0 || t < *min)
+			*min = t;
+		if (t > *max)
+			*max = t;
+	}
+	*avg = sum / count;
+
+	return 0;
+}
+
+/*
+ * driver against the emulator: command latency, frames per second
+ * and scripted recognitions on a noisy line
+ */
+int  vr_emu_test_main(void)
+{
+	static const uint8_t context[] = { 2, 4, 6, 8 };
+	vr_emu_config_s config = { 0 };
+	vr_emu_event_s script[VR_EMU_TEST_EVENTS];
+	vr_emu_stats_s stats;
+	vr_emu_h emu = NULL;
+	vr3_h vr = NULL;
+	uint8_t buf[255];
+	long long min, avg, max, start, elapsed;
+	int i, heard = 0, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	/* software speed, what the driver & pty cost */
+	if (vr_emu_start(&config, &emu) == false || resource_VR_open(vr_emu_get_port(emu), &vr) == false)
+		goto error;
+
+	if (vr_emu_test_latency(vr, VR_EMU_TEST_LATENCY, &min, &avg, &max) < 0)
+		goto error;
+	LOGI("no link delay : CHECK_SYSTEM min [%lld] avg [%lld] max [%lld] us", min, avg, max);
+
+	start = mtime_now_us();
+	for (i = 0; i < VR_EMU_TEST_SWEEPS; i++) {
+		handle_VR_cache_invalidate(vr);
+		if (handle_VR_checkRecord(vr, buf, 0, 0) < 0)
+			goto error;
+	}
+	elapsed = mtime_now_us() - start;
+	LOGI("no link delay : [%d] check all records, [%lld] us each, [%.0f] frames/s received",
+			VR_EMU_TEST_SWEEPS, elapsed / VR_EMU_TEST_SWEEPS, VR_EMU_TEST_SWEEPS * VR_TRAIN_ALL_PKTS * 1e6 / elapsed);
+
+	resource_VR_close(vr);
+	vr = NULL;
+	vr_emu_stop(emu);
+	emu = NULL;
+
+	/* 9600 baud timing, noise burst in front of every 10th frame */
+	config.link_delay = true;
+	config.noise_every = 10;
+	config.noise_max = 8;
+	if (vr_emu_start(&config, &emu) == false || resource_VR_open(vr_emu_get_port(emu), &vr) == false)
+		goto error;
+
+	if (vr_emu_test_latency(vr, VR_EMU_TEST_LATENCY / 10, &min, &avg, &max) < 0)
+		LOGE("a CHECK_SYSTEM answer was lost in the noise");
+	else
+		LOGI("9600 baud, noise : CHECK_SYSTEM min [%lld] avg [%lld] max [%lld] us", min, avg, max);
+
+	if (handle_VR_clear(vr) < 0 || handle_VR_load(vr, (uint8_t *)context, sizeof(context), 0) < 0)
+		goto error;
+
+	for (i = 0; i < VR_EMU_TEST_EVENTS; i++) {
+		script[i].delay_ms = 2 + rand() % 8;
+		script[i].record = context[i % sizeof(context)];
+	}
+	vr_emu_play(emu, script, VR_EMU_TEST_EVENTS);
+	start = mtime_now_us();
+	for (;;) {
+		if (handle_VR_recognize(vr, buf, 50) > 0)
+			heard++;
+		else if (!vr_emu_playing(emu))
+			break;
+	}
+	elapsed = mtime_now_us() - start;
+	vr_emu_get_stats(emu, &stats);
+	LOGI("9600 baud, noise : [%u] recognitions sent, [%d] heard, [%u] noise bytes, [%.0f] events/s",
+			stats.events, heard, stats.noise_bytes, heard * 1e6 / elapsed);
+
+	goto out;
+
+error:
+	LOGE("emulator test failed");
+	ret = -1;
+out:
+	resource_VR_close(vr);
+	vr_emu_stop(emu);
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}
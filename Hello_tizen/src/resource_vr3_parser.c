@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2019 DIGNSYS Inc.
+ *
+ * Contact: Hyobok Ahn (hbahn@dignsys.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************
+ *   @note
+ *        Incremental frame parser for the VR3 protocol
+ *        FRAME_HEAD | length | cmd | data ... | FRAME_END
+ *        length counts cmd up to FRAME_END. Bytes come in any chunk size,
+ *        on a bad length or a missing FRAME_END the parser drops the head
+ *        and rescans the bytes it holds for the next FRAME_HEAD.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "hello_tizen.h"
+#include "hello.h"
+#include "vr3.h"
+#include "mtime.h"
+
+/*
+ * drop the head in buf[0], keep everything from the next FRAME_HEAD on
+ */
+static void vr_parser_resync(vr_parser_s *parser)
+{
+	uint8_t *head;
+	int skip;
+
+	head = memchr(parser->buf + 1, FRAME_HEAD, parser->pos - 1);
+	skip = head ? head - parser->buf : parser->pos;
+
+	parser->dropped += skip;
+	parser->pos -= skip;
+	memmove(parser->buf, parser->buf + skip, parser->pos);
+}
+
+/*
+ * emit every complete frame held in buf, stop when more bytes are needed
+ */
+static void vr_parser_check(vr_parser_s *parser)
+{
+	int len;
+
+	while (parser->pos > 0 && !parser->stop) {
+		if (parser->buf[0] != FRAME_HEAD) {
+			vr_parser_resync(parser);
+			continue;
+		}
+		if (parser->pos < 2)
+			return;
+
+		len = parser->buf[1] + 2;
+		if (len < VR_FRAME_MIN || len > VR_FRAME_MAX) {
+			parser->bad_frames++;
+			vr_parser_resync(parser);
+			continue;
+		}
+		if (parser->pos < len)
+			return;
+
+		if (parser->buf[len - 1] != FRAME_END) {
+			parser->bad_frames++;
+			vr_parser_resync(parser);
+			continue;
+		}
+
+		parser->frames++;
+		parser->frame_cb(parser->buf, len, parser->user_data);
+
+		parser->pos -= len;
+		memmove(parser->buf, parser->buf + len, parser->pos);
+	}
+}
+
+void vr_parser_init(vr_parser_s *parser, vr_frame_cb frame_cb, void *user_data)
+{
+	memset(parser, 0x0, sizeof(*parser));
+	parser->frame_cb = frame_cb;
+	parser->user_data = user_data;
+}
+
+/*
+ * forget a partial frame, counters are kept
+ */
+void vr_parser_reset(vr_parser_s *parser)
+{
+	parser->dropped += parser->pos;
+	parser->pos = 0;
+}
+
+/*
+ * line went idle, the partial frame will not complete
+ * rescan what it holds, frames hidden behind a bad length come out
+ */
+void vr_parser_flush(vr_parser_s *parser)
+{
+	parser->stop = false;
+	while (parser->pos > 0 && !parser->stop) {
+		parser->bad_frames++;
+		vr_parser_resync(parser);
+		vr_parser_check(parser);
+	}
+}
+
+/*
+ * consume len bytes, frame_cb is called for each complete frame
+ * frames already held are emitted first, len 0 only does that
+ * return number of bytes consumed, short if frame_cb set stop
+ */
+int vr_parser_feed(vr_parser_s *parser, const uint8_t *data, int len)
+{
+	const uint8_t *head;
+	int need, n, total = len;
+
+	parser->stop = false;
+	vr_parser_check(parser);
+
+	while (len > 0 && !parser->stop) {
+		if (parser->pos == 0) {
+			/* between frames, skip noise in one go */
+			head = memchr(data, FRAME_HEAD, len);
+			if (head == NULL) {
+				parser->dropped += len;
+				return total;
+			}
+			parser->dropped += head - data;
+			len -= head - data;
+			data = head;
+		}
+
+		/* take the rest of the frame at once when its length is known */
+		need = parser->pos < 2 ? 2 - parser->pos : parser->buf[1] + 2 - parser->pos;
+		if (need <= 0)
+			need = 1;
+		n = need < len ? need : len;
+		if (n > VR_FRAME_MAX - parser->pos)
+			n = VR_FRAME_MAX - parser->pos;
+
+		memcpy(parser->buf + parser->pos, data, n);
+		parser->pos += n;
+		data += n;
+		len -= n;
+
+		vr_parser_check(parser);
+	}
+
+	return total - len;
+}
+
+
+#define VR_PARSER_TEST_FRAMES		(100000)
+#define VR_PARSER_TEST_CHUNK		(64)
+#define VR_PARSER_TEST_NOISE		(1000)		/* noise bursts in recovery test */
+
+typedef struct{
+	uint8_t *stream;
+	int *frame_end;				/* stream offset right after each good frame */
+	int frames;
+	long offset;				/* stream offset being fed */
+	int next;					/* next good frame expected */
+	int lost;
+	long late_bytes;			/* bytes past the end of the frame before it came out */
+	int late_frames;
+}vr_parser_test_s;
+
+static void vr_parser_test_cb(const uint8_t *frame, int len, void *user_data)
+{
+	vr_parser_test_s *test = user_data;
+	int i;
+
+	/* match the frame to the good frame ending at or before offset */
+	for (i = test->next; i < test->frames && test->frame_end[i] <= test->offset; i++) {
+		if (test->frame_end[i] - len >= 0 && memcmp(test->stream + test->frame_end[i] - len, frame, len) == 0)
+			break;
+	}
+	if (i == test->frames || test->frame_end[i] > test->offset)
+		return;		/* a frame made of noise, counted by frames - matched */
+
+	test->lost += i - test->next;
+	if (test->offset > test->frame_end[i]) {
+		test->late_bytes += test->offset - test->frame_end[i];
+		test->late_frames++;
+	}
+	test->next = i + 1;
+}
+
+/*
+ * append one VR3 frame of a random command and data length,
+ * data as the module sends it: record numbers and 0x00 / 0xFC..0xFF status
+ */
+static int vr_parser_test_frame(uint8_t *out)
+{
+	int data_len = rand() % 12;
+	int i;
+
+	out[0] = FRAME_HEAD;
+	out[1] = data_len + 2;
+	out[2] = FRAME_CMD_CHECK_TRAIN + rand() % 2;
+	for (i = 0; i < data_len; i++)
+		out[3 + i] = (i & 1) ? 0xFC + rand() % 4 : rand() % 80;
+	out[3 + data_len] = FRAME_END;
+
+	return data_len + 4;
+}
+
+/*
+ * noise burst, random bytes with a fair share of FRAME_HEAD in it
+ */
+static int vr_parser_test_noise(uint8_t *out)
+{
+	int len = 1 + rand() % 24;
+	int i;
+
+	for (i = 0; i < len; i++)
+		out[i] = (rand() % 4 == 0) ? FRAME_HEAD : rand() & 0xFF;
+
+	return len;
+}
+
+/*
+ * parser throughput on clean data and recovery after injected noise
+ */
+int  vr_parser_test_main(void)
+{
+	vr_parser_s parser;
+	vr_parser_test_s test;
+	long size = 0, pos;
+	double start, elapsed;
+	int i, n, pass, ret = 0;
+
+	LOGI("%s starting...\n", __func__);
+
+	memset(&test, 0x0, sizeof(test));
+	test.stream = malloc((long)VR_PARSER_TEST_FRAMES * (VR_FRAME_MIN + 12) + VR_PARSER_TEST_NOISE * 24);
+	test.frame_end = malloc(VR_PARSER_TEST_FRAMES * sizeof(int));
+	if (test.stream == NULL || test.frame_end == NULL) {
+		LOGE("out of memory");
+		ret = -1;
+		goto out;
+	}
+
+	/* clean stream, chunked as the reactor delivers it */
+	srand(1);
+	for (i = 0; i < VR_PARSER_TEST_FRAMES; i++) {
+		size += vr_parser_test_frame(test.stream + size);
+		test.frame_end[i] = size;
+	}
+	test.frames = VR_PARSER_TEST_FRAMES;
+
+	vr_parser_init(&parser, vr_parser_test_cb, &test);
+	start = mtime_now();
+	for (pos = 0; pos < size; pos += n) {
+		n = size - pos < VR_PARSER_TEST_CHUNK ? size - pos : VR_PARSER_TEST_CHUNK;
+		test.offset = pos + n;
+		vr_parser_feed(&parser, test.stream + pos, n);
+	}
+	elapsed = mtime_now() - start;
+	LOGI("clean : [%u] frames, [%ld] bytes in [%.3f] ms, [%.1f] MB/s, [%.0f] frames/s",
+			parser.frames, size, elapsed * 1e3, size / elapsed / 1e6, parser.frames / elapsed);
+	if (parser.frames != VR_PARSER_TEST_FRAMES || test.lost != 0 || parser.dropped != 0)
+		ret = -1;
+
+	/* a noise burst in front of every 100th frame, fed byte by byte */
+	size = 0;
+	for (i = 0; i < VR_PARSER_TEST_FRAMES; i++) {
+		if (i % (VR_PARSER_TEST_FRAMES / VR_PARSER_TEST_NOISE) == 0)
+			size += vr_parser_test_noise(test.stream + size);
+		size += vr_parser_test_frame(test.stream + size);
+		test.frame_end[i] = size;
+	}
+
+	/* pass 0 : continuous stream, pass 1 : line idle after every frame */
+	for (pass = 0; pass < 2; pass++) {
+		test.next = 0;
+		test.lost = 0;
+		test.late_bytes = 0;
+		test.late_frames = 0;
+
+		vr_parser_init(&parser, vr_parser_test_cb, &test);
+		start = mtime_now();
+		for (pos = 0, i = 0; pos < size; pos++) {
+			test.offset = pos + 1;
+			vr_parser_feed(&parser, test.stream + pos, 1);
+			if (pass == 1 && test.offset == test.frame_end[i]) {
+				vr_parser_flush(&parser);
+				i++;
+			} else if (test.offset == test.frame_end[i]) {
+				i++;
+			}
+		}
+		vr_parser_flush(&parser);
+		elapsed = mtime_now() - start;
+		test.lost += test.frames - test.next;
+
+		LOGI("%s : [%d] bursts, [%d] of [%d] frames lost, [%u] bad heads, [%u] bytes dropped in [%.3f] ms",
+				pass == 0 ? "noise, stream" : "noise, idle gaps", VR_PARSER_TEST_NOISE, test.lost, test.frames,
+				parser.bad_frames, parser.dropped, elapsed * 1e3);
+		LOGI("%s : [%d] frames held back, avg [%.1f] bytes after their FRAME_END",
+				pass == 0 ? "noise, stream" : "noise, idle gaps", test.late_frames,
+				test.late_frames ? (double)test.late_bytes / test.late_frames : 0.0);
+	}
+
+out:
+	free(test.stream);
+	free(test.frame_end);
+	LOGI("%s exiting...\n", __func__);
+	return ret;
+}